@@ -0,0 +1,269 @@
+//
+//  Benchmark.hpp
+//  FloatingPoint
+//
+//  The reusable benchmark loop described in Assignment 3 at the bottom of main.cpp.
+//
+//  BenchmarkFunctor(f, precisionRequired) times f() by:
+//      1) calibrating the clock: how long it takes to read, and how long we can typically
+//         run before the kernel preempts us (done once per clock, then cached)
+//      2) sizing the number of f() calls per measurement so a measurement is much longer
+//         than the clock latency but well inside the preemption window
+//      3) taking measurements, keeping running integer sums of the times and squared times,
+//         until the standard error of the mean is small enough relative to the mean
+//
+//  Times are in the units of the Clock policy, nanoseconds for MonotonicClock, cycles for CycleClock.
+//
+//  Look at the assembly! DoNotOptimize() and ClobberMemory() are there to keep the compiler
+//  from hoisting f() out of the timing loop or deleting it outright, but they only work if
+//  you use them. The functor result is always passed through DoNotOptimize().
+//
+
+#ifndef BENCHMARK_HPP
+#define BENCHMARK_HPP   1
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#   include <x86intrin.h>
+#endif
+
+/*! @abstract Make the compiler believe value is used, so the work to make it can not be optimized away */
+template <typename T>
+static inline __attribute__((always_inline)) void DoNotOptimize( const T & value)
+{
+    asm volatile( "" : : "r,m"(value) : "memory");
+}
+
+/*! @abstract Make the compiler believe all of memory may have been read or written here */
+static inline __attribute__((always_inline)) void ClobberMemory(void)
+{
+    asm volatile( "" : : : "memory");
+}
+
+/*! @abstract A low latency monotonic clock with units of nanoseconds. Not affected by changes to the wall clock. */
+struct MonotonicClock
+{
+    static constexpr const char * kUnits = "ns";
+
+    static inline __attribute__((always_inline)) uint64_t Read(void)
+    {
+#if __APPLE__
+        return clock_gettime_nsec_np(CLOCK_UPTIME_RAW);
+#else
+        struct timespec t;
+        clock_gettime( CLOCK_MONOTONIC_RAW, &t);
+        return uint64_t(t.tv_sec) * 1000000000ULL + uint64_t(t.tv_nsec);
+#endif
+    }
+};
+
+/*! @abstract A clock that counts CPU cycles, for timing work in the units the hardware does it in
+ *  @discussion On Intel this is the time stamp counter, which ticks at the base clock rate, not the current one, so
+ *              turbo and power saving still show up as a few percent either way. arm64 has no cycle counter user code
+ *              can read (see the PMC links in Assignment 3), so there it is the generic timer, in ticks. */
+struct CycleClock
+{
+#if defined(__x86_64__) || defined(__i386__)
+    static constexpr const char * kUnits = "cycles";
+    static inline __attribute__((always_inline)) uint64_t Read(void){ return __rdtsc(); }
+#elif defined(__aarch64__)
+    static constexpr const char * kUnits = "ticks";
+    static inline __attribute__((always_inline)) uint64_t Read(void)
+    {
+        uint64_t ticks;
+        asm volatile( "mrs %0, cntvct_el0" : "=r"(ticks));
+        return ticks;
+    }
+#else
+    static constexpr const char * kUnits = MonotonicClock::kUnits;
+    static inline __attribute__((always_inline)) uint64_t Read(void){ return MonotonicClock::Read(); }
+#endif
+};
+
+/*! @abstract What we learned about a clock before using it to benchmark anything */
+typedef struct ClockCalibration
+{
+    double      latency;            // mean time to read the clock. Subtracted from every measurement.
+    uint64_t    resolution;         // smallest nonzero step we saw the clock take
+    double      preemptionWindow;   // mean time between interruptions while spinning on the clock
+    uint64_t    targetSampleTime;   // how long we would like each measurement to be
+}ClockCalibration;
+
+/*! @abstract Benchmark information we collected when BenchmarkFunctor was running. Times are per call to Functor(). */
+typedef struct Benchmark
+{
+    double      meanTime;           // mean time used for Functor()
+    double      stdDeviation;       // standard deviation
+    double      stdErrorOfTheMean;  // standard error of the mean.  THIS IS NOT THE STANDARD DEVIATION!
+    double      minimumTime;        // The minimum time the functor took to run
+    double      N;                  // The number of test measurements we made.
+    uint64_t    iterationCount;     // The number of times Functor() was called per measurement
+    bool        converged;          // false if we gave up before stdErrorOfTheMean <= precisionRequired * meanTime
+}Benchmark;
+
+
+static inline int CompareTicks( const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a;
+    uint64_t y = *(const uint64_t *) b;
+    return x < y ? -1 : x > y;
+}
+
+/*! @abstract Measure the clock. This takes about a tenth of a second, so the result is cached per Clock. */
+template <typename Clock>
+static ClockCalibration MeasureClock(void)
+{
+    ClockCalibration result = {};
+
+    // Latency: time back to back reads. Preemption will land in a few of them, so drop the slowest 1%.
+    constexpr size_t kLatencySamples = 4096;
+    uint64_t * deltas = (uint64_t *) calloc( kLatencySamples, sizeof(deltas[0]));
+    for( size_t i = 0; i < kLatencySamples; i++)
+    {
+        uint64_t start = Clock::Read();
+        uint64_t end = Clock::Read();
+        deltas[i] = end - start;
+    }
+    qsort( deltas, kLatencySamples, sizeof(deltas[0]), CompareTicks);
+    uint64_t sum = 0;
+    for( size_t i = 0; i < kLatencySamples * 99 / 100; i++)
+        sum += deltas[i];
+    result.latency = (double) sum / (double)(kLatencySamples * 99 / 100);
+    free(deltas);
+
+    // Spin on the clock for a while (~0.1s for a 20ns clock). Steps much longer than a clock read are times we
+    // were interrupted. Clocks that tick slower than they can be read show up as repeats, which gives the resolution.
+    constexpr uint64_t kSpinReads = 5000000;
+    uint64_t interruptThreshold = 50 * ((uint64_t) result.latency + 1);
+    uint64_t resolution = UINT64_MAX;
+    uint64_t interruptions = 0;
+    uint64_t start = Clock::Read();
+    uint64_t last = start;
+    for( uint64_t i = 0; i < kSpinReads; i++)
+    {
+        uint64_t now = Clock::Read();
+        uint64_t step = now - last;
+        if( step && step < resolution )
+            resolution = step;
+        if( step > interruptThreshold )
+            interruptions++;
+        last = now;
+    }
+    result.resolution = resolution == UINT64_MAX ? 1 : resolution;
+    result.preemptionWindow = (double)(last - start) / (double)(interruptions + 1);
+
+    // Each measurement should be long enough that clock latency and resolution are < 0.1% of it,
+    // but short enough that only about one in 20 gets interrupted.
+    double floorTime = 1000.0 * fmax( result.latency, (double) result.resolution);
+    result.targetSampleTime = (uint64_t) fmax( floorTime, result.preemptionWindow / 20.0);
+
+    return result;
+}
+
+template <typename Clock>
+static inline const ClockCalibration & CalibrateClock(void)
+{
+    static const ClockCalibration calibration = MeasureClock<Clock>();
+    return calibration;
+}
+
+/*! @abstract Call f() count times. */
+template <typename Functor>
+static inline __attribute__((always_inline)) void RunFunctor( Functor & f, uint64_t count)
+{
+    for( uint64_t i = 0; i < count; i++)
+    {
+        // Tell the compiler the functor state may change each time around, so that f() can't be hoisted
+        asm volatile( "" : "+m"(f));
+
+        if constexpr (std::is_void_v<decltype(f())>)
+        {
+            f();
+            ClobberMemory();
+        }
+        else
+            DoNotOptimize( f());
+    }
+}
+
+/*! @abstract Measure the time taken by Functor.operator().
+ *  @param  f                   A functor in the style of sampleFunctor that contains the desired workload
+ *  @param  precisionRequired   How accurate the stdErrorOfTheMean needs to be, e.g. 0.01 for ±1%
+ *  @param  maxSamples          Give up (and report converged = false) after this many measurements */
+template <typename Functor, typename Clock = MonotonicClock>
+Benchmark BenchmarkFunctor( const Functor & f, double precisionRequired, uint64_t maxSamples = 100000 )
+{
+    constexpr uint64_t kMinimumSamples = 10;        // need a few before the statistics mean anything
+    constexpr uint64_t kWarmupSamples = 3;
+    const ClockCalibration & clock = CalibrateClock<Clock>();
+    Functor work = f;
+
+    // Find a number of iterations that fills the target measurement time
+    uint64_t iterationCount = 1;
+    for( uint64_t warmup = 0; warmup < kWarmupSamples; )
+    {
+        uint64_t start = Clock::Read();
+        RunFunctor( work, iterationCount);
+        uint64_t time = Clock::Read() - start;
+
+        if( time >= clock.targetSampleTime || iterationCount >= (1ULL << 40) )
+            warmup++;
+        else if( time * 16 < clock.targetSampleTime )
+            iterationCount *= 16;
+        else
+            iterationCount = (uint64_t) ceil( (double) iterationCount * (double) clock.targetSampleTime / (double) (time ? time : 1));
+    }
+
+    // Integer running sums, so that rounding can't hurt us. Times fit easily in 64 bits, but the sum of
+    // squares needs 128, and so does N * sumSquared, which we use to get the variance without cancellation.
+    uint64_t n = 0;
+    uint64_t sum = 0;
+    unsigned __int128 sumSquared = 0;
+    uint64_t minimum = UINT64_MAX;
+    bool converged = false;
+    double mean = 0, variance = 0;
+
+    while( n < maxSamples )
+    {
+        uint64_t start = Clock::Read();
+        RunFunctor( work, iterationCount);
+        uint64_t time = Clock::Read() - start;
+
+        n++;
+        sum += time;
+        sumSquared += (unsigned __int128) time * time;
+        if( time < minimum )
+            minimum = time;
+
+        if( n < kMinimumSamples )
+            continue;
+
+        // variance = (N sum(x**2) - sum(x)**2) / (N (N-1)), exact up to the final division
+        unsigned __int128 s = sum;
+        variance = (double)(n * sumSquared - s * s) / ((double) n * (double)(n - 1));
+        mean = (double) sum / (double) n;
+        double stdErrorOfTheMean = sqrt( variance / (double) n);
+        if( stdErrorOfTheMean <= precisionRequired * fmax( mean - clock.latency, 0.0) )
+        {
+            converged = true;
+            break;
+        }
+    }
+
+    Benchmark result;
+    double scale = 1.0 / (double) iterationCount;
+    result.meanTime = fmax( mean - clock.latency, 0.0) * scale;
+    result.stdDeviation = sqrt(variance) * scale;
+    result.stdErrorOfTheMean = sqrt( variance / (double) n) * scale;
+    result.minimumTime = fmax( (double) minimum - clock.latency, 0.0) * scale;
+    result.N = (double) n;
+    result.iterationCount = iterationCount;
+    result.converged = converged;
+    return result;
+}
+
+#endif /* BENCHMARK_HPP */
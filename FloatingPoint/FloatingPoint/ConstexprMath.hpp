@@ -0,0 +1,269 @@
+//
+//  ConstexprMath.hpp
+//  FloatingPoint
+//
+//  Just enough math to build function tables and polynomial coefficients at compile time.
+//  None of this is fast, and it doesn't need to be: it runs in the compiler. It does need to
+//  be accurate, to a few ulps of double, which is far better than any float function needs.
+//
+//  Also handy for seeing where constants came from, rather than pasting in a wall of hex.
+//
+
+#ifndef CONSTEXPR_MATH_HPP
+#define CONSTEXPR_MATH_HPP  1
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ConstexprMath
+{
+    /*! @abstract 2**n for integer n, exactly */
+    constexpr double Exp2i( int n)
+    {
+        double result = 1.0;
+        for( ; n > 0; n--)  result *= 2.0;
+        for( ; n < 0; n++)  result *= 0.5;
+        return result;
+    }
+
+    /*! @abstract atanh(s) for |s| <= 0.2, by its Taylor series s + s**3/3 + s**5/5 + ... */
+    constexpr double Atanh( double s)
+    {
+        double s2 = s * s;
+        double term = s;
+        double sum = 0;
+        for( int i = 1; i < 60; i += 2)
+        {
+            sum += term / i;
+            term *= s2;
+        }
+        return sum;
+    }
+
+    /*! @abstract natural log of 2, from ln(2) = 2 atanh(1/3) */
+    constexpr double kLn2 = 2.0 * Atanh( 1.0 / 3.0);
+
+    /*! @abstract log2(x) for positive, finite x
+     *  @discussion Scale x by powers of two into [sqrt(1/2), sqrt(2)). Then ln(m) = 2 atanh((m-1)/(m+1))
+     *              converges quickly because |(m-1)/(m+1)| < 0.172 */
+    constexpr double Log2( double x)
+    {
+        int exponent = 0;
+        while( x >= 1.4142135623730951 ) { x *= 0.5;  exponent++; }
+        while( x < 0.7071067811865476 )  { x *= 2.0;  exponent--; }
+        return exponent + 2.0 * Atanh( (x - 1.0) / (x + 1.0)) / kLn2;
+    }
+
+    /*! @abstract e**x for |x| <= 1, by its Taylor series */
+    constexpr double Exp( double x)
+    {
+        double term = 1.0;
+        double sum = 0;
+        for( int i = 1; i < 30; i++)
+        {
+            sum += term;
+            term *= x / i;
+        }
+        return sum;
+    }
+
+    /*! @abstract 2**x for |x| <= 1 */
+    constexpr double Exp2( double x)
+    {
+        return Exp( x * kLn2);
+    }
+
+    constexpr double kPi = 3.14159265358979323846;
+
+    /*! @abstract cos(x) for |x| <= pi, by its Taylor series */
+    constexpr double Cos( double x)
+    {
+        double x2 = x * x;
+        double term = 1.0;
+        double sum = 0;
+        for( int i = 0; i < 60; i += 2)
+        {
+            sum += term;
+            term *= -x2 / double((i + 1) * (i + 2));
+        }
+        return sum;
+    }
+
+    /*! @abstract The value of the float with encoding bits. Positive normal numbers only. */
+    constexpr double FloatFromBits( uint32_t bits)
+    {
+        return (1.0 + double(bits & 0x7fffff) * Exp2i(-23)) * Exp2i( int(bits >> 23) - 127);
+    }
+
+    /*! @abstract The value of the double with encoding bits. Positive normal numbers only. */
+    constexpr double DoubleFromBits( uint64_t bits)
+    {
+        return (1.0 + double(bits & 0xfffffffffffffULL) * Exp2i(-52)) * Exp2i( int(bits >> 52) - 1023);
+    }
+
+    /*! @abstract Round x to the nearest number with significantBits bits, ties to even, for 1 <= significantBits <= 53 */
+    constexpr double RoundToSignificantBits( double x, int significantBits)
+    {
+        if( 0 == x )
+            return x;
+
+        double a = x < 0 ? -x : x;
+        int exponent = 0;
+        while( a >= 2.0 ) { a *= 0.5;  exponent++; }
+        while( a < 1.0 )  { a *= 2.0;  exponent--; }
+
+        // a in [1, 2). a * 2**(significantBits - 1) is exact, so is its fractional part.
+        double scaled = a * Exp2i( significantBits - 1);
+        double whole = double( uint64_t(scaled));
+        double fraction = scaled - whole;
+        if( fraction > 0.5 || (fraction == 0.5 && 0 != (uint64_t(whole) & 1)) )
+            whole += 1.0;
+
+        double result = whole * Exp2i( exponent - (significantBits - 1));
+        return x < 0 ? -result : result;
+    }
+
+    /*! @abstract Round to float, for |x| in the normal range. Round to nearest, ties to even. */
+    constexpr double RoundToFloat( double x)
+    {
+        return RoundToSignificantBits( x, 24);
+    }
+
+    /*! @abstract Solve the n x n linear system a x = b in place by Gaussian elimination with partial pivoting. The answer is left in b. */
+    template <size_t n>
+    constexpr void Solve( double (&a)[n][n], double (&b)[n])
+    {
+        for( size_t column = 0; column < n; column++)
+        {
+            size_t pivot = column;
+            for( size_t row = column + 1; row < n; row++)
+                if( (a[row][column] < 0 ? -a[row][column] : a[row][column]) > (a[pivot][column] < 0 ? -a[pivot][column] : a[pivot][column]) )
+                    pivot = row;
+            for( size_t i = 0; i < n; i++)
+            {
+                double t = a[column][i];  a[column][i] = a[pivot][i];  a[pivot][i] = t;
+            }
+            double t = b[column];  b[column] = b[pivot];  b[pivot] = t;
+
+            for( size_t row = column + 1; row < n; row++)
+            {
+                double scale = a[row][column] / a[column][column];
+                for( size_t i = column; i < n; i++)
+                    a[row][i] -= scale * a[column][i];
+                b[row] -= scale * b[column];
+            }
+        }
+
+        for( size_t row = n; row-- > 0; )
+        {
+            double sum = b[row];
+            for( size_t i = row + 1; i < n; i++)
+                sum -= a[row][i] * b[i];
+            b[row] = sum / a[row][row];
+        }
+    }
+
+    /*! @abstract Coefficients c[0] + c[1] x + ... + c[n-1] x**(n-1) of the polynomial through f at the n Chebyshev nodes on [-r, r]
+     *  @discussion Interpolating at the Chebyshev nodes gets within a small factor of the best (minimax) polynomial,
+     *              without the Remez iteration. */
+    template <size_t n, typename Function>
+    constexpr void ChebyshevFit( Function f, double r, double (&c)[n])
+    {
+        double a[n][n] = {};
+        for( size_t j = 0; j < n; j++)
+        {
+            double x = r * Cos( kPi * double(2 * j + 1) / double(2 * n));
+            double power = 1.0;
+            for( size_t i = 0; i < n; i++)
+            {
+                a[j][i] = power;
+                power *= x;
+            }
+            c[j] = f(x);
+        }
+        Solve( a, c);
+    }
+
+
+#pragma mark - Double-double
+
+    // DoubleDouble.hpp, but constexpr: products are split by hand (Dekker), since fma() isn't constexpr. For the
+    // few table entries that need more than a double, e.g. log2(c) in the Log2D table.
+
+    /*! @abstract The unevaluated sum hi + lo, good to about 2**-100 relative */
+    typedef struct Extended
+    {
+        double  hi;
+        double  lo;
+    }Extended;
+
+    /*! @abstract a + b exactly, for any a and b */
+    constexpr Extended TwoSum( double a, double b)
+    {
+        double s = a + b;
+        double bb = s - a;
+        return Extended{ s, (a - (s - bb)) + (b - bb) };
+    }
+
+    /*! @abstract a * b exactly. Veltkamp's split cuts each into a 26 bit high part and the rest, whose products are all exact. */
+    constexpr Extended TwoProduct( double a, double b)
+    {
+        constexpr double kSplit = 134217729.0;         // 2**27 + 1
+        double ca = kSplit * a, cb = kSplit * b;
+        double aHi = ca - (ca - a), bHi = cb - (cb - b);
+        double aLo = a - aHi, bLo = b - bHi;
+        double p = a * b;
+        return Extended{ p, ((aHi * bHi - p) + aHi * bLo + aLo * bHi) + aLo * bLo };
+    }
+
+    constexpr Extended Add( Extended a, Extended b)
+    {
+        Extended s = TwoSum( a.hi, b.hi);
+        double lo = s.lo + (a.lo + b.lo);
+        double hi = s.hi + lo;
+        return Extended{ hi, lo - (hi - s.hi) };
+    }
+
+    constexpr Extended Multiply( Extended a, Extended b)
+    {
+        Extended p = TwoProduct( a.hi, b.hi);
+        double lo = p.lo + (a.hi * b.lo + a.lo * b.hi);
+        double hi = p.hi + lo;
+        return Extended{ hi, lo - (hi - p.hi) };
+    }
+
+    /*! @abstract a / b, by one round of long division with the remainder done exactly */
+    constexpr Extended Divide( Extended a, double b)
+    {
+        double q = a.hi / b;
+        Extended p = TwoProduct( q, b);
+        double r = ((a.hi - p.hi) - p.lo + a.lo) / b;
+        double hi = q + r;
+        return Extended{ hi, r - (hi - q) };
+    }
+
+    /*! @abstract log2(x) to about 2**-64 relative, for x in [sqrt(1/2), sqrt(2)] short enough that x - 1 and x + 1 are exact
+     *  @discussion ln(x) = 2 atanh(s), s = (x - 1) / (x + 1), as in Log2. |s| < 0.172, so past the first two terms
+     *              of the series the rest is under 2**-12 of the total, and double is plenty for it. */
+    constexpr Extended Log2Extended( double x)
+    {
+        constexpr Extended kTwoOverLn2 = { 0x1.71547652b82fep+1, 0x1.777d0ffda0d24p-55 };
+
+        Extended s = Divide( Extended{ x - 1.0, 0}, x + 1.0);
+        Extended s3 = Multiply( Multiply( s, s), s);
+
+        double s2 = s.hi * s.hi;
+        double term = s3.hi * s2;
+        double tail = 0;
+        for( int i = 5; i < 61; i += 2)
+        {
+            tail += term / i;
+            term *= s2;
+        }
+
+        Extended atanh = Add( Add( s, Divide( s3, 3.0)), Extended{ tail, 0});
+        return Multiply( atanh, kTwoOverLn2);
+    }
+}
+
+#endif /* CONSTEXPR_MATH_HPP */
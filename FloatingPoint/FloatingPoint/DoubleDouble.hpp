@@ -0,0 +1,96 @@
+//
+//  DoubleDouble.hpp
+//  FloatingPoint
+//
+//  Double-double arithmetic: a number is the unevaluated sum hi + lo of two doubles, with |lo| <= ulp(hi)/2,
+//  giving about 106 bits of precision. Slow compared to double, but it only takes a few of the usual
+//  floating-point tricks, and it is plenty to decide which way a float result should round.
+//
+//      https://www.davidhbailey.com/dhbpapers/qd.pdf
+//      https://en.wikipedia.org/wiki/2Sum
+//
+//  These depend on every operation being rounded as written: no contraction, no extra precision.
+//
+
+#ifndef DOUBLE_DOUBLE_HPP
+#define DOUBLE_DOUBLE_HPP   1
+
+#include <math.h>
+
+#if __clang__
+#   pragma clang fp contract(off)
+#endif
+
+typedef struct DoubleDouble
+{
+    double  hi;
+    double  lo;
+}DoubleDouble;
+
+/*! @abstract a + b exactly, when |a| >= |b| */
+static inline DoubleDouble FastTwoSum( double a, double b)
+{
+    double s = a + b;
+    return (DoubleDouble){ s, b - (s - a) };
+}
+
+/*! @abstract a + b exactly, for any a and b */
+static inline DoubleDouble TwoSum( double a, double b)
+{
+    double s = a + b;
+    double bb = s - a;
+    return (DoubleDouble){ s, (a - (s - bb)) + (b - bb) };
+}
+
+/*! @abstract a * b exactly, barring underflow. fma() gives us the rounding error of the product. */
+static inline DoubleDouble TwoProduct( double a, double b)
+{
+    double p = a * b;
+    return (DoubleDouble){ p, fma( a, b, -p) };
+}
+
+static inline DoubleDouble Add( DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble s = TwoSum( a.hi, b.hi);
+    DoubleDouble t = TwoSum( a.lo, b.lo);
+    s = FastTwoSum( s.hi, s.lo + t.hi);
+    return FastTwoSum( s.hi, s.lo + t.lo);
+}
+
+static inline DoubleDouble Multiply( DoubleDouble a, DoubleDouble b)
+{
+    DoubleDouble p = TwoProduct( a.hi, b.hi);
+    return FastTwoSum( p.hi, p.lo + (a.hi * b.lo + a.lo * b.hi));
+}
+
+/*! @abstract a / b. Two rounds of long division, with the remainders done exactly. */
+static inline DoubleDouble Divide( DoubleDouble a, DoubleDouble b)
+{
+    double q1 = a.hi / b.hi;
+    DoubleDouble r = Add( a, Multiply( b, (DoubleDouble){ -q1, 0}));
+    double q2 = r.hi / b.hi;
+    r = Add( r, Multiply( b, (DoubleDouble){ -q2, 0}));
+    double q3 = r.hi / b.hi;
+    DoubleDouble q = FastTwoSum( q1, q2);
+    return Add( q, (DoubleDouble){ q3, 0});
+}
+
+/*! @abstract Round hi + lo to the nearest float, ties to even. (float) hi alone can be wrong when hi is exactly half way between two floats. */
+static inline float DoubleDoubleToFloat( DoubleDouble a)
+{
+    float f = (float) a.hi;
+    double error = a.hi - (double) f;               // exact
+    if( 0 == a.lo || 0 == error )
+        return f;
+
+    // hi is a tie only if the error is exactly half an ulp of f
+    float other = nextafterf( f, error > 0 ? INFINITY : -INFINITY);
+    double half = ((double) other - (double) f) * 0.5;
+    if( error != half )
+        return f;
+
+    // The tie went to f. lo decides if it should have gone the other way.
+    return (a.lo > 0) == (error > 0) ? other : f;
+}
+
+#endif /* DOUBLE_DOUBLE_HPP */
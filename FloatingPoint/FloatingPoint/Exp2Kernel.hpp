@@ -0,0 +1,100 @@
+//
+//  Exp2Kernel.hpp
+//  FloatingPoint
+//
+//  2**x for float results, using a table and a short polynomial, evaluated in double. The mirror image of
+//  Log2Kernel.hpp, and built the same way: the table and the polynomial are made by constexpr code.
+//
+//  Range reduction:   t = k + j/N + r,  with integer k, 0 <= j < N = kTableSize, and |r| <= 1/(2N)
+//                     2**t = 2**k  2**(j/N)  2**r
+//
+//  2**k goes straight into the exponent bits, 2**(j/N) comes from the table, and 2**r is a polynomial of
+//  degree kDegree - 1 in r. The rounding to a multiple of 1/N is done by adding and subtracting a large
+//  constant, which leaves round(t N) in the low bits of the sum, where we can read it as an integer.
+//
+//      kTableSize  kDegree     table bytes     |relative error| of 2**r before final rounding
+//          16         4            128             2**-29.7
+//          32         4            256             2**-33.7
+//          64         3            512             2**-27.2
+//
+
+#ifndef EXP2_KERNEL_HPP
+#define EXP2_KERNEL_HPP     1
+
+#include "ConstexprMath.hpp"
+#include "Polynomial.hpp"
+#include <math.h>
+#include <stdint.h>
+
+namespace Exp2KernelDetail
+{
+    template <unsigned kTableSize>
+    struct Table
+    {
+        double  scale[kTableSize];      // 2**(j/N)
+    };
+
+    template <unsigned kTableSize>
+    constexpr Table<kTableSize> MakeTable()
+    {
+        Table<kTableSize> table = {};
+        for( unsigned j = 0; j < kTableSize; j++)
+            table.scale[j] = ConstexprMath::Exp2( double(j) / kTableSize);
+        return table;
+    }
+
+    /*! @abstract 2**k, for -1022 <= k <= 1023, straight from the bits */
+    static inline double Pow2( int64_t k)
+    {
+        union{ uint64_t u; double d; }u = { uint64_t(k + 1023) << 52 };
+        return u.d;
+    }
+}
+
+template <unsigned kTableSize, unsigned kDegree>
+struct Exp2Kernel
+{
+    static_assert( kTableSize >= 2 && kTableSize <= 4096 && 0 == (kTableSize & (kTableSize - 1)), "kTableSize must be a power of two" );
+
+    static constexpr int kTableBits = __builtin_ctz( kTableSize);
+    static constexpr Exp2KernelDetail::Table<kTableSize> kTable = Exp2KernelDetail::MakeTable<kTableSize>();
+    static constexpr Polynomial<kDegree> kPolynomial = FitPolynomial<kDegree>( ConstexprMath::Exp2, 0.5 / kTableSize);
+    static constexpr double kPolynomialError = kPolynomial.error;
+    static constexpr size_t kTableBytes = sizeof(kTable.scale);
+
+    /*! @abstract 2**t, before rounding to float, for |t| < 1000. No special cases. */
+    static inline double EvaluateUnrounded( double t)
+    {
+#if __clang__
+        // No FMA contraction, so the answer is the same on every machine, with or without FMA hardware
+#   pragma clang fp contract(off)
+#endif
+        // 1.5 * 2**52 / N has an ulp of 1/N, so adding it rounds t to the nearest multiple of 1/N. It stays in
+        // the same binade for any t we take, so the difference of the encodings is round(t N) as an integer.
+        constexpr double kShift = 0x1.8p52 / kTableSize;
+        union{ double d; int64_t i; }shifted = { t + kShift }, shift = { kShift };
+        int64_t n = shifted.i - shift.i;
+        double r = t - (shifted.d - kShift);                // exact
+
+        double scale = kTable.scale[n & (kTableSize - 1)] * Exp2KernelDetail::Pow2( n >> kTableBits);
+        return scale * kPolynomial(r);
+    }
+
+    static inline float Evaluate( float x)
+    {
+        // Outside (-160, 128), 2**x is 0 or infinite in float. NaN lands here too.
+        if( __builtin_expect( !(x > -160.0f && x < 128.0f), 0) )
+        {
+            if( x != x )
+                return x + x;
+            return x > 0 ? INFINITY : 0.0f;
+        }
+        return (float) EvaluateUnrounded(x);
+    }
+};
+
+/*! @abstract The variant Exp2() and Expm1() use: a 256 byte table, and a cubic good to about 2**-33.7 */
+typedef Exp2Kernel<32, 4>   DefaultExp2Kernel;
+static_assert( DefaultExp2Kernel::kPolynomialError < 0.01 * 0x1.0p-24, "Exp2 would not stay within 0.51 ulps" );   // 0.01 ulps, plus 0.5 for rounding
+
+#endif /* EXP2_KERNEL_HPP */
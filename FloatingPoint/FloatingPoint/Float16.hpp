@@ -0,0 +1,81 @@
+//
+//  Float16.hpp
+//  FloatingPoint
+//
+//  The two 16-bit floating-point formats in common use for machine learning:
+//
+//      IEEE-754 binary16 ("half"), _Float16 in C:  1 sign bit, 5 exponent bits, 10 mantissa bits
+//      bfloat16:                                   1 sign bit, 8 exponent bits,  7 mantissa bits
+//
+//  Half has more precision and far less range. bfloat16 is just the top half of a float: same range, much
+//  less precision, and converting to float is a shift.
+//
+//  The compiler knows about _Float16, and converts it to and from float in hardware where it can (F16C,
+//  arm64) or in software where it can't. It does not know about bfloat16, so that is a struct holding the
+//  bits, with conversions here.
+//
+//      https://en.wikipedia.org/wiki/Half-precision_floating-point_format
+//      https://en.wikipedia.org/wiki/Bfloat16_floating-point_format
+//
+
+#ifndef FLOAT16_HPP
+#define FLOAT16_HPP     1
+
+#include <stdint.h>
+
+typedef struct BFloat16
+{
+    uint16_t    bits;
+}BFloat16;
+
+/*! @abstract bfloat16 to float. Exact. */
+static inline float FloatFromBFloat16( BFloat16 x)
+{
+    union{ uint32_t u; float f; }u = { uint32_t(x.bits) << 16 };
+    return u.f;
+}
+
+/*! @abstract float to bfloat16, rounding to nearest, ties to even. NaNs stay NaN, quieted, like a float conversion would. */
+static inline BFloat16 BFloat16FromFloat( float x)
+{
+    union{ float f; uint32_t u; }u = {x};
+    if( (u.u << 1) > 0xff000000U )                  // NaN. Don't let rounding carry into the exponent.
+        return (BFloat16){ uint16_t((u.u >> 16) | 0x0040U) };
+
+    // Add just under half of the bits we drop, plus one more if the lowest bit we keep is odd
+    uint32_t rounded = u.u + 0x7fffU + ((u.u >> 16) & 1U);
+    return (BFloat16){ uint16_t(rounded >> 16) };
+}
+
+/*! @abstract The format of each 16-bit type, for code that works on the encodings */
+template <typename T> struct Float16Format;
+template <> struct Float16Format<_Float16>
+{
+    static constexpr int kMantissaBits = 10;
+    static constexpr int kMinExponent = -14;        // of the smallest normal number
+    static constexpr int kMaxExponent = 15;         // of the largest finite number
+    static constexpr const char * kName = "half";
+};
+template <> struct Float16Format<BFloat16>
+{
+    static constexpr int kMantissaBits = 7;
+    static constexpr int kMinExponent = -126;
+    static constexpr int kMaxExponent = 127;
+    static constexpr const char * kName = "bfloat16";
+};
+
+/*! @abstract The encoding of a 16-bit value, and back */
+static inline uint16_t Float16Bits( _Float16 x){ union{ _Float16 h; uint16_t u; }u = {x}; return u.u; }
+static inline uint16_t Float16Bits( BFloat16 x){ return x.bits; }
+template <typename T> static inline T Float16FromBits( uint16_t bits);
+template <> inline _Float16 Float16FromBits<_Float16>( uint16_t bits){ union{ uint16_t u; _Float16 h; }u = {bits}; return u.h; }
+template <> inline BFloat16 Float16FromBits<BFloat16>( uint16_t bits){ return (BFloat16){ bits }; }
+
+/*! @abstract Widen to float, exactly, and narrow from float, rounding to nearest. Overloaded so templates can do either format. */
+static inline float ToFloat( _Float16 x){ return (float) x; }
+static inline float ToFloat( BFloat16 x){ return FloatFromBFloat16(x); }
+template <typename T> static inline T FromFloat( float x);
+template <> inline _Float16 FromFloat<_Float16>( float x){ return (_Float16) x; }
+template <> inline BFloat16 FromFloat<BFloat16>( float x){ return BFloat16FromFloat(x); }
+
+#endif /* FLOAT16_HPP */
@@ -0,0 +1,80 @@
+//
+//  FlushToZero.hpp
+//  FloatingPoint
+//
+//  Subnormal numbers are slow. On most Intel and AMD parts an instruction that takes a subnormal input or makes a
+//  subnormal result is finished by a microcode assist, which costs on the order of 100 cycles rather than 4. The
+//  hardware can skip the assist by treating subnormal inputs as zero (DAZ, "denormals are zero") and returning zero
+//  for results that would be subnormal (FTZ, "flush to zero"). Both are bits in the per-thread control register:
+//  MXCSR on Intel, FPCR on arm64, where the one FZ bit does both.
+//
+//  This is a gross violation of IEEE-754, so it is off unless asked for. See Math.hpp for the array functions that
+//  use it with results that are defined on every input.
+//
+//      https://en.wikipedia.org/wiki/Subnormal_number#Performance_issues
+//
+
+#ifndef FLUSH_TO_ZERO_HPP
+#define FLUSH_TO_ZERO_HPP   1
+
+#include <stdint.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#   include <immintrin.h>
+#endif
+
+/*! @abstract While one of these is alive, the current thread's floating-point unit treats subnormal inputs as zero
+ *            and flushes subnormal results to zero. The previous mode comes back when it is destroyed.
+ *  @discussion Only arithmetic done by the hardware is affected. Code that looks at the bits of a float, like Floor and
+ *              the special cases of Log2, still sees the subnormal, so the Math.hpp scalar and plain array functions
+ *              make no promises about subnormals inside one of these. The FTZ array functions do.
+ *              Pass false to make a scope that does nothing, for code that only sometimes wants it. */
+struct FlushToZeroScope
+{
+#if defined(__x86_64__) || defined(__i386__)
+    typedef uint32_t    Control;
+    static constexpr Control kFlushToZeroBits = 0x8040;     // FTZ (bit 15) | DAZ (bit 6)
+    static inline Control ReadControl(void){ return _mm_getcsr(); }
+    static inline void WriteControl( Control c){ _mm_setcsr(c); }
+#elif defined(__aarch64__)
+    typedef uint64_t    Control;
+    static constexpr Control kFlushToZeroBits = 1ULL << 24; // FZ
+    static inline Control ReadControl(void){ Control c; asm volatile( "mrs %0, fpcr" : "=r"(c)); return c; }
+    static inline void WriteControl( Control c){ asm volatile( "msr fpcr, %0" : : "r"(c)); }
+#else
+    typedef uint32_t    Control;
+    static constexpr Control kFlushToZeroBits = 0;          // no such mode: subnormals are just slow
+    static inline Control ReadControl(void){ return 0; }
+    static inline void WriteControl( Control){}
+#endif
+
+    explicit FlushToZeroScope( bool enable = true) : saved( ReadControl()), enabled(enable)
+    {
+        if( enabled )
+            WriteControl( saved | kFlushToZeroBits);
+    }
+
+    ~FlushToZeroScope()
+    {
+        if( enabled )
+            WriteControl( saved);
+    }
+
+    FlushToZeroScope( const FlushToZeroScope &) = delete;
+    FlushToZeroScope & operator=( const FlushToZeroScope &) = delete;
+
+private:
+    Control     saved;
+    bool        enabled;
+};
+
+/*! @abstract x, or a zero of the same sign if x is subnormal. Done on the bits, so it is never slow itself, and
+ *            without a branch, so a loop of them vectorizes. */
+static inline float FlushSubnormal( float x)
+{
+    union{ float f; uint32_t u; }u = {x};
+    u.u &= (u.u & 0x7f800000U) ? 0xffffffffU : 0x80000000U;
+    return u.f;
+}
+
+#endif /* FLUSH_TO_ZERO_HPP */
@@ -0,0 +1,294 @@
+//
+//  KernelTuner.cpp
+//  FloatingPoint
+//
+//  A profile looks like this:
+//
+//      cpu=AMD EPYC 9654 96-Core Processor (family 0x19, model 0x11, stepping 1)
+//      floor=avx2
+//      round=avx512
+//      rint<Up>=sse4.1
+//
+//  It is rewritten (to a temporary file, then renamed over the old one) each time a function is tuned.
+//
+
+#include "KernelTuner.hpp"
+#include "Benchmark.hpp"
+#include "VectorISA.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+
+#pragma mark - Correctness gate
+
+static constexpr size_t kGateInputCount = 8192;
+
+static inline float BitsFloat( uint32_t u){ union{ uint32_t u; float f; }f = {u}; return f.f; }
+static inline uint32_t FloatBits( float f){ union{ float f; uint32_t u; }u = {f}; return u.u; }
+
+/*! @abstract The inputs every variant is checked on. Made once. */
+static const float * GateInputs(void)
+{
+    static float input[kGateInputCount];
+    static const bool once = []()
+    {
+        size_t n = 0;
+        auto add = [&]( uint32_t bits)
+        {
+            if( n + 2 <= kGateInputCount )
+            {
+                input[n++] = BitsFloat( bits);
+                input[n++] = BitsFloat( bits ^ 0x80000000U);           // and its negative
+            }
+        };
+
+        // Zeros, the smallest and largest subnormals, FLT_MIN, FLT_MAX, infinities, quiet and signaling NaNs with payloads
+        const uint32_t specials[] = { 0, 1, 2, 0x7fffff, 0x800000, 0x7f7fffff, 0x7f800000, 0x7fc00000, 0x7fc00001, 0x7f800001, 0x7fbfffff };
+        for( uint32_t bits : specials )
+            add( bits);
+
+        // Every binade: its first value, the one just below it, the middle, and the last
+        for( uint32_t exponent = 1; exponent < 0xff; exponent++)
+        {
+            add( exponent << 23);
+            add( (exponent << 23) - 1);
+            add( (exponent << 23) | 0x400000);
+            add( (exponent << 23) | 0x7fffff);
+        }
+
+        // Half-way cases and their neighbors, among the small integers and at the top of the integral range
+        for( int k = 0; k < 64; k++)
+        {
+            uint32_t half = FloatBits( (float) k + 0.5f);
+            add( half - 1);
+            add( half);
+            add( half + 1);
+        }
+        for( float x : { 0x1.0p22f, 0x1.0p23f, 0x1.0p24f } )
+            for( int d = -3; d <= 3; d++)
+                add( FloatBits(x) + uint32_t(d));
+
+        // The rest are random encodings, from a fixed seed, so every run checks the same ones
+        uint32_t state = 0x9e3779b9U;
+        while( n < kGateInputCount )
+        {
+            state ^= state << 13;   state ^= state >> 17;   state ^= state << 5;       // xorshift32
+            add( state);
+        }
+        return true;
+    }();
+    (void) once;
+    return input;
+}
+
+/*! @abstract true if f gives the same results as reference on every gate input, called in pieces that leave
+ *            misaligned starts and partial vectors */
+static bool PassesGate( ArrayFunction f, ArrayFunction reference)
+{
+    const float * input = GateInputs();
+    static float expected[kGateInputCount], test[kGateInputCount];
+    reference( input, expected, kGateInputCount);
+
+    const size_t splits[] = { 0, 1, 38, kGateInputCount - 5, kGateInputCount };
+    for( size_t i = 0; i + 1 < sizeof(splits) / sizeof(splits[0]); i++)
+        f( input + splits[i], test + splits[i], splits[i+1] - splits[i]);
+
+    for( size_t i = 0; i < kGateInputCount; i++)
+        if( FloatBits( test[i]) != FloatBits( expected[i]) && ! (isnan( test[i]) && isnan( expected[i])) )
+            return false;
+    return true;
+}
+
+#pragma mark - Timing
+
+static constexpr size_t kTimedCount = 1024;
+
+/*! @abstract One call of an array function over typical inputs */
+typedef struct ArrayWorkload
+{
+    ArrayFunction   f;
+    const float *   input;
+    float *         output;
+
+    inline void operator()(){ f( input, output, kTimedCount); }
+}ArrayWorkload;
+
+/*! @abstract Cycles per element for f, on ordinary numbers of every size. The minimum, which noise can only make larger,
+ *            so a few dozen measurements do. More would put seconds on the first call of an array function. */
+static double TimeVariant( ArrayFunction f)
+{
+    static float input[kTimedCount], output[kTimedCount];
+    for( size_t i = 0; i < kTimedCount; i++)
+        input[i] = ldexpf( 0.75f + (float)(i % 256) * 0.37f, int(i % 61) - 30) * (i & 1 ? -1.0f : 1.0f);
+
+    ArrayWorkload work = { f, input, output };
+    return BenchmarkFunctor<ArrayWorkload, CycleClock>( work, 0.02, 40).minimumTime / kTimedCount;
+}
+
+#pragma mark - Profile
+
+typedef struct ProfileEntry
+{
+    char    function[32];
+    char    variant[32];
+}ProfileEntry;
+
+static constexpr size_t kMaxProfileEntries = 64;
+
+typedef struct TuningProfile
+{
+    char            path[1024];             // empty if we don't keep one
+    size_t          count;
+    ProfileEntry    entries[kMaxProfileEntries];
+}TuningProfile;
+
+static void LoadProfile( TuningProfile * profile)
+{
+    memset( profile, 0, sizeof(*profile));
+    const char * path = getenv( "FP_TUNING_PROFILE");
+    const char * home = getenv( "HOME");
+    if( path )
+        snprintf( profile->path, sizeof(profile->path), "%s", path);
+    else if( home && *home )
+        snprintf( profile->path, sizeof(profile->path), "%s/.cache/FloatingPoint.tuning", home);
+    if( '\0' == profile->path[0] )
+        return;
+
+    FILE * f = fopen( profile->path, "r");
+    if( NULL == f )
+        return;
+
+    // Only believe it if it was made on this kind of CPU
+    char line[256];
+    bool sameCPU = false;
+    while( fgets( line, sizeof(line), f) )
+    {
+        line[ strcspn( line, "\n")] = '\0';
+        char * value = strchr( line, '=');
+        if( NULL == value )
+            continue;
+        *value++ = '\0';
+
+        if( 0 == strcmp( line, "cpu") )
+            sameCPU = 0 == strcmp( value, CPUModelName());
+        else if( sameCPU && profile->count < kMaxProfileEntries &&
+                 strlen(line) < sizeof(ProfileEntry::function) && strlen(value) < sizeof(ProfileEntry::variant) )
+        {
+            strcpy( profile->entries[profile->count].function, line);
+            strcpy( profile->entries[profile->count].variant, value);
+            profile->count++;
+        }
+    }
+    fclose(f);
+}
+
+static void SaveProfile( const TuningProfile & profile)
+{
+    if( '\0' == profile.path[0] )
+        return;
+
+    // $HOME/.cache may not be there yet. If this fails, so will the fopen, and we just don't save.
+    char directory[1024];
+    snprintf( directory, sizeof(directory), "%s", profile.path);
+    if( char * slash = strrchr( directory, '/') )
+    {
+        *slash = '\0';
+        mkdir( directory, 0755);
+    }
+
+    char tempPath[1040];
+    snprintf( tempPath, sizeof(tempPath), "%s.%d.tmp", profile.path, (int) getpid());
+    FILE * f = fopen( tempPath, "w");
+    if( NULL == f )
+        return;
+
+    fprintf( f, "cpu=%s\n", CPUModelName());
+    for( size_t i = 0; i < profile.count; i++)
+        fprintf( f, "%s=%s\n", profile.entries[i].function, profile.entries[i].variant);
+    if( 0 != fclose(f) || 0 != rename( tempPath, profile.path) )
+        unlink( tempPath);
+}
+
+/*! @abstract The profile's choice for function, or NULL */
+static const char * FindProfileEntry( const TuningProfile & profile, const char * function)
+{
+    for( size_t i = 0; i < profile.count; i++)
+        if( 0 == strcmp( profile.entries[i].function, function) )
+            return profile.entries[i].variant;
+    return NULL;
+}
+
+static void SetProfileEntry( TuningProfile * profile, const char * function, const char * variant)
+{
+    size_t i = 0;
+    while( i < profile->count && strcmp( profile->entries[i].function, function) )
+        i++;
+    if( i == kMaxProfileEntries || strlen(function) >= sizeof(ProfileEntry::function) || strlen(variant) >= sizeof(ProfileEntry::variant) )
+        return;
+
+    snprintf( profile->entries[i].function, sizeof(ProfileEntry::function), "%s", function);
+    snprintf( profile->entries[i].variant, sizeof(ProfileEntry::variant), "%s", variant);
+    if( i == profile->count )
+        profile->count++;
+}
+
+#pragma mark - Tuning
+
+size_t TuneArrayKernel( const char * function, const KernelVariant * variants, size_t count, ArrayFunction reference)
+{
+    static std::mutex lock;                 // the 32 and 16-bit kernels may be set up on different threads
+    static TuningProfile profile;
+    static bool loaded = false;
+    std::lock_guard<std::mutex> guard( lock);
+    if( ! loaded )
+    {
+        LoadProfile( &profile);
+        loaded = true;
+    }
+
+    bool passed[count];
+    for( size_t i = 0; i < count; i++)
+    {
+        passed[i] = PassesGate( variants[i].f, reference);
+        if( ! passed[i] )
+            fprintf( stderr, "The %s kernel for %s gives wrong answers. It won't be used.\n", variants[i].name, function);
+    }
+
+    // Nothing to choose between
+    size_t passing = 0, only = count;
+    for( size_t i = 0; i < count; i++)
+        if( passed[i] )
+        {
+            passing++;
+            only = i;
+        }
+    if( passing <= 1 )
+        return only;
+
+    if( const char * saved = FindProfileEntry( profile, function) )
+        for( size_t i = 0; i < count; i++)
+            if( passed[i] && 0 == strcmp( saved, variants[i].name) )
+                return i;
+
+    size_t best = count;
+    double bestTime = INFINITY;
+    for( size_t i = 0; i < count; i++)
+        if( passed[i] )
+        {
+            double time = TimeVariant( variants[i].f);
+            if( time < bestTime )
+            {
+                best = i;
+                bestTime = time;
+            }
+        }
+
+    SetProfileEntry( &profile, function, variants[best].name);
+    SaveProfile( profile);
+    return best;
+}
@@ -0,0 +1,43 @@
+//
+//  KernelTuner.hpp
+//  FloatingPoint
+//
+//  Pick the fastest of several interchangeable array kernels by timing them on this machine.
+//
+//  The widest vector unit isn't always the fastest. Some parts run 512-bit instructions at a lower clock, or
+//  split them in two, and which of roundps, vrndscaleps or a plain integer loop wins differs from one CPU to the
+//  next. So rather than trust the instruction set alone, the first use of an array function times every variant
+//  this CPU can run and binds the winner. Results go in a profile on disk, keyed by the CPU model, so later runs
+//  skip the timing. A profile from another CPU is ignored and rewritten.
+//
+//  A variant has to earn its place first. Each one is checked against the reference variant, bit for bit, on a
+//  few thousand inputs chosen to catch the usual bugs: signed zeros, NaNs, infinities, subnormals, half-way cases,
+//  binade edges and the ends of the integral range, over lengths that leave partial vectors at both ends.
+//  One that fails is never picked, even if the profile says to.
+//
+//  The profile lives at $FP_TUNING_PROFILE, or else $HOME/.cache/FloatingPoint.tuning. Set FP_TUNING_PROFILE
+//  to an empty string to time every run and save nothing.
+//
+
+#ifndef KERNEL_TUNER_HPP
+#define KERNEL_TUNER_HPP    1
+
+#include <stddef.h>
+
+typedef void (*ArrayFunction)( const float * src, float * dst, size_t count);
+
+/*! @abstract One implementation of an array function */
+typedef struct KernelVariant
+{
+    const char *    name;           // e.g. "avx2". Unique among the variants of a function. This is what the profile saves.
+    ArrayFunction   f;
+}KernelVariant;
+
+/*! @abstract Return the index of the fastest of variants that gives the same results as reference.
+ *  @discussion function names the function in the profile, e.g. "floor". NaNs must come back as NaNs, and
+ *              everything else must be identical in every bit. If no variant passes, returns count, and
+ *              the caller should use the reference. Thread safe, but calls are serialized, and the first
+ *              one for a function may take a good fraction of a second. */
+size_t TuneArrayKernel( const char * function, const KernelVariant * variants, size_t count, ArrayFunction reference);
+
+#endif /* KERNEL_TUNER_HPP */
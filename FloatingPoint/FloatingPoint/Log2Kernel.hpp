@@ -0,0 +1,496 @@
+//
+//  Log2Kernel.hpp
+//  FloatingPoint
+//
+//  log2 of a float, using a table and a short polynomial, evaluated in double.
+//
+//  Range reduction:   x = 2**k z,  with z in [~0.71, ~1.43) so that log2(z) is small
+//                     z = c (1 + r), where c is the center of the one of kTableSize subintervals that holds z
+//                     log2(x) = k + log2(c) + log2(1 + r)
+//
+//  The table holds 1/c and log2(c). 1/c is rounded to float so that z * (1/c) is exact in double, which makes
+//  r exact too. log2(1 + r) = r Q(r) is then a polynomial of degree kDegree in r, which is small because the
+//  subintervals are: bigger tables mean smaller r, so the polynomial can be shorter for the same accuracy.
+//
+//  The subintervals are arranged so that 1.0 is in the middle of one of them, where c = 1 and log2(c) = 0.
+//  Then near x = 1, where log2(x) goes to 0, the answer is just r Q(r) with no cancellation, and it has
+//  the same relative accuracy as everywhere else.
+//
+//  Both the table and the polynomial coefficients are computed by constexpr code (see ConstexprMath.hpp)
+//  when the template is instantiated, so making a new variant is just a matter of picking new parameters.
+//  Variants we have tried, with the polynomial error estimated in Log2Kernel::kPolynomialError:
+//
+//      kTableSize  kDegree     table bytes     |relative error| before final rounding
+//          16         6            256             2**-37.8
+//          64         4           1024             2**-33.3
+//          64         3           1024             2**-25.0    too big: 0.92 ulps, fails the 0.51 ulp test
+//         128         4           2048             2**-37.3
+//         256         3           4096             2**-31.0
+//         256         2           4096             2**-20.6    too big: 11 ulps
+//
+//  Anything under ~2**-30.7 gets within 0.51 ulps after rounding to float: that is 0.01 ulps even where a float
+//  ulp is 2**-24 of the value, leaving 0.5 for the rounding.
+//
+
+#ifndef LOG2_KERNEL_HPP
+#define LOG2_KERNEL_HPP     1
+
+#include "ConstexprMath.hpp"
+#include "Polynomial.hpp"
+#include <math.h>
+#include <stdint.h>
+
+namespace Log2KernelDetail
+{
+    static constexpr uint32_t kOne = 0x3f800000;
+
+    /*! @abstract How z is cut into kTableSize subintervals */
+    template <unsigned kTableSize>
+    struct Geometry
+    {
+        static_assert( kTableSize >= 2 && kTableSize <= 4096 && 0 == (kTableSize & (kTableSize - 1)), "kTableSize must be a power of two" );
+
+        static constexpr int kTableBits = __builtin_ctz( kTableSize);
+
+        // Width of a subinterval, in float encodings
+        static constexpr uint32_t kSubintervalWidth = 1U << (23 - kTableBits);
+
+        // z covers encodings [kOffset, kOffset + 2**23), starting near sqrt(1/2), and placed so 1.0 is mid-subinterval
+        static constexpr uint32_t kOffset = kOne - ((kOne - 0x3f3504f3 - kSubintervalWidth / 2) / kSubintervalWidth) * kSubintervalWidth
+                                                 - kSubintervalWidth / 2;
+        static constexpr uint32_t kCenterIndex = (kOne - kOffset) / kSubintervalWidth;
+    };
+
+    typedef struct Entry
+    {
+        double  invc;       // 1/c, rounded to float
+        double  logc;       // log2(c) = -log2(invc)
+    }Entry;
+
+    template <unsigned kTableSize>
+    struct Table
+    {
+        Entry   entries[kTableSize];
+        double  maxReduced;     // largest |r|
+    };
+
+    template <unsigned kTableSize>
+    constexpr Table<kTableSize> MakeTable()
+    {
+        typedef Geometry<kTableSize> G;
+        Table<kTableSize> table = {};
+        for( uint32_t i = 0; i < kTableSize; i++)
+        {
+            double low = ConstexprMath::FloatFromBits( G::kOffset + i * G::kSubintervalWidth);
+            double high = ConstexprMath::FloatFromBits( G::kOffset + (i + 1) * G::kSubintervalWidth);
+            double invc = 1.0;
+            if( G::kCenterIndex != i )
+                invc = ConstexprMath::RoundToFloat( 2.0 / (low + high));
+
+            table.entries[i].invc = invc;
+            table.entries[i].logc = G::kCenterIndex == i ? 0.0 : -ConstexprMath::Log2( invc);
+
+            double rLow = 1.0 - low * invc;
+            double rHigh = high * invc - 1.0;
+            double r = rLow > rHigh ? rLow : rHigh;
+            if( r > table.maxReduced )
+                table.maxReduced = r;
+        }
+        return table;
+    }
+
+    /*! @abstract log2(1 + r) / r, by its Taylor series. Only used to fit the polynomial, for |r| well under 1. */
+    constexpr double Quotient( double r)
+    {
+        double term = 1.0;
+        double sum = 0;
+        for( int i = 1; i < 40; i++)
+        {
+            sum += term / i;
+            term *= -r;
+        }
+        return sum / ConstexprMath::kLn2;
+    }
+}
+
+template <unsigned kTableSize, unsigned kDegree>
+struct Log2Kernel
+{
+    typedef Log2KernelDetail::Geometry<kTableSize> Geometry;
+
+    static constexpr Log2KernelDetail::Table<kTableSize> kTable = Log2KernelDetail::MakeTable<kTableSize>();
+    static constexpr Polynomial<kDegree> kPolynomial = FitPolynomial<kDegree>( Log2KernelDetail::Quotient, kTable.maxReduced);
+    static constexpr double kPolynomialError = kPolynomial.error;
+    static constexpr size_t kTableBytes = sizeof(kTable.entries);
+
+    /*! @abstract Split the encoding of a positive normal float into 2**k z, and find the subinterval i that holds z */
+    static inline void Reduce( uint32_t ix, int32_t * k, uint32_t * i, float * z)
+    {
+        uint32_t tmp = ix - Geometry::kOffset;
+        *i = (tmp >> (23 - Geometry::kTableBits)) % kTableSize;
+        *k = int32_t(tmp) >> 23;
+        union{ uint32_t u; float f; }u = { ix - (tmp & 0xff800000U) };
+        *z = u.f;
+    }
+
+    /*! @abstract log2(1 + r) = r Q(r), for |r| <= kTable.maxReduced. Keeps the sign of r = -0. */
+    static inline double Reduced( double r)
+    {
+        return kPolynomial(r) * r;
+    }
+
+    /*! @abstract log2(2**k c (1 + r)) = k + log2(c) + r Q(r), where c is the center of subinterval i, and a bound on its error
+     *  @discussion The bound covers the polynomial error (doubled, because kPolynomialError is from sampling, not
+     *              a proof) and the rounding errors of evaluating it in double. r must be exact. */
+    static inline double Reconstruct( double r, uint32_t i, int32_t k, double * error)
+    {
+#if __clang__
+        // No FMA contraction, so the answer is the same on every machine, with or without FMA hardware
+#   pragma clang fp contract(off)
+#endif
+        const Log2KernelDetail::Entry & entry = kTable.entries[i];
+        double p = Reduced(r);
+        double result = p + (entry.logc + (double) k);
+        *error = fabs(p) * (2.0 * kPolynomialError + 0x1.0p-49) + fabs(result) * 0x1.0p-49;
+        return result;
+    }
+
+    /*! @abstract log2(x) before the final rounding to float, and a bound on how far that is from the exact answer
+     *  @discussion Special cases are exact, with *error = 0. */
+    static inline double EvaluateUnrounded( float x, double * error)
+    {
+#if __clang__
+#   pragma clang fp contract(off)
+#endif
+        union{ float f; uint32_t u; }u = {x};
+        uint32_t ix = u.u;
+        *error = 0;
+
+        // Zero, negative, subnormal, infinity and NaN all land here
+        if( __builtin_expect( ix - 0x00800000U >= 0x7f800000U - 0x00800000U, 0) )
+        {
+            if( 0 == (ix << 1) )                // +-0
+                return -INFINITY;
+            if( 0x7f800000U == ix )             // +inf
+                return x;
+            if( (ix >> 31) || (ix << 1) >= 0xff000000U )  // negative or NaN
+                return (x - x) / (x - x);
+
+            // Subnormal: normalize, and take the 23 back off the exponent. This is not a real encoding
+            // any more, but the arithmetic below doesn't care.
+            u.f = x * 0x1.0p23f;
+            ix = u.u - (23U << 23);
+        }
+
+        // x = 2**k z, z = c (1 + r). 1/c is a float, so r is exact.
+        int32_t k;
+        uint32_t i;
+        float z;
+        Reduce( ix, &k, &i, &z);
+        double r = (double) z * kTable.entries[i].invc - 1.0;
+        return Reconstruct( r, i, k, error);
+    }
+
+    /*! @abstract log2(x) before rounding, for a double x that rounds to a positive normal float. For Log1p, where x = 1 + y is only exact in double.
+     *  @discussion The subinterval comes from x rounded to float, but z is the exact x scaled by 2**-k. z has more
+     *              bits than a float now, so r is rounded, except in the center subinterval where 1/c = 1. */
+    static inline double EvaluateUnrounded( double x, double * error)
+    {
+#if __clang__
+#   pragma clang fp contract(off)
+#endif
+        union{ float f; uint32_t u; }u = {(float) x};
+        int32_t k;
+        uint32_t i;
+        float unused;
+        Reduce( u.u, &k, &i, &unused);
+
+        union{ double d; uint64_t u; }z = {x};
+        z.u -= uint64_t(int64_t(k)) << 52;
+        double r = z.d * kTable.entries[i].invc - 1.0;
+        double result = Reconstruct( r, i, k, error);
+        *error += 0x1.0p-52;
+        return result;
+    }
+
+    static inline float Evaluate( float x)
+    {
+        double unused;
+        return (float) EvaluateUnrounded( x, &unused);
+    }
+};
+
+/*! @abstract The variant Log2() uses: a 1 kB table, and a polynomial accurate to about 2**-33 */
+typedef Log2Kernel<64, 4>   DefaultLog2Kernel;
+static_assert( DefaultLog2Kernel::kPolynomialError < 0.01 * 0x1.0p-24, "Log2 would not stay within 0.51 ulps" );
+
+/*! @abstract The variant Log2<Accuracy::CorrectlyRounded>() starts with. The more accurate this is, the less often
+ *            the result lands too close to a rounding boundary to call, and we have to take the slow path. At 2**-37,
+ *            that is about 1 in 2000 inputs. */
+typedef Log2Kernel<128, 4>  CorrectlyRoundedLog2Kernel;
+
+
+#pragma mark - Fast
+
+/*  Log2<Accuracy::Fast>() gives up most of the accuracy for speed: no table, and everything in float.
+ *
+ *      x = 2**k m,  with m in [sqrt(1/2), sqrt(2))
+ *      log2(x) = k + r Q(r),  r = m - 1
+ *
+ *  r is exact (Sterbenz), and Q is a quartic, good to about 2**-12.4 relative error. Near x = 1, where k = 0,
+ *  that is the relative error of the answer; elsewhere |log2(x)| >= 1/2 and it is smaller. Each extra degree
+ *  buys about 2.4 bits: 2**-10 for a cubic, 2**-14.8 for a quintic. */
+template <unsigned kDegree>
+struct FastLog2Kernel
+{
+    static constexpr double kMaxReduced = 0.41421356237309515;         // sqrt(2) - 1
+    static constexpr Polynomial<kDegree> kPolynomial = FitPolynomial<kDegree>( Log2KernelDetail::Quotient, kMaxReduced);
+    static constexpr double kPolynomialError = kPolynomial.error;
+
+    static inline float Evaluate( float x)
+    {
+#if __clang__
+#   pragma clang fp contract(off)
+#endif
+        union{ float f; uint32_t u; }u = {x};
+        uint32_t ix = u.u;
+
+        // Same special cases as Log2Kernel
+        if( __builtin_expect( ix - 0x00800000U >= 0x7f800000U - 0x00800000U, 0) )
+        {
+            if( 0 == (ix << 1) )
+                return -INFINITY;
+            if( 0x7f800000U == ix )
+                return x;
+            if( (ix >> 31) || (ix << 1) >= 0xff000000U )
+                return (x - x) / (x - x);
+            u.f = x * 0x1.0p23f;
+            ix = u.u - (23U << 23);
+        }
+
+        uint32_t tmp = ix - 0x3f3504f3U;                    // sqrt(1/2)
+        int32_t k = int32_t(tmp) >> 23;
+        union{ uint32_t u; float f; }m = { ix - (tmp & 0xff800000U) };
+
+        // Q(r) by Estrin's scheme: pairs (c[j] + c[j+1] r), then a polynomial in r**2 of those. Half the dependency
+        // chain of Horner's rule, and with so few good bits needed, rounding differences don't matter.
+        float r = m.f - 1.0f;
+        float r2 = r * r;
+        float q = (kDegree & 1) ? (float) kPolynomial.c[kDegree - 1]
+                                : (float) kPolynomial.c[kDegree - 2] + (float) kPolynomial.c[kDegree - 1] * r;
+        for( int j = int((kDegree - 1) & ~1U) - 2; j >= 0; j -= 2)
+            q = q * r2 + ((float) kPolynomial.c[j] + (float) kPolynomial.c[j + 1] * r);
+
+        return q * r + (float) k;
+    }
+};
+
+typedef FastLog2Kernel<5>   DefaultFastLog2Kernel;
+
+
+#pragma mark - Double
+
+/*  Log2D() uses the same range reduction, on the encoding of a double:
+ *
+ *      x = 2**k z,  z = c (1 + r),  log2(x) = k + log2(c) + log2(1 + r)
+ *
+ *  but a double result can't be rounded from a double intermediate, so the parts that carry the most weight are
+ *  kept in double-double:
+ *
+ *      1/c is rounded to 8 bits. z has 53, so z (1/c) has at most 61, and since |r| < 2**-7 there is room for all of
+ *          them below its leading bit: r = fma( z, 1/c, -1) is exact. (The table is checked for this.)
+ *      log2(c) is in the table as hi + lo, made by constexpr double-double code to about 2**-64.
+ *      log2(1 + r) = r/ln(2) + r**2 P(r). r/ln(2) is formed exactly as hi + lo with another fma. r**2 P(r) is at
+ *          most 2**-7 of the result, so an error of 2**-52 in P is at most 2**-59 in it.
+ *
+ *  The big parts are summed with TwoSum so nothing is lost there, the small parts are summed in double, and the two
+ *  meet in the final rounding. fma() is only used where its single rounding is exact or gives a rounding error, so the
+ *  answer is the same on every machine, but without FMA hardware each one is a libm call. The vector kernels in
+ *  MathArrayDouble.cpp do the same operations in the same order, so they match bit for bit.
+ */
+
+namespace Log2KernelDetail
+{
+    static constexpr uint64_t kDoubleOne = 0x3ff0000000000000ULL;
+
+    /*! @abstract How z is cut into kTableSize subintervals, for double. The same layout as Geometry. */
+    template <unsigned kTableSize>
+    struct DoubleGeometry
+    {
+        static_assert( kTableSize >= 2 && kTableSize <= 4096 && 0 == (kTableSize & (kTableSize - 1)), "kTableSize must be a power of two" );
+
+        static constexpr int kTableBits = __builtin_ctz( kTableSize);
+        static constexpr uint64_t kSubintervalWidth = 1ULL << (52 - kTableBits);
+        static constexpr uint64_t kOffset = kDoubleOne - ((kDoubleOne - 0x3fe6a09e667f3bcdULL - kSubintervalWidth / 2) / kSubintervalWidth) * kSubintervalWidth
+                                                       - kSubintervalWidth / 2;
+        static constexpr uint64_t kCenterIndex = (kDoubleOne - kOffset) / kSubintervalWidth;
+    };
+
+    /*! @abstract Three doubles in a row, so the vector kernels can gather them with one index */
+    typedef struct DoubleEntry
+    {
+        double  invc;       // 1/c, rounded to 8 bits
+        double  logcHi;     // log2(c) = -log2(invc) = logcHi + logcLo
+        double  logcLo;
+    }DoubleEntry;
+
+    template <unsigned kTableSize>
+    struct DoubleTable
+    {
+        DoubleEntry entries[kTableSize];
+        double      maxReduced;     // largest |r|
+    };
+
+    template <unsigned kTableSize>
+    constexpr DoubleTable<kTableSize> MakeDoubleTable()
+    {
+        typedef DoubleGeometry<kTableSize> G;
+        DoubleTable<kTableSize> table = {};
+        for( uint64_t i = 0; i < kTableSize; i++)
+        {
+            double low = ConstexprMath::DoubleFromBits( G::kOffset + i * G::kSubintervalWidth);
+            double high = ConstexprMath::DoubleFromBits( G::kOffset + (i + 1) * G::kSubintervalWidth);
+            double invc = 1.0;
+            if( G::kCenterIndex != i )
+                invc = ConstexprMath::RoundToSignificantBits( 2.0 / (low + high), 8);
+
+            ConstexprMath::Extended logc = ConstexprMath::Log2Extended( invc);
+            table.entries[i] = DoubleEntry{ invc, -logc.hi, -logc.lo };
+
+            double rLow = 1.0 - low * invc;
+            double rHigh = high * invc - 1.0;
+            double r = rLow > rHigh ? rLow : rHigh;
+            if( r > table.maxReduced )
+                table.maxReduced = r;
+        }
+        return table;
+    }
+
+    /*! @abstract The Taylor series of (log2(1 + r) - r/ln(2)) / r**2 = sum (-1)**(j+1) r**j / ((j + 2) ln(2)), cut off after kDegree
+     *            terms, with each coefficient rounded once from double-double
+     *  @discussion Not FitPolynomial: at |r| < 2**-7 the series converges fast enough that a minimax fit has little to win,
+     *              and a fit done in double loses more than that (about 2**-50 relative, against 2**-53 for these). The error
+     *              estimate is the first term left out, relative to the leading one, plus the rounding of the coefficients. */
+    template <unsigned kDegree>
+    constexpr Polynomial<kDegree> RemainderSeries( double maxReduced)
+    {
+        constexpr ConstexprMath::Extended kInvLn2 = { 0x1.71547652b82fep0, 0x1.777d0ffda0d24p-56 };
+        Polynomial<kDegree> p = {};
+        for( unsigned j = 0; j < kDegree; j++)
+        {
+            ConstexprMath::Extended c = ConstexprMath::Divide( kInvLn2, double(j + 2));
+            p.c[j] = j & 1 ? c.hi : -c.hi;
+        }
+
+        double omitted = 2.0 / (kDegree + 2);
+        for( unsigned j = 0; j < kDegree; j++)
+            omitted *= maxReduced;
+        p.error = omitted + 0x1.0p-53;
+        return p;
+    }
+}
+
+template <unsigned kTableSize, unsigned kDegree>
+struct Log2DoubleKernel
+{
+    typedef Log2KernelDetail::DoubleGeometry<kTableSize> Geometry;
+
+    static constexpr Log2KernelDetail::DoubleTable<kTableSize> kTable = Log2KernelDetail::MakeDoubleTable<kTableSize>();
+    static constexpr Polynomial<kDegree> kPolynomial = Log2KernelDetail::RemainderSeries<kDegree>( kTable.maxReduced);
+    static constexpr double kPolynomialError = kPolynomial.error;
+    static constexpr size_t kTableBytes = sizeof(kTable.entries);
+    static_assert( kTable.maxReduced < 0x1.0p-7, "r would not be exact" );
+
+    // 1/ln(2) = kInvLn2Hi + kInvLn2Lo
+    static constexpr double kInvLn2Hi = 0x1.71547652b82fep0;
+    static constexpr double kInvLn2Lo = 0x1.777d0ffda0d24p-56;
+
+    // The first term of the series, -1/(2 ln(2)) = kFirstHi + kFirstLo
+    static constexpr double kFirstHi = -0.5 * kInvLn2Hi;
+    static constexpr double kFirstLo = -0.5 * kInvLn2Lo;
+    static_assert( kFirstHi == kPolynomial.c[0], "the series should start at -1/(2 ln(2))" );
+
+    /*! @abstract The series after its first term: (P(r) - P(0)) / r */
+    static inline double PolynomialTail( double r)
+    {
+        double q = kPolynomial.c[kDegree - 1];
+        for( int j = int(kDegree) - 2; j >= 1; j--)
+            q = q * r + kPolynomial.c[j];
+        return q;
+    }
+
+    /*! @abstract log2 of the positive normal double with encoding ix, or a subnormal normalized as in Evaluate */
+    static inline double EvaluateEncoding( uint64_t ix)
+    {
+#if __clang__
+#   pragma clang fp contract(off)
+#endif
+        uint64_t tmp = ix - Geometry::kOffset;
+        uint64_t i = (tmp >> (52 - Geometry::kTableBits)) % kTableSize;
+        int64_t k = int64_t(tmp) >> 52;
+        union{ uint64_t u; double d; }z = { ix - (tmp & 0xfff0000000000000ULL) };
+        const Log2KernelDetail::DoubleEntry & entry = kTable.entries[i];
+
+        double r = fma( z.d, entry.invc, -1.0);                 // exact
+
+        // r/ln(2) = hi + lo
+        double hi = r * kInvLn2Hi;
+        double lo = fma( r, kInvLn2Hi, -hi) + r * kInvLn2Lo;
+
+        // k + log2(c) + hi, exactly. |k| >= 1 > |log2(c)| unless k is 0, so the first sum can be fast.
+        double kd = (double) k;
+        double s = kd + entry.logcHi;
+        double e1 = entry.logcHi - (s - kd);
+        double t = s + hi;
+        double bb = t - s;
+        double e2 = (s - (t - bb)) + (hi - bb);
+
+        // r**2 P(r). Its first term, -r**2 / (2 ln(2)), is too big to round to a double: next to 1, where log2(c) and
+        // r/ln(2) cancel, that alone cost up to 0.015 ulps. So it is carried as pHi + pLo, pHi is added to t exactly,
+        // and only the rest of the series, smaller again by about r, is rounded.
+        double r2 = r * r;
+        double r2Lo = fma( r, r, -r2);
+        double pHi = r2 * kFirstHi;
+        double pLo = fma( r2, kFirstHi, -pHi) + (r2Lo * kFirstHi + r2 * kFirstLo);
+        double rest = (r2 * r) * PolynomialTail(r);
+
+        // t + pHi, exactly. |t| > |pHi|, so the fast form will do.
+        double u = t + pHi;
+        double e3 = pHi - (u - t);
+
+        return u + ((((((lo + pLo) + rest) + entry.logcLo) + e1) + e2) + e3);
+    }
+
+    /*! @abstract log2(x) for a double. Special cases are the same as Log2Kernel's. */
+    static inline double Evaluate( double x)
+    {
+        union{ double d; uint64_t u; }u = {x};
+        uint64_t ix = u.u;
+
+        // Zero, negative, subnormal, infinity and NaN all land here
+        if( __builtin_expect( ix - 0x0010000000000000ULL >= 0x7ff0000000000000ULL - 0x0010000000000000ULL, 0) )
+        {
+            if( 0 == (ix << 1) )                // +-0
+                return -INFINITY;
+            if( 0x7ff0000000000000ULL == ix )   // +inf
+                return x;
+            if( (ix >> 63) || (ix << 1) >= 0xffe0000000000000ULL )  // negative or NaN
+                return (x - x) / (x - x);
+
+            // Subnormal: normalize, and take the 52 back off the exponent, as for float
+            u.d = x * 0x1.0p52;
+            ix = u.u - (52ULL << 52);
+        }
+
+        return EvaluateEncoding( ix);
+    }
+};
+
+/*! @abstract The variant Log2D() uses: 128 entries (3 kB), and 7 terms of the series for the remainder, good to about 2**-52.
+ *  @discussion That is 2**-59 of the result where r**2 P(r) is smallest next to it, which is next to 1, outside the middle
+ *              subinterval, where log2(c) and r/ln(2) partly cancel. A fitted six-term polynomial, good to 2**-50, gave 0.51 ulps there.
+ *              Rounding the series did too, until its first term was carried in two doubles: see EvaluateEncoding. */
+typedef Log2DoubleKernel<128, 7>   DefaultLog2DoubleKernel;
+static_assert( DefaultLog2DoubleKernel::kPolynomialError < 0x1.0p-52, "Log2D would lose more than 2**-59 to its polynomial" );
+
+#endif /* LOG2_KERNEL_HPP */
@@ -6,32 +6,161 @@
 //
 
 #include "Math.hpp"
+#include "DoubleDouble.hpp"
+#include "Exp2Kernel.hpp"
+#include "Log2Kernel.hpp"
+#include "ReferenceMath.hpp"
 #include <math.h>
+#include <stdint.h>
 
-float Floor(float x)
+/*! @abstract computes the value of the natural logarithm of argument x.
+ *  @discussion     log(0) returns -Infinity
+                    log(1) returns +0
+ *                  log(inf)  returns inf
+ *                  log(-x) returns NaN */
+float Log2(float x)
 {
-    return floorf(x);           // TODO: REPLACE ME
+    return DefaultLog2Kernel::Evaluate(x);
 }
 
-/*! @abstract return the integral value nearest to x rounding half-way cases away from zero. Does not change sign of x. */
-float Round(float x)
+
+#pragma mark - Exp2, Log, Log10, Log1p and Expm1
+
+static constexpr double kLn2 = ConstexprMath::kLn2;
+static constexpr double kLog10Of2 = 0.30102999566398120;
+static constexpr double kLog2OfE = 1.0 / ConstexprMath::kLn2;
+
+float Exp2(float x)
 {
-    return roundf(x);           // TODO: REPLACE ME
+    return DefaultExp2Kernel::Evaluate(x);
 }
 
-/*! @abstract return the integral value nearest to x (according to the prevailing rounding mode) in floating-point format. Does not change sign of x. */
-float Rint(float x)
+/*  log(x) = log2(x) ln(2). The unrounded log2 is good to about 2**-33, so scaling it in double costs nothing.
+    Special cases come through the scaling unchanged: +-inf and NaN stay what they are, and log2(1) = +0. */
+float Log(float x)
 {
-    return rintf(x);            // TODO: REPLACE ME
+    double unused;
+    return (float)( DefaultLog2Kernel::EvaluateUnrounded( x, &unused) * kLn2);
 }
 
+float Log10(float x)
+{
+    double unused;
+    return (float)( DefaultLog2Kernel::EvaluateUnrounded( x, &unused) * kLog10Of2);
+}
 
-/*! @abstract computes the value of the natural logarithm of argument x.
- *  @discussion     log(0) returns -Infinity
-                    log(1) returns +0
- *                  log(inf)  returns inf
- *                  log(-x) returns NaN */
-float Log2(float x)
+/*  Near zero, 1 + x is in the middle of the subinterval where c = 1, and r = x exactly: log1p(x) = x Q(x) ln(2).
+    Further out, 1 + x is exact in double (until x is so big that it no longer matters) and goes through the
+    double form of the Log2 kernel. */
+static constexpr double kLog1pDirect = 0x1.0p-8;
+static_assert( DefaultLog2Kernel::kTable.maxReduced >= kLog1pDirect, "x is too big to use as r" );
+
+float Log1p(float x)
+{
+    if( fabsf(x) < kLog1pDirect )
+        return (float)( DefaultLog2Kernel::Reduced(x) * kLn2);      // keeps the sign of -0
+
+    // NaN fails every comparison, so it lands here too
+    if( __builtin_expect( !(x > -1.0f && x < INFINITY), 0) )
+    {
+        if( x != x )
+            return x + x;
+        if( x > 0 )                             // +inf
+            return x;
+        if( -1.0f == x )
+            return -INFINITY;
+        return (x - x) / (x - x);               // x < -1
+    }
+
+    double unused;
+    return (float)( DefaultLog2Kernel::EvaluateUnrounded( 1.0 + (double) x, &unused) * kLn2);
+}
+
+/*! @abstract (e**x - 1) / x, by its Taylor series 1 + x/2! + x**2/3! + ... Only used to fit the polynomial. */
+static constexpr double Expm1Quotient( double x)
 {
-    return log2f(x);             // TODO: REPLACE ME
+    double term = 1.0;
+    double sum = 0;
+    for( int i = 2; i < 30; i++)
+    {
+        sum += term;
+        term *= x / i;
+    }
+    return sum;
+}
+
+/*  Near zero, e**x - 1 loses to cancellation, so use expm1(x) = x P(x) directly. Further out, the cancellation
+    costs at most a factor of e**x / |e**x - 1| <= 3.6 in relative error, which the 2**-33 Exp2 kernel can afford. */
+static constexpr double kExpm1Direct = 0.25;
+static constexpr Polynomial<7> kExpm1Polynomial = FitPolynomial<7>( Expm1Quotient, kExpm1Direct);
+static_assert( kExpm1Polynomial.error < 0x1.0p-32, "Expm1 would not stay within 0.51 ulps" );
+
+float Expm1(float x)
+{
+    if( fabsf(x) < kExpm1Direct )
+        return (float)( kExpm1Polynomial(x) * x);                 // keeps the sign of -0
+
+    // e**x rounds to -1 below about -17.3, and overflows above about 88.7. NaN lands here too.
+    if( __builtin_expect( !(x > -32.0f && x < 128.0f), 0) )
+    {
+        if( x != x )
+            return x + x;
+        return x > 0 ? INFINITY : -1.0f;
+    }
+
+    return (float)( DefaultExp2Kernel::EvaluateUnrounded( (double) x * kLog2OfE) - 1.0);
+}
+
+#pragma mark - Double precision
+
+double Log2D( double x)
+{
+    return DefaultLog2DoubleKernel::Evaluate(x);
+}
+
+#pragma mark - 16-bit formats
+
+/*  Widening to float is exact. So is narrowing the result of Floor, Round or Rint: the integers next to a
+    16-bit value are 16-bit values too. Log2 is rounded twice, to float and then to 16 bits, but the first
+    rounding is 8192 (half) or 65536 (bfloat16) times finer than the second, so it hardly ever matters. */
+template <> _Float16 Floor( _Float16 x){ return (_Float16) Floor( (float) x); }
+template <> _Float16 Round( _Float16 x){ return (_Float16) Round( (float) x); }
+template <> _Float16 Rint( _Float16 x){ return (_Float16) Rint( (float) x); }
+template <> _Float16 Log2( _Float16 x){ return (_Float16) Log2( (float) x); }
+
+BFloat16 Floor( BFloat16 x){ return BFloat16FromFloat( Floor( FloatFromBFloat16(x))); }
+BFloat16 Round( BFloat16 x){ return BFloat16FromFloat( Round( FloatFromBFloat16(x))); }
+BFloat16 Rint( BFloat16 x){ return BFloat16FromFloat( Rint( FloatFromBFloat16(x))); }
+BFloat16 Log2( BFloat16 x){ return BFloat16FromFloat( Log2( FloatFromBFloat16(x))); }
+
+
+#pragma mark - Accuracy tiers
+
+template <>
+float Log2<Accuracy::Faithful>( float x)
+{
+    return DefaultLog2Kernel::Evaluate(x);
+}
+
+template <>
+float Log2<Accuracy::Fast>( float x)
+{
+    return DefaultFastLog2Kernel::Evaluate(x);
+}
+
+/*! @abstract Round the result of the usual Log2 kernel, if it is far enough from the nearest rounding boundary
+ *            that the error in it can't matter. Otherwise, start over in double-double. */
+template <>
+float Log2<Accuracy::CorrectlyRounded>( float x)
+{
+    double error;
+    double y = CorrectlyRoundedLog2Kernel::EvaluateUnrounded( x, &error);
+    float low = (float)(y - error);
+    float high = (float)(y + error);
+
+    // Special cases come back exact, with no error
+    if( __builtin_expect( low == high || 0 == error, 1) )
+        return (float) y;
+
+    return DoubleDoubleToFloat( Log2Reference(x));
 }
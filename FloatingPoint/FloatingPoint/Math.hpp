@@ -60,14 +60,28 @@
 //          next consecutive integer?
 //
 
+#ifndef MATH_HPP
+#define MATH_HPP    1
+
+#include "Float16.hpp"
+#include "FlushToZero.hpp"
+#include "Rounding.hpp"
+#include <stddef.h>
+#include <concepts>
+#include <stdint.h>
+#include <limits>
+
+// Floor, Round and Rint work on the bits (see Rounding.hpp), so they are constexpr and inline. They match floorf,
+// roundf and rintf bit for bit, and can be used to build tables at compile time.
+
 /*! @abstract return the largest integral value less than or equal to x. Does not change sign of x. */
-float Floor(float x);
+constexpr float Floor(float x){ return RoundToIntegral<RoundingMode::Down>(x); }
 
 /*! @abstract return the integral value nearest to x rounding half-way cases away from zero. Does not change sign of x. */
-float Round(float x);
+constexpr float Round(float x){ return RoundToIntegral<RoundingMode::NearestEven, true>(x); }
 
 /*! @abstract return the integral value nearest to x (according to the prevailing rounding mode) in floating-point format. Does not change sign of x. */
-float Rint(float x);        // we only worry about the default rounding mode for this assignment
+constexpr float Rint(float x){ return RoundToIntegral<RoundingMode::NearestEven>(x); }     // we only worry about the default rounding mode for this assignment. See Rint<RoundingMode>, below, for the others.
 
 
 /*! @abstract computes the value of the logarithm of argument x to base 2
@@ -77,3 +91,231 @@ float Rint(float x);        // we only worry about the default rounding mode for
  *                  log(-x) returns NaN */
 float Log2(float x);
 
+/*! @abstract computes 2 raised to the power x
+ *  @discussion     exp2(+-0) returns 1
+ *                  exp2(-inf) returns +0
+ *                  exp2(inf) returns inf
+ *                  Results too small for a subnormal return +0, and too large return inf. */
+float Exp2(float x);
+
+/*! @abstract computes the natural logarithm of x. Special cases are the same as Log2. */
+float Log(float x);
+
+/*! @abstract computes the base 10 logarithm of x. Special cases are the same as Log2. */
+float Log10(float x);
+
+/*! @abstract computes log(1 + x), accurately even when x is so small that 1 + x would round to 1
+ *  @discussion     log1p(+-0) returns +-0
+ *                  log1p(-1) returns -Infinity
+ *                  log1p(inf) returns inf
+ *                  log1p(x < -1) returns NaN */
+float Log1p(float x);
+
+/*! @abstract computes e**x - 1, accurately even when x is so small that e**x would round to 1
+ *  @discussion     expm1(+-0) returns +-0
+ *                  expm1(-inf) returns -1
+ *                  expm1(inf) returns inf */
+float Expm1(float x);
+
+// Log2, Exp2, Log, Log10, Log1p and Expm1 are all within 0.51 ulps: Accuracy::Faithful, below. They share their
+// range reduction and polynomials with Log2 (Log2Kernel.hpp) and Exp2 (Exp2Kernel.hpp), and never call libm.
+
+
+#pragma mark - Accuracy tiers
+
+/*! @abstract How close a function's result is to the exact answer. Pick the cheapest one the caller can live with.
+ *  @discussion Error bounds are in ulps of the float result, over every float input. See ErrorBound(). */
+enum class Accuracy
+{
+    CorrectlyRounded,   // always the float nearest the exact answer: 0.5 ulps
+    Faithful,           // always one of the two floats either side of the exact answer: under 1 ulp. The plain functions above.
+    Fast                // about 12 good bits, for when speed matters more than the last digits
+};
+
+/*! @abstract Log2 at a chosen accuracy, e.g. Log2<Accuracy::Fast>(x). Special cases are the same as Log2 for every tier.
+ *  @discussion     CorrectlyRounded    0.5 ulps. Usually as fast as Log2; about 1 in 2000 inputs come too close
+ *                                      to a rounding boundary to call, and are redone much more slowly in
+ *                                      double-double arithmetic.
+ *                  Faithful            0.51 ulps. Same as Log2(x).
+ *                  Fast                4096 ulps, i.e. a relative error under 2**-12 for any result. No table,
+ *                                      and all in float. Most of its time is the function call: use
+ *                                      DefaultFastLog2Kernel::Evaluate (Log2Kernel.hpp) to inline it in a loop. */
+template <Accuracy kAccuracy>   float Log2( float x);
+template <>                     float Log2<Accuracy::CorrectlyRounded>( float x);
+template <>                     float Log2<Accuracy::Faithful>( float x);
+template <>                     float Log2<Accuracy::Fast>( float x);
+
+/*! @abstract The most a function at a given tier may be off by, in ulps. The plain functions are all Faithful.
+ *            Fast is for Log2<Accuracy::Fast>, so far the only function with a fast tier. */
+constexpr float ErrorBound( Accuracy accuracy)
+{
+    return accuracy == Accuracy::CorrectlyRounded ? 0.5f :
+           accuracy == Accuracy::Faithful ? 0.51f : 4096.0f;
+}
+
+
+#pragma mark - Rounding directions
+
+/*! @abstract Rint in a rounding direction chosen at compile time, e.g. Rint<RoundingMode::Up>(x)
+ *  @discussion Returns what rintf(x) would with fesetround set to the matching FE_ mode, without reading or changing
+ *              the floating-point environment. Changing the rounding mode stalls the pipeline for tens of cycles
+ *              each time; this costs the same whichever direction the caller asks for, and however often it switches. */
+template <RoundingMode kMode>
+constexpr float Rint( float x){ return RoundToIntegral<kMode>(x); }
+
+
+#pragma mark - Conversion to integers
+
+// C's (int)x truncates, and is undefined if the result doesn't fit, NaN included. On x86, cvttss2si gives 0x80000000
+// for all of those, so (int) 3e9f is negative. lrintf and llroundf round, but leave out of range results unspecified too.
+// These round in the direction the name says, and then saturate: NaN is 0, and anything too big for the type is its
+// largest or smallest value, as fcvtns and friends do on arm. In range, they give what lrintf, floorf and llroundf would.
+
+/*! @abstract An integral float as an Int, saturating. NaN is 0. */
+template <typename Int>
+constexpr Int SaturateToInteger( float x)
+{
+    constexpr float kLimit = -(float) std::numeric_limits<Int>::min();       // 2**31 or 2**63, exactly
+    return x != x ? Int(0) : x >= kLimit ? std::numeric_limits<Int>::max() : x < -kLimit ? std::numeric_limits<Int>::min() : Int(x);
+}
+
+/*! @abstract Round x to the nearest integer, half-way cases to even, saturating. Like Rint, ignores the rounding mode. */
+constexpr int32_t RintToInt32( float x){ return SaturateToInteger<int32_t>( Rint(x)); }
+constexpr int64_t RintToInt64( float x){ return SaturateToInteger<int64_t>( Rint(x)); }
+
+/*! @abstract Round x down to an integer, saturating */
+constexpr int32_t FloorToInt32( float x){ return SaturateToInteger<int32_t>( Floor(x)); }
+constexpr int64_t FloorToInt64( float x){ return SaturateToInteger<int64_t>( Floor(x)); }
+
+/*! @abstract Round x to the nearest integer, half-way cases away from zero, saturating */
+constexpr int32_t RoundToInt32( float x){ return SaturateToInteger<int32_t>( Round(x)); }
+constexpr int64_t RoundToInt64( float x){ return SaturateToInteger<int64_t>( Round(x)); }
+
+/*! @abstract Array forms of the above:  dst[i] = F(src[i]) for i in [0, count)
+ *  @discussion Bit-identical to the scalar functions. One vector pass: round, convert, and patch the lanes that
+ *              were out of range or NaN. Chosen by instruction set the same way as the float array functions,
+ *              but not tuned. x86 has no float to 64-bit conversion before AVX-512, so there the 64-bit forms go
+ *              through double, and a vector with anything of magnitude 2**51 or more is done by the scalar function. */
+void RintToInt32Array( const float * src, int32_t * dst, size_t count);
+void FloorToInt32Array( const float * src, int32_t * dst, size_t count);
+void RoundToInt32Array( const float * src, int32_t * dst, size_t count);
+void RintToInt64Array( const float * src, int64_t * dst, size_t count);
+void FloorToInt64Array( const float * src, int64_t * dst, size_t count);
+void RoundToInt64Array( const float * src, int64_t * dst, size_t count);
+
+
+#pragma mark - Arrays
+
+/*! @abstract Array forms of the above:  dst[i] = F(src[i]) for i in [0, count)
+ *  @discussion Results are bit-identical to the scalar functions. src and dst may be the same
+ *              buffer, but should not otherwise overlap. The vector kernels (SSE4.1, AVX2 or AVX-512
+ *              on Intel, NEON on arm) are chosen once, the first time any of these are called: for
+ *              each function, the fastest the CPU supports that passes a correctness check, timed
+ *              then or read from the profile KernelTuner.hpp describes. Set the FP_ARRAY_ISA
+ *              environment variable to scalar, sse4.1, avx2, avx512, avx512fp16 or neon to use just
+ *              that one instead, without timing anything, e.g. to test the older kernels. */
+void FloorArray( const float * src, float * dst, size_t count);
+void RoundArray( const float * src, float * dst, size_t count);
+void RintArray( const float * src, float * dst, size_t count);
+void Log2Array( const float * src, float * dst, size_t count);
+void Exp2Array( const float * src, float * dst, size_t count);
+void LogArray( const float * src, float * dst, size_t count);
+void Log10Array( const float * src, float * dst, size_t count);
+void Log1pArray( const float * src, float * dst, size_t count);
+void Expm1Array( const float * src, float * dst, size_t count);
+
+/*! @abstract Array form of Rint<RoundingMode>, e.g. RintArray<RoundingMode::Down>( src, dst, count). Never touches the floating-point environment either. */
+template <RoundingMode kMode>   void RintArray( const float * src, float * dst, size_t count);
+template <>                     void RintArray<RoundingMode::NearestEven>( const float * src, float * dst, size_t count);
+template <>                     void RintArray<RoundingMode::TowardZero>( const float * src, float * dst, size_t count);
+template <>                     void RintArray<RoundingMode::Up>( const float * src, float * dst, size_t count);
+template <>                     void RintArray<RoundingMode::Down>( const float * src, float * dst, size_t count);
+
+/*! @abstract Flush-to-zero forms of the array functions: dst[i] = FlushSubnormal( F( FlushSubnormal( src[i]))).
+ *  @discussion Subnormal inputs are treated as zeros of the same sign, and subnormal results come back as zeros of the
+ *              same sign. Everything else is bit-identical to the plain array functions. They run inside a
+ *              FlushToZeroScope (FlushToZero.hpp), so the hardware never takes a slow microcode assist on a subnormal.
+ *              For audio and the like, where a subnormal is noise, and a latency spike is not. */
+void FloorArrayFTZ( const float * src, float * dst, size_t count);
+void RoundArrayFTZ( const float * src, float * dst, size_t count);
+void RintArrayFTZ( const float * src, float * dst, size_t count);
+void Log2ArrayFTZ( const float * src, float * dst, size_t count);
+void Exp2ArrayFTZ( const float * src, float * dst, size_t count);
+void LogArrayFTZ( const float * src, float * dst, size_t count);
+void Log10ArrayFTZ( const float * src, float * dst, size_t count);
+void Log1pArrayFTZ( const float * src, float * dst, size_t count);
+void Expm1ArrayFTZ( const float * src, float * dst, size_t count);
+
+/*! @abstract The name of the instruction set used by the array functions, e.g. "avx2", or "avx512, except round:avx2"
+ *            if tuning found some functions faster with another */
+const char * ArrayKernelISA(void);
+
+
+#pragma mark - 16-bit formats
+
+/*! @abstract Floor, Round, Rint and Log2 for half and bfloat16 (see Float16.hpp)
+ *  @discussion Floor, Round and Rint are exact, the same as the float versions. Log2 is within 0.51 ulps of
+ *              the 16-bit result. Special cases are the same as for float.
+ *              The half forms are templates that take only a _Float16. A double or an int converts to float and to
+ *              _Float16 equally well, so plain overloads would make Floor(0.5) and Floor(1) ambiguous. This way
+ *              they still call the float function. */
+template <std::same_as<_Float16> T> T Floor( T x);
+template <std::same_as<_Float16> T> T Round( T x);
+template <std::same_as<_Float16> T> T Rint( T x);
+template <std::same_as<_Float16> T> T Log2( T x);
+template <> _Float16 Floor( _Float16 x);
+template <> _Float16 Round( _Float16 x);
+template <> _Float16 Rint( _Float16 x);
+template <> _Float16 Log2( _Float16 x);
+BFloat16 Floor( BFloat16 x);
+BFloat16 Round( BFloat16 x);
+BFloat16 Rint( BFloat16 x);
+BFloat16 Log2( BFloat16 x);
+
+/*! @abstract Array forms, which read and write the 16-bit values directly, with no float buffer in between
+ *  @discussion Chosen the same way as the float array functions. The vector kernels use F16C (with AVX2) or
+ *              AVX-512 FP16 for half, and widen bfloat16 to float in registers with a shift. Results are
+ *              bit-identical to the scalar functions.
+ *              Log2Array is scalar by design, on every instruction set: it widens each element, calls the float
+ *              Log2 and narrows the result, which is what keeps it bit-identical to Log2. The float Log2Array is
+ *              scalar too, so there is no vector float kernel for it to share. */
+void FloorArray( const _Float16 * src, _Float16 * dst, size_t count);
+void RoundArray( const _Float16 * src, _Float16 * dst, size_t count);
+void RintArray( const _Float16 * src, _Float16 * dst, size_t count);
+void Log2Array( const _Float16 * src, _Float16 * dst, size_t count);
+void FloorArray( const BFloat16 * src, BFloat16 * dst, size_t count);
+void RoundArray( const BFloat16 * src, BFloat16 * dst, size_t count);
+void RintArray( const BFloat16 * src, BFloat16 * dst, size_t count);
+void Log2Array( const BFloat16 * src, BFloat16 * dst, size_t count);
+
+
+#pragma mark - Double precision
+
+// Named with a D, not overloaded, so that code calling Floor(0.5) with a double literal keeps getting the float
+// function, as main.cpp checks at compile time. FloorD, RoundD and RintD are the same bit twiddling as the float versions (Rounding.hpp), and match floor,
+// round and rint bit for bit.
+
+/*! @abstract return the largest integral value less than or equal to x. Does not change sign of x. */
+constexpr double FloorD( double x){ return RoundToIntegral<RoundingMode::Down>(x); }
+
+/*! @abstract return the integral value nearest to x rounding half-way cases away from zero. Does not change sign of x. */
+constexpr double RoundD( double x){ return RoundToIntegral<RoundingMode::NearestEven, true>(x); }
+
+/*! @abstract return the integral value nearest to x, half-way cases to even, as rint does in the default rounding mode */
+constexpr double RintD( double x){ return RoundToIntegral<RoundingMode::NearestEven>(x); }
+
+/*! @abstract log2 of a double, within 0.51 ulps. Special cases are the same as Log2.
+ *  @discussion A table and a short polynomial, with the big terms in double-double (see Log2Kernel.hpp). Needs no
+ *              libm, and gives the same bits everywhere, but uses fma(), which is a libm call without FMA hardware. */
+double Log2D( double x);
+
+/*! @abstract Array forms of the above, overloaded on double as the 16-bit ones are on their types
+ *  @discussion Bit-identical to the scalar functions. Chosen the same way as the float array functions, but not tuned.
+ *              Floor, Round and Rint use roundpd / vrndscalepd / frint; Log2 has AVX2 + FMA and AVX-512 kernels
+ *              that gather from the same table, and is scalar elsewhere. */
+void FloorArray( const double * src, double * dst, size_t count);
+void RoundArray( const double * src, double * dst, size_t count);
+void RintArray( const double * src, double * dst, size_t count);
+void Log2Array( const double * src, double * dst, size_t count);
+
+#endif /* MATH_HPP */
@@ -0,0 +1,404 @@
+//
+//  MathArray.cpp
+//  FloatingPoint
+//
+//  Array forms of the functions in Math.hpp, with a vector kernel for each instruction set
+//  we care about. The kernels are picked once at first use: for each function, the fastest of
+//  those the CPU can run, as timed by KernelTuner. FP_ARRAY_ISA overrides that with one set.
+//
+//  Every kernel has to produce exactly the same bits as the scalar function, including
+//  signed zeros, NaNs and values too large to have a fractional part. Partial vectors at
+//  the end of the array are finished with the scalar function (or a masked load / store on
+//  AVX-512), so there is only one answer for any given input regardless of where it sits.
+//
+
+#include "KernelTuner.hpp"
+#include "Math.hpp"
+#include "VectorISA.hpp"
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*! @abstract The set of array kernels for one instruction set */
+typedef struct ArrayKernels
+{
+    ArrayFunction   floor;
+    ArrayFunction   round;
+    ArrayFunction   rint;
+    ArrayFunction   log2;
+    ArrayFunction   exp2;
+    ArrayFunction   log;
+    ArrayFunction   log10;
+    ArrayFunction   log1p;
+    ArrayFunction   expm1;
+    ArrayFunction   rintInDirection[4];     // RintArray<RoundingMode>, indexed by the mode
+}ArrayKernels;
+
+
+#pragma mark - Scalar
+
+template <float (*F)(float)>
+static void ScalarKernel( const float * src, float * dst, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+// Exp2, Log, Log10, Log1p and Expm1 are scalar for every instruction set, for now
+#define SCALAR_TRANSCENDENTALS      ScalarKernel<Exp2>, ScalarKernel<Log>, ScalarKernel<Log10>, ScalarKernel<Log1p>, ScalarKernel<Expm1>
+
+static const ArrayKernels kScalarKernels = { ScalarKernel<Floor>, ScalarKernel<Round>, ScalarKernel<Rint>, ScalarKernel<Log2>,
+                                             SCALAR_TRANSCENDENTALS,
+                                             { ScalarKernel<Rint<RoundingMode::NearestEven>>, ScalarKernel<Rint<RoundingMode::TowardZero>>,
+                                               ScalarKernel<Rint<RoundingMode::Up>>, ScalarKernel<Rint<RoundingMode::Down>> } };
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// Rounding direction immediates shared by roundps and vrndscaleps. They are in the instruction, not MXCSR, so they don't
+// care what the rounding mode is. Rint rounds to nearest even whatever the mode, so it uses kNearestImm.
+static constexpr int kFloorImm   = _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC;
+static constexpr int kCeilImm    = _MM_FROUND_TO_POS_INF | _MM_FROUND_NO_EXC;
+static constexpr int kTruncImm   = _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC;
+static constexpr int kNearestImm = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+#pragma mark - SSE4.1
+
+template <int kImm, float (*F)(float)>
+static SSE41_KERNEL void RoundingKernelSSE41( const float * src, float * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+        _mm_storeu_ps( dst + i, _mm_round_ps( _mm_loadu_ps( src + i), kImm));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+/*  Round half-way cases away from zero:  t = trunc(x); if |x-t| >= 0.5 then t += copysign(1,x)
+    x-t is exact. The blend (rather than adding 0) keeps the sign of -0 results.  */
+static SSE41_KERNEL void RoundArraySSE41( const float * src, float * dst, size_t count)
+{
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        __m128 x = _mm_loadu_ps( src + i);
+        __m128 t = _mm_round_ps( x, kTruncImm);
+        __m128 fract = _mm_andnot_ps( signBit, _mm_sub_ps(x, t));
+        __m128 step = _mm_or_ps( _mm_and_ps( x, signBit), one);
+        __m128 isHalfOrMore = _mm_cmpge_ps( fract, half);
+        _mm_storeu_ps( dst + i, _mm_blendv_ps( t, _mm_add_ps( t, step), isHalfOrMore));
+    }
+    for( ; i < count; i++)
+        dst[i] = Round(src[i]);
+}
+
+static const ArrayKernels kSSE41Kernels = { RoundingKernelSSE41<kFloorImm, Floor>, RoundArraySSE41,
+                                            RoundingKernelSSE41<kNearestImm, Rint>, ScalarKernel<Log2>,
+                                            SCALAR_TRANSCENDENTALS,
+                                            { RoundingKernelSSE41<kNearestImm, Rint<RoundingMode::NearestEven>>,
+                                              RoundingKernelSSE41<kTruncImm, Rint<RoundingMode::TowardZero>>,
+                                              RoundingKernelSSE41<kCeilImm, Rint<RoundingMode::Up>>,
+                                              RoundingKernelSSE41<kFloorImm, Rint<RoundingMode::Down>> } };
+
+#pragma mark - AVX2
+
+template <int kImm, float (*F)(float)>
+static AVX2_KERNEL void RoundingKernelAVX2( const float * src, float * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+        _mm256_storeu_ps( dst + i, _mm256_round_ps( _mm256_loadu_ps( src + i), kImm));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static AVX2_KERNEL void RoundArrayAVX2( const float * src, float * dst, size_t count)
+{
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 half = _mm256_set1_ps(0.5f);
+
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_loadu_ps( src + i);
+        __m256 t = _mm256_round_ps( x, kTruncImm);
+        __m256 fract = _mm256_andnot_ps( signBit, _mm256_sub_ps(x, t));
+        __m256 step = _mm256_or_ps( _mm256_and_ps( x, signBit), one);
+        __m256 isHalfOrMore = _mm256_cmp_ps( fract, half, _CMP_GE_OQ);
+        _mm256_storeu_ps( dst + i, _mm256_blendv_ps( t, _mm256_add_ps( t, step), isHalfOrMore));
+    }
+    for( ; i < count; i++)
+        dst[i] = Round(src[i]);
+}
+
+static const ArrayKernels kAVX2Kernels = { RoundingKernelAVX2<kFloorImm, Floor>, RoundArrayAVX2,
+                                           RoundingKernelAVX2<kNearestImm, Rint>, ScalarKernel<Log2>,
+                                           SCALAR_TRANSCENDENTALS,
+                                           { RoundingKernelAVX2<kNearestImm, Rint<RoundingMode::NearestEven>>,
+                                             RoundingKernelAVX2<kTruncImm, Rint<RoundingMode::TowardZero>>,
+                                             RoundingKernelAVX2<kCeilImm, Rint<RoundingMode::Up>>,
+                                             RoundingKernelAVX2<kFloorImm, Rint<RoundingMode::Down>> } };
+
+#pragma mark - AVX-512
+
+// The tail is done with a masked load / store, so there is no scalar cleanup loop
+static AVX512_KERNEL inline __mmask16 TailMask( size_t remaining){ return (__mmask16) ((1U << remaining) - 1U); }
+
+template <int kImm>
+static AVX512_KERNEL void RoundingKernelAVX512( const float * src, float * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16)
+        _mm512_storeu_ps( dst + i, _mm512_roundscale_ps( _mm512_loadu_ps( src + i), kImm));
+    if( i < count )
+    {
+        __mmask16 m = TailMask( count - i);
+        _mm512_mask_storeu_ps( dst + i, m, _mm512_roundscale_ps( _mm512_maskz_loadu_ps( m, src + i), kImm));
+    }
+}
+
+static AVX512_KERNEL inline __m512 Round16( __m512 x)
+{
+    const __m512i signBit = _mm512_set1_epi32( INT32_MIN);
+    const __m512i one = _mm512_castps_si512( _mm512_set1_ps(1.0f));
+
+    __m512 t = _mm512_roundscale_ps( x, kTruncImm);
+    __m512 fract = _mm512_abs_ps( _mm512_sub_ps( x, t));
+    __m512 step = _mm512_castsi512_ps( _mm512_or_si512( _mm512_and_si512( _mm512_castps_si512(x), signBit), one));
+    __mmask16 isHalfOrMore = _mm512_cmp_ps_mask( fract, _mm512_set1_ps(0.5f), _CMP_GE_OQ);
+    return _mm512_mask_add_ps( t, isHalfOrMore, t, step);
+}
+
+static AVX512_KERNEL void RoundArrayAVX512( const float * src, float * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16)
+        _mm512_storeu_ps( dst + i, Round16( _mm512_loadu_ps( src + i)));
+    if( i < count )
+    {
+        __mmask16 m = TailMask( count - i);
+        _mm512_mask_storeu_ps( dst + i, m, Round16( _mm512_maskz_loadu_ps( m, src + i)));
+    }
+}
+
+static const ArrayKernels kAVX512Kernels = { RoundingKernelAVX512<kFloorImm>, RoundArrayAVX512,
+                                             RoundingKernelAVX512<kNearestImm>, ScalarKernel<Log2>,
+                                             SCALAR_TRANSCENDENTALS,
+                                             { RoundingKernelAVX512<kNearestImm>, RoundingKernelAVX512<kTruncImm>,
+                                               RoundingKernelAVX512<kCeilImm>, RoundingKernelAVX512<kFloorImm> } };
+
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+
+#pragma mark - NEON
+
+// NEON is always present on arm64, and has an instruction for each of our rounding flavors
+template <float32x4_t (*V)(float32x4_t), float (*F)(float)>
+static void RoundingKernelNEON( const float * src, float * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+        vst1q_f32( dst + i, V( vld1q_f32( src + i)));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static inline float32x4_t FloorNEON( float32x4_t x){ return vrndmq_f32(x); }
+static inline float32x4_t RoundNEON( float32x4_t x){ return vrndaq_f32(x); }       // half-way cases away from zero
+static inline float32x4_t NearestNEON( float32x4_t x){ return vrndnq_f32(x); }     // none of these care about the rounding mode
+static inline float32x4_t TruncNEON( float32x4_t x){ return vrndq_f32(x); }
+static inline float32x4_t CeilNEON( float32x4_t x){ return vrndpq_f32(x); }
+
+static const ArrayKernels kNEONKernels = { RoundingKernelNEON<FloorNEON, Floor>, RoundingKernelNEON<RoundNEON, Round>,
+                                           RoundingKernelNEON<NearestNEON, Rint>, ScalarKernel<Log2>,
+                                           SCALAR_TRANSCENDENTALS,
+                                           { RoundingKernelNEON<NearestNEON, Rint<RoundingMode::NearestEven>>,
+                                             RoundingKernelNEON<TruncNEON, Rint<RoundingMode::TowardZero>>,
+                                             RoundingKernelNEON<CeilNEON, Rint<RoundingMode::Up>>,
+                                             RoundingKernelNEON<FloorNEON, Rint<RoundingMode::Down>> } };
+#endif
+
+
+#pragma mark - Dispatch
+
+static const ArrayKernels * SelectArrayKernels(void)
+{
+    switch( GetVectorISA() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case kISASSE41:     return &kSSE41Kernels;
+        case kISAAVX2:      return &kAVX2Kernels;
+        case kISAAVX512:
+        case kISAAVX512FP16: return &kAVX512Kernels;
+#elif defined(__aarch64__)
+        case kISANEON:      return &kNEONKernels;
+#endif
+        default:            return &kScalarKernels;
+    }
+}
+
+#pragma mark - Tuning
+
+/*  The fastest kernel for a function isn't always the one for the widest instruction set. So unless FP_ARRAY_ISA
+    asks for a particular set, each function gets whichever of the kernels the CPU can run is fastest here, and the
+    sets are mixed and matched. Many of the entries are the same function in every set (the scalar transcendentals);
+    those have nothing to choose between and aren't timed.
+
+    Log2's table size is not among the choices: the tables trade accuracy for speed, so their results differ and
+    they fail the gate against each other. */
+
+static constexpr size_t kArrayKernelCount = sizeof(ArrayKernels) / sizeof(ArrayFunction);
+
+/*! @abstract ArrayKernels, as an array, for walking through the entries */
+typedef union ArrayKernelList
+{
+    ArrayKernels    kernels;
+    ArrayFunction   list[kArrayKernelCount];
+}ArrayKernelList;
+static_assert( sizeof(ArrayKernelList) == sizeof(ArrayKernels), "ArrayKernels must hold nothing but ArrayFunctions");
+
+/*! @abstract The names the tuning profile knows the entries by, in the order of ArrayKernels */
+static const char * const kArrayKernelNames[kArrayKernelCount] = { "floor", "round", "rint", "log2", "exp2", "log", "log10", "log1p", "expm1",
+                                                                   "rint<NearestEven>", "rint<TowardZero>", "rint<Up>", "rint<Down>" };
+
+/*! @abstract Describes a mixed set for ArrayKernelISA, e.g. "avx512, except round:avx2" */
+static char sTunedDescription[512];
+
+static const ArrayKernels * TuneArrayKernels( const ArrayKernels * selected)
+{
+    // The sets the CPU can run, up to the one GetVectorISA() picked
+    const struct{ VectorISA isa; const ArrayKernels * kernels; } kSets[] = {
+        { kISAScalar, &kScalarKernels },
+#if defined(__x86_64__) || defined(__i386__)
+        { kISASSE41, &kSSE41Kernels }, { kISAAVX2, &kAVX2Kernels }, { kISAAVX512, &kAVX512Kernels },
+#elif defined(__aarch64__)
+        { kISANEON, &kNEONKernels },
+#endif
+    };
+
+    static ArrayKernelList tuned;
+    const ArrayKernelList & reference = (const ArrayKernelList &) kScalarKernels;
+    const ArrayKernelList & best = (const ArrayKernelList &) *selected;
+    int length = snprintf( sTunedDescription, sizeof(sTunedDescription), "%s", VectorISAName( GetVectorISA()));
+    const char * separator = ", except ";
+
+    for( size_t k = 0; k < kArrayKernelCount; k++)
+    {
+        KernelVariant variants[ sizeof(kSets) / sizeof(kSets[0])];
+        size_t count = 0;
+        for( auto & set : kSets )
+        {
+            if( set.isa > GetVectorISA() || ! IsVectorISASupported( set.isa) )
+                continue;
+            ArrayFunction f = ((const ArrayKernelList *) set.kernels)->list[k];
+            bool seen = false;
+            for( size_t i = 0; i < count; i++)
+                seen |= f == variants[i].f;
+            if( ! seen )
+                variants[count++] = KernelVariant{ VectorISAName( set.isa), f };
+        }
+
+        tuned.list[k] = best.list[k];
+        if( count <= 1 )
+            continue;
+
+        size_t chosen = TuneArrayKernel( kArrayKernelNames[k], variants, count, reference.list[k]);
+        tuned.list[k] = chosen < count ? variants[chosen].f : reference.list[k];
+        if( tuned.list[k] != best.list[k] && length >= 0 && size_t(length) < sizeof(sTunedDescription) )
+        {
+            const char * name = chosen < count ? variants[chosen].name : VectorISAName( kISAScalar);
+            length += snprintf( sTunedDescription + length, sizeof(sTunedDescription) - size_t(length), "%s%s:%s", separator, kArrayKernelNames[k], name);
+            separator = ", ";
+        }
+    }
+
+    return &tuned.kernels;
+}
+
+static const ArrayKernels * InitArrayKernels(void)
+{
+    const ArrayKernels * selected = SelectArrayKernels();
+    if( getenv( "FP_ARRAY_ISA") )
+        return selected;                // asked for one set, so that's what they get
+    return TuneArrayKernels( selected);
+}
+
+static inline const ArrayKernels & GetArrayKernels(void)
+{
+    static const ArrayKernels * kernels = InitArrayKernels();       // thread safe one-time initialization
+    return *kernels;
+}
+
+void FloorArray( const float * src, float * dst, size_t count){ GetArrayKernels().floor( src, dst, count); }
+void RoundArray( const float * src, float * dst, size_t count){ GetArrayKernels().round( src, dst, count); }
+void RintArray( const float * src, float * dst, size_t count){ GetArrayKernels().rint( src, dst, count); }
+void Log2Array( const float * src, float * dst, size_t count){ GetArrayKernels().log2( src, dst, count); }
+void Exp2Array( const float * src, float * dst, size_t count){ GetArrayKernels().exp2( src, dst, count); }
+void LogArray( const float * src, float * dst, size_t count){ GetArrayKernels().log( src, dst, count); }
+void Log10Array( const float * src, float * dst, size_t count){ GetArrayKernels().log10( src, dst, count); }
+void Log1pArray( const float * src, float * dst, size_t count){ GetArrayKernels().log1p( src, dst, count); }
+void Expm1Array( const float * src, float * dst, size_t count){ GetArrayKernels().expm1( src, dst, count); }
+
+template <RoundingMode kMode>
+static inline void RintInDirectionArray( const float * src, float * dst, size_t count){ GetArrayKernels().rintInDirection[ size_t(kMode)]( src, dst, count); }
+template <> void RintArray<RoundingMode::NearestEven>( const float * src, float * dst, size_t count){ RintInDirectionArray<RoundingMode::NearestEven>( src, dst, count); }
+template <> void RintArray<RoundingMode::TowardZero>( const float * src, float * dst, size_t count){ RintInDirectionArray<RoundingMode::TowardZero>( src, dst, count); }
+template <> void RintArray<RoundingMode::Up>( const float * src, float * dst, size_t count){ RintInDirectionArray<RoundingMode::Up>( src, dst, count); }
+template <> void RintArray<RoundingMode::Down>( const float * src, float * dst, size_t count){ RintInDirectionArray<RoundingMode::Down>( src, dst, count); }
+
+
+#pragma mark - Flush to zero
+
+/*  Flush the input a block at a time into a buffer, run the usual kernel on that with the hardware flushing too,
+    then flush the output. The flushing is integer work, so it never takes an assist itself, and the explicit passes
+    make the results the same on every machine, however its hardware decides what is tiny. The hardware mode is there
+    for speed: it keeps subnormal results inside the kernels from taking assists on their way to being flushed.
+
+    Only Exp2 can return a subnormal for a normal input. The rest skip the second pass. */
+static inline void FlushSubnormals( const float * src, float * dst, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        dst[i] = FlushSubnormal( src[i]);
+}
+
+template <ArrayFunction ArrayKernels::*kFunction, bool kHasSubnormalResults = false>
+static void FlushToZeroKernel( const float * src, float * dst, size_t count)
+{
+    FlushToZeroScope scope;
+    ArrayFunction f = GetArrayKernels().*kFunction;
+
+    constexpr size_t kBlockSize = 1024;
+    float buffer[kBlockSize];
+    for( size_t i = 0; i < count; i += kBlockSize)
+    {
+        size_t n = count - i < kBlockSize ? count - i : kBlockSize;
+        FlushSubnormals( src + i, buffer, n);
+        f( buffer, dst + i, n);
+        if( kHasSubnormalResults )
+            FlushSubnormals( dst + i, dst + i, n);
+    }
+}
+
+void FloorArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::floor>( src, dst, count); }
+void RoundArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::round>( src, dst, count); }
+void RintArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::rint>( src, dst, count); }
+void Log2ArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::log2>( src, dst, count); }
+void Exp2ArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::exp2, true>( src, dst, count); }
+void LogArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::log>( src, dst, count); }
+void Log10ArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::log10>( src, dst, count); }
+void Log1pArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::log1p>( src, dst, count); }
+void Expm1ArrayFTZ( const float * src, float * dst, size_t count){ FlushToZeroKernel<&ArrayKernels::expm1>( src, dst, count); }
+
+const char * ArrayKernelISA(void)
+{
+    GetArrayKernels();
+    return sTunedDescription[0] ? sTunedDescription : VectorISAName( GetVectorISA());
+}
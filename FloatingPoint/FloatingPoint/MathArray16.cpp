@@ -0,0 +1,343 @@
+//
+//  MathArray16.cpp
+//  FloatingPoint
+//
+//  Array forms of the half and bfloat16 functions in Math.hpp, laid out like MathArray.cpp: a set of
+//  kernels per instruction set, one picked at first use.
+//
+//  The 16-bit values are widened to float in registers, rounded there, and narrowed on the way back out,
+//  so memory only ever sees 16-bit data. Narrowing is exact, because the integers next to a 16-bit value
+//  are 16-bit values too. That is what makes bfloat16 cheap: widening is a shift left by 16, and narrowing
+//  is a shift right, with no rounding to do. AVX-512 FP16 can round half values directly, 32 at a time.
+//
+//  Log2 is scalar everywhere, by design: see Math.hpp.
+//
+
+#include "Math.hpp"
+#include "VectorISA.hpp"
+#include <stdint.h>
+
+/*! @abstract The set of array kernels for one 16-bit format and one instruction set */
+template <typename T>
+struct Float16ArrayKernels
+{
+    typedef void (*Function)( const T * src, T * dst, size_t count);
+
+    Function    floor;
+    Function    round;
+    Function    rint;
+    Function    log2;
+};
+
+
+#pragma mark - Scalar
+
+template <typename T, T (*F)(T)>
+static void ScalarKernel16( const T * src, T * dst, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+template <typename T>
+static constexpr Float16ArrayKernels<T> kScalarKernels16 = { ScalarKernel16<T, Floor>, ScalarKernel16<T, Round>,
+                                                             ScalarKernel16<T, Rint>, ScalarKernel16<T, Log2> };
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+static constexpr int kFloorImm = _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC;
+static constexpr int kTruncImm = _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC;
+static constexpr int kNearestImm = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;  // Rint ignores the rounding mode, so no CUR_DIRECTION
+static constexpr int kRoundImm = -1;            // not a rounding direction: half-way cases away from zero, done by hand
+static constexpr int kNarrowImm = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+
+#pragma mark - SSE4.1
+
+// No F16C, so half stays scalar. bfloat16 is 8 at a time, in two vectors of 4 floats.
+
+/*  Round half-way cases away from zero, as in MathArray.cpp  */
+static SSE41_KERNEL inline __m128 Round4( __m128 x)
+{
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    __m128 t = _mm_round_ps( x, kTruncImm);
+    __m128 fract = _mm_andnot_ps( signBit, _mm_sub_ps(x, t));
+    __m128 step = _mm_or_ps( _mm_and_ps( x, signBit), _mm_set1_ps(1.0f));
+    return _mm_blendv_ps( t, _mm_add_ps( t, step), _mm_cmpge_ps( fract, _mm_set1_ps(0.5f)));
+}
+
+template <int kImm>
+static SSE41_KERNEL inline __m128 Round4( __m128 x){ return kRoundImm == kImm ? Round4(x) : _mm_round_ps( x, kImm & 0xff); }
+
+template <int kImm, BFloat16 (*F)(BFloat16)>
+static SSE41_KERNEL void BFloat16KernelSSE41( const BFloat16 * src, BFloat16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m128i v = _mm_loadu_si128( (const __m128i *)(src + i));
+        __m128 low = _mm_castsi128_ps( _mm_slli_epi32( _mm_cvtepu16_epi32(v), 16));
+        __m128 high = _mm_castsi128_ps( _mm_slli_epi32( _mm_cvtepu16_epi32( _mm_srli_si128( v, 8)), 16));
+        __m128i lowBits = _mm_srli_epi32( _mm_castps_si128( Round4<kImm>(low)), 16);
+        __m128i highBits = _mm_srli_epi32( _mm_castps_si128( Round4<kImm>(high)), 16);
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_packus_epi32( lowBits, highBits));
+    }
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static constexpr Float16ArrayKernels<BFloat16> kBFloat16KernelsSSE41 = { BFloat16KernelSSE41<kFloorImm, Floor>,
+                                                                         BFloat16KernelSSE41<kRoundImm, Round>,
+                                                                         BFloat16KernelSSE41<kNearestImm, Rint>,
+                                                                         ScalarKernel16<BFloat16, Log2> };
+
+#pragma mark - AVX2
+
+static AVX2_KERNEL inline __m256 Round8( __m256 x)
+{
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    __m256 t = _mm256_round_ps( x, kTruncImm);
+    __m256 fract = _mm256_andnot_ps( signBit, _mm256_sub_ps(x, t));
+    __m256 step = _mm256_or_ps( _mm256_and_ps( x, signBit), _mm256_set1_ps(1.0f));
+    return _mm256_blendv_ps( t, _mm256_add_ps( t, step), _mm256_cmp_ps( fract, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+}
+
+template <int kImm>
+static AVX2_KERNEL inline __m256 Round8( __m256 x){ return kRoundImm == kImm ? Round8(x) : _mm256_round_ps( x, kImm & 0xff); }
+
+template <int kImm, _Float16 (*F)(_Float16)>
+static F16C_KERNEL void HalfKernelF16C( const _Float16 * src, _Float16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m256 x = _mm256_cvtph_ps( _mm_loadu_si128( (const __m128i *)(src + i)));
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm256_cvtps_ph( Round8<kImm>(x), kNarrowImm));
+    }
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+template <int kImm, BFloat16 (*F)(BFloat16)>
+static AVX2_KERNEL void BFloat16KernelAVX2( const BFloat16 * src, BFloat16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m256i v = _mm256_cvtepu16_epi32( _mm_loadu_si128( (const __m128i *)(src + i)));
+        __m256 x = _mm256_castsi256_ps( _mm256_slli_epi32( v, 16));
+        __m256i bits = _mm256_srli_epi32( _mm256_castps_si256( Round8<kImm>(x)), 16);
+        _mm_storeu_si128( (__m128i *)(dst + i), _mm_packus_epi32( _mm256_castsi256_si128(bits), _mm256_extracti128_si256( bits, 1)));
+    }
+
+    // The tail and the caller are SSE code. Clean upper state first, or every SSE instruction pays a transition penalty.
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static constexpr Float16ArrayKernels<_Float16> kHalfKernelsAVX2 = { HalfKernelF16C<kFloorImm, Floor>,
+                                                                    HalfKernelF16C<kRoundImm, Round>,
+                                                                    HalfKernelF16C<kNearestImm, Rint>,
+                                                                    ScalarKernel16<_Float16, Log2> };
+static constexpr Float16ArrayKernels<BFloat16> kBFloat16KernelsAVX2 = { BFloat16KernelAVX2<kFloorImm, Floor>,
+                                                                        BFloat16KernelAVX2<kRoundImm, Round>,
+                                                                        BFloat16KernelAVX2<kNearestImm, Rint>,
+                                                                        ScalarKernel16<BFloat16, Log2> };
+
+#pragma mark - AVX-512
+
+static AVX512_KERNEL inline __m512 Round16( __m512 x)
+{
+    const __m512i signBit = _mm512_set1_epi32( INT32_MIN);
+    const __m512i one = _mm512_castps_si512( _mm512_set1_ps(1.0f));
+
+    __m512 t = _mm512_roundscale_ps( x, kTruncImm);
+    __m512 fract = _mm512_abs_ps( _mm512_sub_ps( x, t));
+    __m512 step = _mm512_castsi512_ps( _mm512_or_si512( _mm512_and_si512( _mm512_castps_si512(x), signBit), one));
+    __mmask16 isHalfOrMore = _mm512_cmp_ps_mask( fract, _mm512_set1_ps(0.5f), _CMP_GE_OQ);
+    return _mm512_mask_add_ps( t, isHalfOrMore, t, step);
+}
+
+template <int kImm>
+static AVX512_KERNEL inline __m512 Round16( __m512 x){ return kRoundImm == kImm ? Round16(x) : _mm512_roundscale_ps( x, kImm & 0xff); }
+
+template <int kImm, _Float16 (*F)(_Float16)>
+static AVX512_KERNEL void HalfKernelAVX512( const _Float16 * src, _Float16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16)
+    {
+        __m512 x = _mm512_cvtph_ps( _mm256_loadu_si256( (const __m256i *)(src + i)));
+        _mm256_storeu_si256( (__m256i *)(dst + i), _mm512_cvtps_ph( Round16<kImm>(x), kNarrowImm));
+    }
+
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+template <int kImm, BFloat16 (*F)(BFloat16)>
+static AVX512_KERNEL void BFloat16KernelAVX512( const BFloat16 * src, BFloat16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16)
+    {
+        __m512i v = _mm512_cvtepu16_epi32( _mm256_loadu_si256( (const __m256i *)(src + i)));
+        __m512 x = _mm512_castsi512_ps( _mm512_slli_epi32( v, 16));
+        __m512i bits = _mm512_srli_epi32( _mm512_castps_si512( Round16<kImm>(x)), 16);
+        _mm256_storeu_si256( (__m256i *)(dst + i), _mm512_cvtepi32_epi16( bits));
+    }
+
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static constexpr Float16ArrayKernels<_Float16> kHalfKernelsAVX512 = { HalfKernelAVX512<kFloorImm, Floor>,
+                                                                      HalfKernelAVX512<kRoundImm, Round>,
+                                                                      HalfKernelAVX512<kNearestImm, Rint>,
+                                                                      ScalarKernel16<_Float16, Log2> };
+static constexpr Float16ArrayKernels<BFloat16> kBFloat16KernelsAVX512 = { BFloat16KernelAVX512<kFloorImm, Floor>,
+                                                                          BFloat16KernelAVX512<kRoundImm, Round>,
+                                                                          BFloat16KernelAVX512<kNearestImm, Rint>,
+                                                                          ScalarKernel16<BFloat16, Log2> };
+
+#pragma mark - AVX-512 FP16
+
+// Half arithmetic in hardware: no widening, 32 values per vector, and a masked load / store for the tail
+
+static AVX512FP16_KERNEL inline __m512h Round32( __m512h x)
+{
+    const __m512i signBit = _mm512_set1_epi16( INT16_MIN);
+    const __m512i one = _mm512_castph_si512( _mm512_set1_ph( (_Float16) 1.0f));
+
+    __m512h t = _mm512_roundscale_ph( x, kTruncImm);
+    __m512h fract = _mm512_abs_ph( _mm512_sub_ph( x, t));
+    __m512h step = _mm512_castsi512_ph( _mm512_or_si512( _mm512_and_si512( _mm512_castph_si512(x), signBit), one));
+    __mmask32 isHalfOrMore = _mm512_cmp_ph_mask( fract, _mm512_set1_ph( (_Float16) 0.5f), _CMP_GE_OQ);
+    return _mm512_mask_add_ph( t, isHalfOrMore, t, step);
+}
+
+template <int kImm>
+static AVX512FP16_KERNEL inline __m512h Round32( __m512h x){ return kRoundImm == kImm ? Round32(x) : _mm512_roundscale_ph( x, kImm & 0xff); }
+
+template <int kImm>
+static AVX512FP16_KERNEL void HalfKernelAVX512FP16( const _Float16 * src, _Float16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 32 <= count; i += 32)
+        _mm512_storeu_ph( dst + i, Round32<kImm>( _mm512_loadu_ph( src + i)));
+    if( i < count )
+    {
+        __mmask32 m = (__mmask32) ((1ULL << (count - i)) - 1U);
+        __m512h x = _mm512_castsi512_ph( _mm512_maskz_loadu_epi16( m, src + i));
+        _mm512_mask_storeu_epi16( dst + i, m, _mm512_castph_si512( Round32<kImm>(x)));
+    }
+    _mm256_zeroupper();
+}
+
+static constexpr Float16ArrayKernels<_Float16> kHalfKernelsAVX512FP16 = { HalfKernelAVX512FP16<kFloorImm>,
+                                                                          HalfKernelAVX512FP16<kRoundImm>,
+                                                                          HalfKernelAVX512FP16<kNearestImm>,
+                                                                          ScalarKernel16<_Float16, Log2> };
+
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+
+#pragma mark - NEON
+
+// Widen 4 at a time with vcvt / a shift, round with the same instructions as MathArray.cpp, and narrow back
+
+template <float32x4_t (*V)(float32x4_t), _Float16 (*F)(_Float16)>
+static void HalfKernelNEON( const _Float16 * src, _Float16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        float32x4_t x = vcvt_f32_f16( vld1_f16( (const float16_t *)(src + i)));
+        vst1_f16( (float16_t *)(dst + i), vcvt_f16_f32( V(x)));
+    }
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+template <float32x4_t (*V)(float32x4_t), BFloat16 (*F)(BFloat16)>
+static void BFloat16KernelNEON( const BFloat16 * src, BFloat16 * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        float32x4_t x = vreinterpretq_f32_u32( vshlq_n_u32( vmovl_u16( vld1_u16( (const uint16_t *)(src + i))), 16));
+        vst1_u16( (uint16_t *)(dst + i), vshrn_n_u32( vreinterpretq_u32_f32( V(x)), 16));
+    }
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static inline float32x4_t FloorNEON( float32x4_t x){ return vrndmq_f32(x); }
+static inline float32x4_t RoundNEON( float32x4_t x){ return vrndaq_f32(x); }
+static inline float32x4_t NearestNEON( float32x4_t x){ return vrndnq_f32(x); }    // not vrndiq: Rint ignores the rounding mode
+
+static constexpr Float16ArrayKernels<_Float16> kHalfKernelsNEON = { HalfKernelNEON<FloorNEON, Floor>, HalfKernelNEON<RoundNEON, Round>,
+                                                                    HalfKernelNEON<NearestNEON, Rint>, ScalarKernel16<_Float16, Log2> };
+static constexpr Float16ArrayKernels<BFloat16> kBFloat16KernelsNEON = { BFloat16KernelNEON<FloorNEON, Floor>, BFloat16KernelNEON<RoundNEON, Round>,
+                                                                        BFloat16KernelNEON<NearestNEON, Rint>, ScalarKernel16<BFloat16, Log2> };
+#endif
+
+
+#pragma mark - Dispatch
+
+static const Float16ArrayKernels<_Float16> * SelectHalfKernels(void)
+{
+    switch( GetVectorISA() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case kISAAVX2:          return &kHalfKernelsAVX2;
+        case kISAAVX512:        return &kHalfKernelsAVX512;
+        case kISAAVX512FP16:    return &kHalfKernelsAVX512FP16;
+#elif defined(__aarch64__)
+        case kISANEON:          return &kHalfKernelsNEON;
+#endif
+        default:                return &kScalarKernels16<_Float16>;
+    }
+}
+
+static const Float16ArrayKernels<BFloat16> * SelectBFloat16Kernels(void)
+{
+    switch( GetVectorISA() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case kISASSE41:         return &kBFloat16KernelsSSE41;
+        case kISAAVX2:          return &kBFloat16KernelsAVX2;
+        case kISAAVX512:
+        case kISAAVX512FP16:    return &kBFloat16KernelsAVX512;
+#elif defined(__aarch64__)
+        case kISANEON:          return &kBFloat16KernelsNEON;
+#endif
+        default:                return &kScalarKernels16<BFloat16>;
+    }
+}
+
+static inline const Float16ArrayKernels<_Float16> & GetHalfKernels(void)
+{
+    static const Float16ArrayKernels<_Float16> * kernels = SelectHalfKernels();       // thread safe one-time initialization
+    return *kernels;
+}
+
+static inline const Float16ArrayKernels<BFloat16> & GetBFloat16Kernels(void)
+{
+    static const Float16ArrayKernels<BFloat16> * kernels = SelectBFloat16Kernels();
+    return *kernels;
+}
+
+void FloorArray( const _Float16 * src, _Float16 * dst, size_t count){ GetHalfKernels().floor( src, dst, count); }
+void RoundArray( const _Float16 * src, _Float16 * dst, size_t count){ GetHalfKernels().round( src, dst, count); }
+void RintArray( const _Float16 * src, _Float16 * dst, size_t count){ GetHalfKernels().rint( src, dst, count); }
+void Log2Array( const _Float16 * src, _Float16 * dst, size_t count){ GetHalfKernels().log2( src, dst, count); }
+
+void FloorArray( const BFloat16 * src, BFloat16 * dst, size_t count){ GetBFloat16Kernels().floor( src, dst, count); }
+void RoundArray( const BFloat16 * src, BFloat16 * dst, size_t count){ GetBFloat16Kernels().round( src, dst, count); }
+void RintArray( const BFloat16 * src, BFloat16 * dst, size_t count){ GetBFloat16Kernels().rint( src, dst, count); }
+void Log2Array( const BFloat16 * src, BFloat16 * dst, size_t count){ GetBFloat16Kernels().log2( src, dst, count); }
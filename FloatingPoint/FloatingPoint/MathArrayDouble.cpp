@@ -0,0 +1,359 @@
+//
+//  MathArrayDouble.cpp
+//  FloatingPoint
+//
+//  Array forms of FloorD, RoundD, RintD and Log2D, laid out like MathArray.cpp: a set of kernels per
+//  instruction set, one picked at first use.
+//
+//  Rounding is one instruction per vector, as it is for float. Log2 is DefaultLog2DoubleKernel a vector at a
+//  time: the table entries are gathered, and the arithmetic is the scalar code's, operation for operation and in
+//  the same order, so the results match it bit for bit. A vector holding anything but positive normal numbers
+//  goes to the scalar function instead. SSE4.1 has no FMA, and NEON no gather, so Log2 is scalar there.
+//
+
+#include "Log2Kernel.hpp"
+#include "Math.hpp"
+#include "VectorISA.hpp"
+#include <stdint.h>
+
+typedef void (*DoubleArrayFunction)( const double * src, double * dst, size_t count);
+
+/*! @abstract The set of double array kernels for one instruction set */
+typedef struct DoubleArrayKernels
+{
+    DoubleArrayFunction floor;
+    DoubleArrayFunction round;
+    DoubleArrayFunction rint;
+    DoubleArrayFunction log2;
+}DoubleArrayKernels;
+
+
+#pragma mark - Scalar
+
+template <double (*F)(double)>
+static void ScalarKernelD( const double * src, double * dst, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static const DoubleArrayKernels kScalarKernelsD = { ScalarKernelD<FloorD>, ScalarKernelD<RoundD>, ScalarKernelD<RintD>, ScalarKernelD<Log2D> };
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+static constexpr int kFloorImm = _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC;
+static constexpr int kTruncImm = _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC;
+static constexpr int kNearestImm = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;  // RintD ignores the rounding mode, so no CUR_DIRECTION
+
+typedef DefaultLog2DoubleKernel Log2K;
+static constexpr int kLog2Degree = sizeof(Log2K::kPolynomial.c) / sizeof(Log2K::kPolynomial.c[0]);
+
+#pragma mark - SSE4.1
+
+template <int kImm, double (*F)(double)>
+static SSE41_KERNEL void RoundingKernelSSE41D( const double * src, double * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 2 <= count; i += 2)
+        _mm_storeu_pd( dst + i, _mm_round_pd( _mm_loadu_pd( src + i), kImm));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+/*  Round half-way cases away from zero, as in MathArray.cpp:  t = trunc(x); if |x-t| >= 0.5 then t += copysign(1,x)  */
+static SSE41_KERNEL void RoundArraySSE41D( const double * src, double * dst, size_t count)
+{
+    const __m128d signBit = _mm_set1_pd(-0.0);
+    const __m128d one = _mm_set1_pd(1.0);
+    const __m128d half = _mm_set1_pd(0.5);
+
+    size_t i = 0;
+    for( ; i + 2 <= count; i += 2)
+    {
+        __m128d x = _mm_loadu_pd( src + i);
+        __m128d t = _mm_round_pd( x, kTruncImm);
+        __m128d fract = _mm_andnot_pd( signBit, _mm_sub_pd(x, t));
+        __m128d step = _mm_or_pd( _mm_and_pd( x, signBit), one);
+        _mm_storeu_pd( dst + i, _mm_blendv_pd( t, _mm_add_pd( t, step), _mm_cmpge_pd( fract, half)));
+    }
+    for( ; i < count; i++)
+        dst[i] = RoundD(src[i]);
+}
+
+static const DoubleArrayKernels kSSE41KernelsD = { RoundingKernelSSE41D<kFloorImm, FloorD>, RoundArraySSE41D,
+                                                   RoundingKernelSSE41D<kNearestImm, RintD>, ScalarKernelD<Log2D> };
+
+#pragma mark - AVX2
+
+template <int kImm, double (*F)(double)>
+static AVX2_KERNEL void RoundingKernelAVX2D( const double * src, double * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+        _mm256_storeu_pd( dst + i, _mm256_round_pd( _mm256_loadu_pd( src + i), kImm));
+
+    // The tail and the caller are SSE code. Clean upper state first, or every SSE instruction pays a transition penalty.
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static AVX2_KERNEL void RoundArrayAVX2D( const double * src, double * dst, size_t count)
+{
+    const __m256d signBit = _mm256_set1_pd(-0.0);
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d half = _mm256_set1_pd(0.5);
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        __m256d x = _mm256_loadu_pd( src + i);
+        __m256d t = _mm256_round_pd( x, kTruncImm);
+        __m256d fract = _mm256_andnot_pd( signBit, _mm256_sub_pd(x, t));
+        __m256d step = _mm256_or_pd( _mm256_and_pd( x, signBit), one);
+        __m256d isHalfOrMore = _mm256_cmp_pd( fract, half, _CMP_GE_OQ);
+        _mm256_storeu_pd( dst + i, _mm256_blendv_pd( t, _mm256_add_pd( t, step), isHalfOrMore));
+    }
+
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = RoundD(src[i]);
+}
+
+/*! @abstract Log2DoubleKernel::EvaluateEncoding, 4 at a time. Every lane must hold a positive normal number. */
+static AVX2_FMA_KERNEL inline __m256d Log2Vector4( __m256i ix)
+{
+    typedef Log2K::Geometry G;
+    __m256i tmp = _mm256_sub_epi64( ix, _mm256_set1_epi64x( G::kOffset));
+    __m256i i = _mm256_and_si256( _mm256_srli_epi64( tmp, 52 - G::kTableBits), _mm256_set1_epi64x( (1 << G::kTableBits) - 1));
+    __m256d z = _mm256_castsi256_pd( _mm256_sub_epi64( ix, _mm256_and_si256( tmp, _mm256_set1_epi64x( (long long) 0xfff0000000000000ULL))));
+
+    // k = tmp >> 52, arithmetic. AVX2 has neither a 64-bit arithmetic shift nor an int64 to double conversion, so sign
+    // extend the 12-bit field by hand, and add it to the encoding of 1.5 * 2**52, whose ulp is 1.
+    const __m256i signOfField = _mm256_set1_epi64x( 0x800);
+    const __m256d kMagic = _mm256_set1_pd( 0x1.8p52);
+    __m256i k = _mm256_sub_epi64( _mm256_xor_si256( _mm256_srli_epi64( tmp, 52), signOfField), signOfField);
+    __m256d kd = _mm256_sub_pd( _mm256_castsi256_pd( _mm256_add_epi64( k, _mm256_castpd_si256( kMagic))), kMagic);
+
+    // Entries are three doubles, so gather at 3i, 3i + 1 and 3i + 2
+    const double * table = &Log2K::kTable.entries[0].invc;
+    __m256i index = _mm256_add_epi64( i, _mm256_slli_epi64( i, 1));
+    __m256d invc = _mm256_i64gather_pd( table, index, 8);
+    __m256d logcHi = _mm256_i64gather_pd( table + 1, index, 8);
+    __m256d logcLo = _mm256_i64gather_pd( table + 2, index, 8);
+
+    const __m256d invLn2Hi = _mm256_set1_pd( Log2K::kInvLn2Hi);
+    __m256d r = _mm256_fmsub_pd( z, invc, _mm256_set1_pd(1.0));
+    __m256d hi = _mm256_mul_pd( r, invLn2Hi);
+    __m256d lo = _mm256_add_pd( _mm256_fmsub_pd( r, invLn2Hi, hi), _mm256_mul_pd( r, _mm256_set1_pd( Log2K::kInvLn2Lo)));
+
+    __m256d s = _mm256_add_pd( kd, logcHi);
+    __m256d e1 = _mm256_sub_pd( logcHi, _mm256_sub_pd( s, kd));
+    __m256d t = _mm256_add_pd( s, hi);
+    __m256d bb = _mm256_sub_pd( t, s);
+    __m256d e2 = _mm256_add_pd( _mm256_sub_pd( s, _mm256_sub_pd( t, bb)), _mm256_sub_pd( hi, bb));
+
+    const __m256d firstHi = _mm256_set1_pd( Log2K::kFirstHi);
+    __m256d r2 = _mm256_mul_pd( r, r);
+    __m256d r2Lo = _mm256_fmsub_pd( r, r, r2);
+    __m256d pHi = _mm256_mul_pd( r2, firstHi);
+    __m256d pLo = _mm256_add_pd( _mm256_fmsub_pd( r2, firstHi, pHi),
+                               _mm256_add_pd( _mm256_mul_pd( r2Lo, firstHi), _mm256_mul_pd( r2, _mm256_set1_pd( Log2K::kFirstLo))));
+    __m256d q = _mm256_set1_pd( Log2K::kPolynomial.c[kLog2Degree - 1]);
+    for( int j = kLog2Degree - 2; j >= 1; j--)
+        q = _mm256_add_pd( _mm256_mul_pd( q, r), _mm256_set1_pd( Log2K::kPolynomial.c[j]));
+    __m256d rest = _mm256_mul_pd( _mm256_mul_pd( r2, r), q);
+
+    __m256d u = _mm256_add_pd( t, pHi);
+    __m256d e3 = _mm256_sub_pd( pHi, _mm256_sub_pd( u, t));
+
+    __m256d low = _mm256_add_pd( _mm256_add_pd( lo, pLo), rest);
+    low = _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( low, logcLo), e1), e2), e3);
+    return _mm256_add_pd( u, low);
+}
+
+static AVX2_FMA_KERNEL void Log2ArrayAVX2( const double * src, double * dst, size_t count)
+{
+    // Positive normal encodings are the signed integers in (DBL_MIN - 1 ulp, +inf)
+    const __m256i belowNormal = _mm256_set1_epi64x( 0x000fffffffffffffLL);
+    const __m256i infinity = _mm256_set1_epi64x( 0x7ff0000000000000LL);
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        __m256i ix = _mm256_loadu_si256( (const __m256i *)(src + i));
+        __m256i isNormal = _mm256_and_si256( _mm256_cmpgt_epi64( ix, belowNormal), _mm256_cmpgt_epi64( infinity, ix));
+        if( __builtin_expect( 0xf == _mm256_movemask_pd( _mm256_castsi256_pd( isNormal)), 1) )
+            _mm256_storeu_pd( dst + i, Log2Vector4( ix));
+        else
+            for( size_t j = i; j < i + 4; j++)
+                dst[j] = Log2D( src[j]);
+    }
+
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = Log2D(src[i]);
+}
+
+static const DoubleArrayKernels kAVX2KernelsD = { RoundingKernelAVX2D<kFloorImm, FloorD>, RoundArrayAVX2D,
+                                                  RoundingKernelAVX2D<kNearestImm, RintD>, Log2ArrayAVX2 };
+
+#pragma mark - AVX-512
+
+template <int kImm>
+static AVX512_KERNEL inline __m512d RoundVector8( __m512d x)
+{
+    if( kImm >= 0 )
+        return _mm512_roundscale_pd( x, kImm & 0xff);
+
+    // kImm < 0: half-way cases away from zero
+    const __m512i signBit = _mm512_set1_epi64( INT64_MIN);
+    const __m512i one = _mm512_castpd_si512( _mm512_set1_pd(1.0));
+    __m512d t = _mm512_roundscale_pd( x, kTruncImm);
+    __m512d fract = _mm512_abs_pd( _mm512_sub_pd( x, t));
+    __m512d step = _mm512_castsi512_pd( _mm512_or_si512( _mm512_and_si512( _mm512_castpd_si512(x), signBit), one));
+    __mmask8 isHalfOrMore = _mm512_cmp_pd_mask( fract, _mm512_set1_pd(0.5), _CMP_GE_OQ);
+    return _mm512_mask_add_pd( t, isHalfOrMore, t, step);
+}
+
+template <int kImm>
+static AVX512_KERNEL void RoundingKernelAVX512D( const double * src, double * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+        _mm512_storeu_pd( dst + i, RoundVector8<kImm>( _mm512_loadu_pd( src + i)));
+    if( i < count )
+    {
+        __mmask8 m = (__mmask8) ((1U << (count - i)) - 1U);
+        _mm512_mask_storeu_pd( dst + i, m, RoundVector8<kImm>( _mm512_maskz_loadu_pd( m, src + i)));
+    }
+    _mm256_zeroupper();
+}
+
+/*! @abstract Log2Vector4, 8 at a time. AVX-512F has the arithmetic shift, but not the conversion (that is DQ). */
+static AVX512_KERNEL inline __m512d Log2Vector8( __m512i ix)
+{
+    typedef Log2K::Geometry G;
+    __m512i tmp = _mm512_sub_epi64( ix, _mm512_set1_epi64( G::kOffset));
+    __m512i i = _mm512_and_si512( _mm512_srli_epi64( tmp, 52 - G::kTableBits), _mm512_set1_epi64( (1 << G::kTableBits) - 1));
+    __m512d z = _mm512_castsi512_pd( _mm512_sub_epi64( ix, _mm512_and_si512( tmp, _mm512_set1_epi64( (long long) 0xfff0000000000000ULL))));
+
+    const __m512d kMagic = _mm512_set1_pd( 0x1.8p52);
+    __m512i k = _mm512_srai_epi64( tmp, 52);
+    __m512d kd = _mm512_sub_pd( _mm512_castsi512_pd( _mm512_add_epi64( k, _mm512_castpd_si512( kMagic))), kMagic);
+
+    const double * table = &Log2K::kTable.entries[0].invc;
+    __m512i index = _mm512_add_epi64( i, _mm512_slli_epi64( i, 1));
+    __m512d invc = _mm512_i64gather_pd( index, table, 8);
+    __m512d logcHi = _mm512_i64gather_pd( index, table + 1, 8);
+    __m512d logcLo = _mm512_i64gather_pd( index, table + 2, 8);
+
+    const __m512d invLn2Hi = _mm512_set1_pd( Log2K::kInvLn2Hi);
+    __m512d r = _mm512_fmsub_pd( z, invc, _mm512_set1_pd(1.0));
+    __m512d hi = _mm512_mul_pd( r, invLn2Hi);
+    __m512d lo = _mm512_add_pd( _mm512_fmsub_pd( r, invLn2Hi, hi), _mm512_mul_pd( r, _mm512_set1_pd( Log2K::kInvLn2Lo)));
+
+    __m512d s = _mm512_add_pd( kd, logcHi);
+    __m512d e1 = _mm512_sub_pd( logcHi, _mm512_sub_pd( s, kd));
+    __m512d t = _mm512_add_pd( s, hi);
+    __m512d bb = _mm512_sub_pd( t, s);
+    __m512d e2 = _mm512_add_pd( _mm512_sub_pd( s, _mm512_sub_pd( t, bb)), _mm512_sub_pd( hi, bb));
+
+    const __m512d firstHi = _mm512_set1_pd( Log2K::kFirstHi);
+    __m512d r2 = _mm512_mul_pd( r, r);
+    __m512d r2Lo = _mm512_fmsub_pd( r, r, r2);
+    __m512d pHi = _mm512_mul_pd( r2, firstHi);
+    __m512d pLo = _mm512_add_pd( _mm512_fmsub_pd( r2, firstHi, pHi),
+                               _mm512_add_pd( _mm512_mul_pd( r2Lo, firstHi), _mm512_mul_pd( r2, _mm512_set1_pd( Log2K::kFirstLo))));
+    __m512d q = _mm512_set1_pd( Log2K::kPolynomial.c[kLog2Degree - 1]);
+    for( int j = kLog2Degree - 2; j >= 1; j--)
+        q = _mm512_add_pd( _mm512_mul_pd( q, r), _mm512_set1_pd( Log2K::kPolynomial.c[j]));
+    __m512d rest = _mm512_mul_pd( _mm512_mul_pd( r2, r), q);
+
+    __m512d u = _mm512_add_pd( t, pHi);
+    __m512d e3 = _mm512_sub_pd( pHi, _mm512_sub_pd( u, t));
+
+    __m512d low = _mm512_add_pd( _mm512_add_pd( lo, pLo), rest);
+    low = _mm512_add_pd( _mm512_add_pd( _mm512_add_pd( _mm512_add_pd( low, logcLo), e1), e2), e3);
+    return _mm512_add_pd( u, low);
+}
+
+static AVX512_KERNEL void Log2ArrayAVX512( const double * src, double * dst, size_t count)
+{
+    const __m512i belowNormal = _mm512_set1_epi64( 0x000fffffffffffffLL);
+    const __m512i infinity = _mm512_set1_epi64( 0x7ff0000000000000LL);
+
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m512i ix = _mm512_loadu_si512( src + i);
+        __mmask8 isNormal = _mm512_cmpgt_epi64_mask( ix, belowNormal) & _mm512_cmpgt_epi64_mask( infinity, ix);
+        if( __builtin_expect( 0xff == isNormal, 1) )
+            _mm512_storeu_pd( dst + i, Log2Vector8( ix));
+        else
+            for( size_t j = i; j < i + 8; j++)
+                dst[j] = Log2D( src[j]);
+    }
+
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = Log2D(src[i]);
+}
+
+static const DoubleArrayKernels kAVX512KernelsD = { RoundingKernelAVX512D<kFloorImm>, RoundingKernelAVX512D<-1>,
+                                                    RoundingKernelAVX512D<kNearestImm>, Log2ArrayAVX512 };
+
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+
+#pragma mark - NEON
+
+template <float64x2_t (*V)(float64x2_t), double (*F)(double)>
+static void RoundingKernelNEOND( const double * src, double * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 2 <= count; i += 2)
+        vst1q_f64( dst + i, V( vld1q_f64( src + i)));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static inline float64x2_t FloorNEOND( float64x2_t x){ return vrndmq_f64(x); }
+static inline float64x2_t RoundNEOND( float64x2_t x){ return vrndaq_f64(x); }      // half-way cases away from zero
+static inline float64x2_t NearestNEOND( float64x2_t x){ return vrndnq_f64(x); }    // not vrndiq: RintD ignores the rounding mode
+
+static const DoubleArrayKernels kNEONKernelsD = { RoundingKernelNEOND<FloorNEOND, FloorD>, RoundingKernelNEOND<RoundNEOND, RoundD>,
+                                                  RoundingKernelNEOND<NearestNEOND, RintD>, ScalarKernelD<Log2D> };
+#endif
+
+
+#pragma mark - Dispatch
+
+static const DoubleArrayKernels * SelectDoubleKernels(void)
+{
+    switch( GetVectorISA() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case kISASSE41:         return &kSSE41KernelsD;
+        case kISAAVX2:          return &kAVX2KernelsD;
+        case kISAAVX512:
+        case kISAAVX512FP16:    return &kAVX512KernelsD;
+#elif defined(__aarch64__)
+        case kISANEON:          return &kNEONKernelsD;
+#endif
+        default:                return &kScalarKernelsD;
+    }
+}
+
+static inline const DoubleArrayKernels & GetDoubleKernels(void)
+{
+    static const DoubleArrayKernels * kernels = SelectDoubleKernels();        // thread safe one-time initialization
+    return *kernels;
+}
+
+void FloorArray( const double * src, double * dst, size_t count){ GetDoubleKernels().floor( src, dst, count); }
+void RoundArray( const double * src, double * dst, size_t count){ GetDoubleKernels().round( src, dst, count); }
+void RintArray( const double * src, double * dst, size_t count){ GetDoubleKernels().rint( src, dst, count); }
+void Log2Array( const double * src, double * dst, size_t count){ GetDoubleKernels().log2( src, dst, count); }
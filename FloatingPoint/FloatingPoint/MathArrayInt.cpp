@@ -0,0 +1,351 @@
+//
+//  MathArrayInt.cpp
+//  FloatingPoint
+//
+//  Array forms of RintToInt32, FloorToInt64 and the rest, laid out like MathArray.cpp: a set of kernels per
+//  instruction set, one picked at first use.
+//
+//  Each vector is rounded to an integral float, converted, and then patched. The x86 conversions give the
+//  "integer indefinite" value, 0x80000000 (or 0x8000000000000000), for NaNs and for anything out of range.
+//  That is already the saturated answer for large negative numbers; large positive ones are flipped to the
+//  largest value, and NaNs cleared to 0. NEON's fcvt instructions saturate this way by themselves.
+//
+
+#include "Math.hpp"
+#include "VectorISA.hpp"
+#include <stdint.h>
+
+typedef void (*Int32ArrayFunction)( const float * src, int32_t * dst, size_t count);
+typedef void (*Int64ArrayFunction)( const float * src, int64_t * dst, size_t count);
+
+/*! @abstract The set of float to integer array kernels for one instruction set */
+typedef struct IntArrayKernels
+{
+    Int32ArrayFunction  rintToInt32;
+    Int32ArrayFunction  floorToInt32;
+    Int32ArrayFunction  roundToInt32;
+    Int64ArrayFunction  rintToInt64;
+    Int64ArrayFunction  floorToInt64;
+    Int64ArrayFunction  roundToInt64;
+}IntArrayKernels;
+
+
+#pragma mark - Scalar
+
+template <typename Int, Int (*F)(float)>
+static void ScalarKernelI( const float * src, Int * dst, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static const IntArrayKernels kScalarKernelsI = { ScalarKernelI<int32_t, RintToInt32>, ScalarKernelI<int32_t, FloorToInt32>,
+                                                 ScalarKernelI<int32_t, RoundToInt32>, ScalarKernelI<int64_t, RintToInt64>,
+                                                 ScalarKernelI<int64_t, FloorToInt64>, ScalarKernelI<int64_t, RoundToInt64> };
+
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// RintToInt32 rounds to nearest even whatever the rounding mode, like Rint, so it uses kNearestImm, not the current direction.
+// kRoundImm isn't an immediate the hardware knows: it means half-way cases away from zero, done as Round does in MathArray.cpp.
+static constexpr int kFloorImm   = _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC;
+static constexpr int kTruncImm   = _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC;
+static constexpr int kNearestImm = _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC;
+static constexpr int kRoundImm   = -1;
+
+// Integral doubles of magnitude under 2**51 have their value in the low bits of d + 1.5 * 2**52, as a two's complement
+// offset from the bits of 1.5 * 2**52. The add is exact, so the rounding mode doesn't matter.
+static constexpr double kInt64Magic = 0x1.8p52;
+static constexpr float kInt64MagicLimit = 0x1.0p51f;
+
+#pragma mark - SSE4.1
+
+template <int kImm>
+static SSE41_KERNEL inline __m128 RoundVectorSSE41( __m128 x)
+{
+    if( kImm != kRoundImm )
+        return _mm_round_ps( x, kImm);
+
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+    __m128 t = _mm_round_ps( x, kTruncImm);
+    __m128 fract = _mm_andnot_ps( signBit, _mm_sub_ps(x, t));
+    __m128 step = _mm_or_ps( _mm_and_ps( x, signBit), _mm_set1_ps(1.0f));
+    return _mm_blendv_ps( t, _mm_add_ps( t, step), _mm_cmpge_ps( fract, _mm_set1_ps(0.5f)));
+}
+
+/*! @abstract y is integral. Truncating it is exact, and the rest is the patching described at the top. */
+static SSE41_KERNEL inline __m128i SaturateToInt32SSE41( __m128 y)
+{
+    __m128i tooBig = _mm_castps_si128( _mm_cmpge_ps( y, _mm_set1_ps( 0x1.0p31f)));
+    __m128i notNaN = _mm_castps_si128( _mm_cmpord_ps( y, y));
+    return _mm_and_si128( _mm_xor_si128( _mm_cvttps_epi32(y), tooBig), notNaN);
+}
+
+template <int kImm, int32_t (*F)(float)>
+static SSE41_KERNEL void ToInt32KernelSSE41( const float * src, int32_t * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+        _mm_storeu_si128( (__m128i *)(dst + i), SaturateToInt32SSE41( RoundVectorSSE41<kImm>( _mm_loadu_ps( src + i))));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static SSE41_KERNEL inline __m128i SmallToInt64SSE41( __m128d d)
+{
+    const __m128d magic = _mm_set1_pd( kInt64Magic);
+    return _mm_sub_epi64( _mm_castpd_si128( _mm_add_pd( d, magic)), _mm_castpd_si128(magic));
+}
+
+/*  There is no cvtps2qq before AVX-512, so go through double. A vector with a NaN or anything too large for that is
+    done by the scalar function; quantized data doesn't have them.  */
+template <int kImm, int64_t (*F)(float)>
+static SSE41_KERNEL void ToInt64KernelSSE41( const float * src, int64_t * dst, size_t count)
+{
+    const __m128 limit = _mm_set1_ps( kInt64MagicLimit);
+    const __m128 signBit = _mm_set1_ps(-0.0f);
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        __m128 y = RoundVectorSSE41<kImm>( _mm_loadu_ps( src + i));
+        if( 0xf != _mm_movemask_ps( _mm_cmplt_ps( _mm_andnot_ps( signBit, y), limit)) )
+        {
+            for( size_t j = i; j < i + 4; j++)
+                dst[j] = F(src[j]);
+            continue;
+        }
+        _mm_storeu_si128( (__m128i *)(dst + i), SmallToInt64SSE41( _mm_cvtps_pd(y)));
+        _mm_storeu_si128( (__m128i *)(dst + i + 2), SmallToInt64SSE41( _mm_cvtps_pd( _mm_movehl_ps( y, y))));
+    }
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static const IntArrayKernels kSSE41KernelsI = { ToInt32KernelSSE41<kNearestImm, RintToInt32>, ToInt32KernelSSE41<kFloorImm, FloorToInt32>,
+                                                ToInt32KernelSSE41<kRoundImm, RoundToInt32>, ToInt64KernelSSE41<kNearestImm, RintToInt64>,
+                                                ToInt64KernelSSE41<kFloorImm, FloorToInt64>, ToInt64KernelSSE41<kRoundImm, RoundToInt64> };
+
+#pragma mark - AVX2
+
+template <int kImm>
+static AVX2_KERNEL inline __m256 RoundVectorAVX2( __m256 x)
+{
+    if( kImm != kRoundImm )
+        return _mm256_round_ps( x, kImm);
+
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+    __m256 t = _mm256_round_ps( x, kTruncImm);
+    __m256 fract = _mm256_andnot_ps( signBit, _mm256_sub_ps(x, t));
+    __m256 step = _mm256_or_ps( _mm256_and_ps( x, signBit), _mm256_set1_ps(1.0f));
+    return _mm256_blendv_ps( t, _mm256_add_ps( t, step), _mm256_cmp_ps( fract, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+}
+
+static AVX2_KERNEL inline __m256i SaturateToInt32AVX2( __m256 y)
+{
+    __m256i tooBig = _mm256_castps_si256( _mm256_cmp_ps( y, _mm256_set1_ps( 0x1.0p31f), _CMP_GE_OQ));
+    __m256i notNaN = _mm256_castps_si256( _mm256_cmp_ps( y, y, _CMP_ORD_Q));
+    return _mm256_and_si256( _mm256_xor_si256( _mm256_cvttps_epi32(y), tooBig), notNaN);
+}
+
+template <int kImm, int32_t (*F)(float)>
+static AVX2_KERNEL void ToInt32KernelAVX2( const float * src, int32_t * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+        _mm256_storeu_si256( (__m256i *)(dst + i), SaturateToInt32AVX2( RoundVectorAVX2<kImm>( _mm256_loadu_ps( src + i))));
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static AVX2_KERNEL inline __m256i SmallToInt64AVX2( __m256d d)
+{
+    const __m256d magic = _mm256_set1_pd( kInt64Magic);
+    return _mm256_sub_epi64( _mm256_castpd_si256( _mm256_add_pd( d, magic)), _mm256_castpd_si256(magic));
+}
+
+template <int kImm, int64_t (*F)(float)>
+static AVX2_KERNEL void ToInt64KernelAVX2( const float * src, int64_t * dst, size_t count)
+{
+    const __m256 limit = _mm256_set1_ps( kInt64MagicLimit);
+    const __m256 signBit = _mm256_set1_ps(-0.0f);
+
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m256 y = RoundVectorAVX2<kImm>( _mm256_loadu_ps( src + i));
+        if( 0xff != _mm256_movemask_ps( _mm256_cmp_ps( _mm256_andnot_ps( signBit, y), limit, _CMP_LT_OQ)) )
+        {
+            for( size_t j = i; j < i + 8; j++)
+                dst[j] = F(src[j]);
+            continue;
+        }
+        _mm256_storeu_si256( (__m256i *)(dst + i), SmallToInt64AVX2( _mm256_cvtps_pd( _mm256_castps256_ps128(y))));
+        _mm256_storeu_si256( (__m256i *)(dst + i + 4), SmallToInt64AVX2( _mm256_cvtps_pd( _mm256_extractf128_ps( y, 1))));
+    }
+    _mm256_zeroupper();
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static const IntArrayKernels kAVX2KernelsI = { ToInt32KernelAVX2<kNearestImm, RintToInt32>, ToInt32KernelAVX2<kFloorImm, FloorToInt32>,
+                                               ToInt32KernelAVX2<kRoundImm, RoundToInt32>, ToInt64KernelAVX2<kNearestImm, RintToInt64>,
+                                               ToInt64KernelAVX2<kFloorImm, FloorToInt64>, ToInt64KernelAVX2<kRoundImm, RoundToInt64> };
+
+#pragma mark - AVX-512
+
+// The tail is done with a masked load / store, so there is no scalar cleanup loop
+static AVX512DQ_KERNEL inline __mmask16 TailMask( size_t remaining){ return (__mmask16) ((1U << remaining) - 1U); }
+
+template <int kImm>
+static AVX512DQ_KERNEL inline __m512 RoundVectorAVX512( __m512 x)
+{
+    if( kImm != kRoundImm )
+        return _mm512_roundscale_ps( x, kImm);
+
+    const __m512i signBit = _mm512_set1_epi32( INT32_MIN);
+    const __m512i one = _mm512_castps_si512( _mm512_set1_ps(1.0f));
+    __m512 t = _mm512_roundscale_ps( x, kTruncImm);
+    __m512 fract = _mm512_abs_ps( _mm512_sub_ps( x, t));
+    __m512 step = _mm512_castsi512_ps( _mm512_or_si512( _mm512_and_si512( _mm512_castps_si512(x), signBit), one));
+    return _mm512_mask_add_ps( t, _mm512_cmp_ps_mask( fract, _mm512_set1_ps(0.5f), _CMP_GE_OQ), t, step);
+}
+
+template <int kImm>
+static AVX512DQ_KERNEL inline __m512i ToInt32Vector16( __m512 x)
+{
+    __m512 y = RoundVectorAVX512<kImm>(x);
+    __m512i result = _mm512_cvttps_epi32(y);
+    result = _mm512_mask_mov_epi32( result, _mm512_cmp_ps_mask( y, _mm512_set1_ps( 0x1.0p31f), _CMP_GE_OQ), _mm512_set1_epi32( INT32_MAX));
+    return _mm512_maskz_mov_epi32( _mm512_cmp_ps_mask( y, y, _CMP_ORD_Q), result);
+}
+
+template <int kImm>
+static AVX512DQ_KERNEL void ToInt32KernelAVX512( const float * src, int32_t * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16)
+        _mm512_storeu_si512( dst + i, ToInt32Vector16<kImm>( _mm512_loadu_ps( src + i)));
+    if( i < count )
+    {
+        __mmask16 m = TailMask( count - i);
+        _mm512_mask_storeu_epi32( dst + i, m, ToInt32Vector16<kImm>( _mm512_maskz_loadu_ps( m, src + i)));
+    }
+}
+
+/*! @abstract Convert 16 floats to 16 int64s, in two vectors of 8 */
+template <int kImm>
+static AVX512DQ_KERNEL inline void ToInt64Vector16( __m512 x, __m512i * low, __m512i * high)
+{
+    __m512 y = RoundVectorAVX512<kImm>(x);
+    __mmask16 tooBig = _mm512_cmp_ps_mask( y, _mm512_set1_ps( 0x1.0p63f), _CMP_GE_OQ);
+    __mmask16 notNaN = _mm512_cmp_ps_mask( y, y, _CMP_ORD_Q);
+    const __m512i largest = _mm512_set1_epi64( INT64_MAX);
+
+    __m512i lo = _mm512_cvttps_epi64( _mm512_castps512_ps256(y));
+    __m512i hi = _mm512_cvttps_epi64( _mm512_extractf32x8_ps( y, 1));
+    *low = _mm512_maskz_mov_epi64( (__mmask8) notNaN, _mm512_mask_mov_epi64( lo, (__mmask8) tooBig, largest));
+    *high = _mm512_maskz_mov_epi64( (__mmask8)(notNaN >> 8), _mm512_mask_mov_epi64( hi, (__mmask8)(tooBig >> 8), largest));
+}
+
+template <int kImm>
+static AVX512DQ_KERNEL void ToInt64KernelAVX512( const float * src, int64_t * dst, size_t count)
+{
+    __m512i low, high;
+    size_t i = 0;
+    for( ; i + 16 <= count; i += 16)
+    {
+        ToInt64Vector16<kImm>( _mm512_loadu_ps( src + i), &low, &high);
+        _mm512_storeu_si512( dst + i, low);
+        _mm512_storeu_si512( dst + i + 8, high);
+    }
+    if( i < count )
+    {
+        __mmask16 m = TailMask( count - i);
+        ToInt64Vector16<kImm>( _mm512_maskz_loadu_ps( m, src + i), &low, &high);
+        _mm512_mask_storeu_epi64( dst + i, (__mmask8) m, low);
+        _mm512_mask_storeu_epi64( dst + i + 8, (__mmask8)(m >> 8), high);
+    }
+}
+
+static const IntArrayKernels kAVX512KernelsI = { ToInt32KernelAVX512<kNearestImm>, ToInt32KernelAVX512<kFloorImm>,
+                                                 ToInt32KernelAVX512<kRoundImm>, ToInt64KernelAVX512<kNearestImm>,
+                                                 ToInt64KernelAVX512<kFloorImm>, ToInt64KernelAVX512<kRoundImm> };
+
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+
+#pragma mark - NEON
+
+// fcvtns, fcvtms and fcvtas round and convert in one instruction, and saturate just as we want
+
+template <int32x4_t (*V)(float32x4_t), int32_t (*F)(float)>
+static void ToInt32KernelNEON( const float * src, int32_t * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+        vst1q_s32( dst + i, V( vld1q_f32( src + i)));
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+/*  Widening to double is exact, and every float out of int64 range is out of range as a double too  */
+template <int64x2_t (*V)(float64x2_t), int64_t (*F)(float)>
+static void ToInt64KernelNEON( const float * src, int64_t * dst, size_t count)
+{
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        float32x4_t x = vld1q_f32( src + i);
+        vst1q_s64( dst + i, V( vcvt_f64_f32( vget_low_f32(x))));
+        vst1q_s64( dst + i + 2, V( vcvt_high_f64_f32(x)));
+    }
+    for( ; i < count; i++)
+        dst[i] = F(src[i]);
+}
+
+static inline int32x4_t RintNEONI( float32x4_t x){ return vcvtnq_s32_f32(x); }    // to nearest even, whatever the rounding mode
+static inline int32x4_t FloorNEONI( float32x4_t x){ return vcvtmq_s32_f32(x); }
+static inline int32x4_t RoundNEONI( float32x4_t x){ return vcvtaq_s32_f32(x); }   // half-way cases away from zero
+static inline int64x2_t RintNEONL( float64x2_t x){ return vcvtnq_s64_f64(x); }
+static inline int64x2_t FloorNEONL( float64x2_t x){ return vcvtmq_s64_f64(x); }
+static inline int64x2_t RoundNEONL( float64x2_t x){ return vcvtaq_s64_f64(x); }
+
+static const IntArrayKernels kNEONKernelsI = { ToInt32KernelNEON<RintNEONI, RintToInt32>, ToInt32KernelNEON<FloorNEONI, FloorToInt32>,
+                                               ToInt32KernelNEON<RoundNEONI, RoundToInt32>, ToInt64KernelNEON<RintNEONL, RintToInt64>,
+                                               ToInt64KernelNEON<FloorNEONL, FloorToInt64>, ToInt64KernelNEON<RoundNEONL, RoundToInt64> };
+#endif
+
+
+#pragma mark - Dispatch
+
+static const IntArrayKernels * SelectIntKernels(void)
+{
+    switch( GetVectorISA() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case kISASSE41:         return &kSSE41KernelsI;
+        case kISAAVX2:          return &kAVX2KernelsI;
+        case kISAAVX512:
+        case kISAAVX512FP16:    return __builtin_cpu_supports("avx512dq") ? &kAVX512KernelsI : &kAVX2KernelsI;   // only Xeon Phi lacks it
+#elif defined(__aarch64__)
+        case kISANEON:          return &kNEONKernelsI;
+#endif
+        default:                return &kScalarKernelsI;
+    }
+}
+
+static inline const IntArrayKernels & GetIntKernels(void)
+{
+    static const IntArrayKernels * kernels = SelectIntKernels();        // thread safe one-time initialization
+    return *kernels;
+}
+
+void RintToInt32Array( const float * src, int32_t * dst, size_t count){ GetIntKernels().rintToInt32( src, dst, count); }
+void FloorToInt32Array( const float * src, int32_t * dst, size_t count){ GetIntKernels().floorToInt32( src, dst, count); }
+void RoundToInt32Array( const float * src, int32_t * dst, size_t count){ GetIntKernels().roundToInt32( src, dst, count); }
+void RintToInt64Array( const float * src, int64_t * dst, size_t count){ GetIntKernels().rintToInt64( src, dst, count); }
+void FloorToInt64Array( const float * src, int64_t * dst, size_t count){ GetIntKernels().floorToInt64( src, dst, count); }
+void RoundToInt64Array( const float * src, int64_t * dst, size_t count){ GetIntKernels().roundToInt64( src, dst, count); }
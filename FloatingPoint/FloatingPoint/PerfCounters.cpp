@@ -0,0 +1,121 @@
+//
+//  PerfCounters.cpp
+//  FloatingPoint
+//
+//  perf_event_open(2) backend for PerfCounters.hpp. Each event is opened on its own rather than as a group,
+//  so that one the machine can't count (LLC misses in many VMs) doesn't take the others with it.
+//
+
+#include "PerfCounters.hpp"
+#include <string.h>
+
+static const char * kPerfEventNames[kPerfEventCount] = { "cycles", "instructions", "branch misses", "L1D misses", "LLC misses" };
+
+const char * PerfEventName( PerfEvent event)
+{
+    return event < kPerfEventCount ? kPerfEventNames[event] : "unknown";
+}
+
+bool PerfCountersAvailable( const PerfCounters & counters)
+{
+    for( int i = 0; i < kPerfEventCount; i++)
+        if( counters.fd[i] >= 0 )
+            return true;
+    return false;
+}
+
+#if __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static const struct{ uint32_t type; uint64_t config; } kPerfEventConfig[kPerfEventCount] =
+{
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_CPU_CYCLES },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_INSTRUCTIONS },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_BRANCH_MISSES },
+    { PERF_TYPE_HW_CACHE,   PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { PERF_TYPE_HARDWARE,   PERF_COUNT_HW_CACHE_MISSES },
+};
+
+PerfCounters OpenPerfCounters(void)
+{
+    PerfCounters result;
+    for( int i = 0; i < kPerfEventCount; i++)
+    {
+        struct perf_event_attr attr;
+        memset( &attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = kPerfEventConfig[i].type;
+        attr.config = kPerfEventConfig[i].config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;            // just our code, and allowed at perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // this thread, any cpu, no group, no flags
+        result.fd[i] = (int) syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    return result;
+}
+
+void ClosePerfCounters( PerfCounters * counters)
+{
+    for( int i = 0; i < kPerfEventCount; i++)
+    {
+        if( counters->fd[i] >= 0 )
+            close( counters->fd[i]);
+        counters->fd[i] = -1;
+    }
+}
+
+void StartPerfCounters( const PerfCounters & counters)
+{
+    for( int i = 0; i < kPerfEventCount; i++)
+        if( counters.fd[i] >= 0 )
+        {
+            ioctl( counters.fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl( counters.fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+}
+
+void StopPerfCounters( const PerfCounters & counters, PerfCounts * result)
+{
+    for( int i = 0; i < kPerfEventCount; i++)
+        if( counters.fd[i] >= 0 )
+            ioctl( counters.fd[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for( int i = 0; i < kPerfEventCount; i++)
+    {
+        // value, time enabled, time running. If the kernel had more events than hardware counters, it took
+        // turns, and the count covers only the running part of the time. Scale it up to the whole.
+        uint64_t values[3] = {};
+        result->valid[i] = counters.fd[i] >= 0 && (ssize_t) sizeof(values) == read( counters.fd[i], values, sizeof(values)) && values[2];
+        result->count[i] = result->valid[i] ? (double) values[0] * (double) values[1] / (double) values[2] : 0;
+    }
+}
+
+#else
+
+PerfCounters OpenPerfCounters(void)
+{
+    PerfCounters result;
+    for( int i = 0; i < kPerfEventCount; i++)
+        result.fd[i] = -1;
+    return result;
+}
+
+void ClosePerfCounters( PerfCounters *){}
+void StartPerfCounters( const PerfCounters &){}
+
+void StopPerfCounters( const PerfCounters &, PerfCounts * result)
+{
+    for( int i = 0; i < kPerfEventCount; i++)
+    {
+        result->count[i] = 0;
+        result->valid[i] = false;
+    }
+}
+
+#endif
@@ -0,0 +1,85 @@
+//
+//  PerfCounters.hpp
+//  FloatingPoint
+//
+//  Hardware performance counters for the benchmark harness: cycles, instructions retired, branch misses, and
+//  L1 data and last level cache misses. Time alone says a function is slow. These say why: a low IPC with
+//  cache misses is waiting on memory (a table too big for L1?), and branch misses mean the special case
+//  tests are not as predictable as hoped.
+//
+//  On Linux they are read through perf_event_open(2). Counters are often not available: containers and
+//  VMs may have no PMU, and /proc/sys/kernel/perf_event_paranoid may forbid them. Then each event that
+//  could not be opened is marked invalid, and cycles fall back to CycleClock (rdtsc), so callers always
+//  get a cycle count of some kind. Elsewhere (macOS needs the private kperf framework) only the fallback
+//  is there.
+//
+//      https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+//
+
+#ifndef PERF_COUNTERS_HPP
+#define PERF_COUNTERS_HPP   1
+
+#include "Benchmark.hpp"
+#include <stdint.h>
+
+/*! @abstract The events we count */
+typedef enum PerfEvent
+{
+    kPerfCycles = 0,
+    kPerfInstructions,
+    kPerfBranchMisses,
+    kPerfL1DMisses,             // L1 data cache read misses
+    kPerfLLCMisses,             // last level cache misses
+
+    kPerfEventCount
+}PerfEvent;
+
+/*! @abstract Counters for the calling thread. Make one with OpenPerfCounters. fd < 0 for events we couldn't get. */
+typedef struct PerfCounters
+{
+    int     fd[kPerfEventCount];
+}PerfCounters;
+
+/*! @abstract What was counted between StartPerfCounters and StopPerfCounters */
+typedef struct PerfCounts
+{
+    double      count[kPerfEventCount];     // scaled up if the kernel had to share the hardware counters (multiplexing)
+    bool        valid[kPerfEventCount];
+    uint64_t    ticks;                      // CycleClock ticks over the same interval. Always valid.
+
+    /*! @abstract Cycles from the counters if we have them, or else the CycleClock fallback */
+    inline double Cycles() const { return valid[kPerfCycles] ? count[kPerfCycles] : (double) ticks; }
+}PerfCounts;
+
+/*! @abstract Open the counters for the calling thread. Never fails: events that can't be counted are just invalid. */
+PerfCounters OpenPerfCounters(void);
+void ClosePerfCounters( PerfCounters * counters);
+
+/*! @abstract true if at least one hardware event could be opened */
+bool PerfCountersAvailable( const PerfCounters & counters);
+
+/*! @abstract The name of an event, e.g. "branch misses" */
+const char * PerfEventName( PerfEvent event);
+
+void StartPerfCounters( const PerfCounters & counters);
+void StopPerfCounters( const PerfCounters & counters, PerfCounts * result);
+
+/*! @abstract Count events over iterationCount calls to f(), on the calling thread.
+ *  @discussion Pick iterationCount so the run is long, e.g. a multiple of Benchmark::iterationCount from BenchmarkFunctor:
+ *              the counters are read only at the ends, so there is nothing to subtract. */
+template <typename Functor>
+PerfCounts CountEvents( const PerfCounters & counters, const Functor & f, uint64_t iterationCount)
+{
+    Functor work = f;
+    PerfCounts result;
+
+    RunFunctor( work, iterationCount);          // warm up caches and branch predictors
+    uint64_t start = CycleClock::Read();
+    StartPerfCounters( counters);
+    RunFunctor( work, iterationCount);
+    StopPerfCounters( counters, &result);
+    result.ticks = CycleClock::Read() - start;
+    return result;
+}
+
+#endif /* PERF_COUNTERS_HPP */
@@ -0,0 +1,54 @@
+//
+//  Polynomial.hpp
+//  FloatingPoint
+//
+//  Polynomial approximations shared by the Log2 and Exp2 kernels: fitted at compile time by constexpr code
+//  (see ConstexprMath.hpp), evaluated at run time by Horner's rule in double.
+//
+
+#ifndef POLYNOMIAL_HPP
+#define POLYNOMIAL_HPP  1
+
+#include "ConstexprMath.hpp"
+
+template <unsigned kDegree>
+struct Polynomial
+{
+    double  c[kDegree];     // c[0] + c[1] r + ... + c[kDegree-1] r**(kDegree-1)
+    double  error;          // estimated worst relative error over [-maxReduced, maxReduced]
+
+    /*! @abstract The polynomial at r, by Horner's rule */
+    constexpr double operator()( double r) const
+    {
+        double q = c[kDegree - 1];
+        for( int j = int(kDegree) - 2; j >= 0; j--)
+            q = q * r + c[j];
+        return q;
+    }
+};
+
+/*! @abstract Fit a polynomial to f over [-maxReduced, maxReduced], and estimate its relative error
+ *  @discussion f should be smooth and well away from zero over the interval: fit f(r) = log2(1 + r) / r, not log2(1 + r). */
+template <unsigned kDegree, typename Function>
+constexpr Polynomial<kDegree> FitPolynomial( Function f, double maxReduced)
+{
+    static_assert( kDegree >= 1 && kDegree <= 10, "unreasonable polynomial degree" );
+
+    Polynomial<kDegree> p = {};
+    ConstexprMath::ChebyshevFit( f, maxReduced, p.c);
+
+    // Sample the error densely. The error of a near-minimax fit ripples between the nodes, so this finds its peaks.
+    constexpr int kSamples = 512;
+    for( int i = 0; i <= kSamples; i++)
+    {
+        double r = maxReduced * double(2 * i - kSamples) / kSamples;
+        double exact = f(r);
+        double error = (p(r) - exact) / exact;
+        error = error < 0 ? -error : error;
+        if( error > p.error )
+            p.error = error;
+    }
+    return p;
+}
+
+#endif /* POLYNOMIAL_HPP */
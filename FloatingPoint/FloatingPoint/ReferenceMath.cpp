@@ -0,0 +1,264 @@
+//
+//  ReferenceMath.cpp
+//  FloatingPoint
+//
+
+#include "ReferenceMath.hpp"
+#include "ConstexprMath.hpp"
+#include "Math.hpp"
+#include <math.h>
+#include <stdint.h>
+
+#pragma mark - Log2
+
+/*! @abstract 1/(2i + 1) for the atanh series, in double-double, made at compile time */
+static constexpr int kAtanhTerms = 22;
+typedef struct AtanhCoefficients{ ConstexprMath::Extended c[kAtanhTerms]; }AtanhCoefficients;
+static constexpr AtanhCoefficients kAtanhCoefficients = []()
+{
+    AtanhCoefficients result = {};
+    for( int i = 0; i < kAtanhTerms; i++)
+        result.c[i] = ConstexprMath::Divide( ConstexprMath::Extended{ 1.0, 0}, 2.0 * i + 1.0);
+    return result;
+}();
+
+/*  x = 2**k m with m in [sqrt(1/2), sqrt(2)), and ln(m) = 2 atanh(s), s = (m - 1) / (m + 1), as in
+    ConstexprMath::Log2, but in double-double. |s| < 0.172, so each term of the series is at least 2**-5 smaller
+    than the one before, and 22 terms are plenty. m - 1 is exact, and m + 1 is exact as a double-double. */
+DoubleDouble Log2Reference( double x)
+{
+    union{ double d; uint64_t u; }u = {x};
+    uint64_t ix = u.u;
+    if( ix - 0x0010000000000000ULL >= 0x7ff0000000000000ULL - 0x0010000000000000ULL )
+    {
+        if( 0 == (ix << 1) )
+            return (DoubleDouble){ -INFINITY, 0};
+        if( 0x7ff0000000000000ULL == ix )
+            return (DoubleDouble){ x, 0};
+        if( (ix >> 63) || (ix << 1) >= 0xffe0000000000000ULL )
+            return (DoubleDouble){ NAN, 0};
+    }
+
+    int64_t k = 0;
+    if( ix < 0x0010000000000000ULL )        // subnormal
+    {
+        u.d = x * 0x1.0p54;
+        ix = u.u;
+        k = -54;
+    }
+
+    uint64_t tmp = ix - 0x3fe6a09e667f3bcdULL;
+    k += int64_t(tmp) >> 52;
+    union{ uint64_t u; double d; }m = { ix - (tmp & 0xfff0000000000000ULL) };
+
+    DoubleDouble s = Divide( (DoubleDouble){ m.d - 1.0, 0}, TwoSum( m.d, 1.0));
+    DoubleDouble s2 = Multiply( s, s);
+
+    // atanh(s) = s (1 + s**2/3 + s**4/5 + ...)
+    const ConstexprMath::Extended * c = kAtanhCoefficients.c;
+    DoubleDouble sum = { c[kAtanhTerms - 1].hi, c[kAtanhTerms - 1].lo };
+    for( int i = kAtanhTerms - 2; i >= 0; i--)
+        sum = Add( Multiply( sum, s2), (DoubleDouble){ c[i].hi, c[i].lo });
+    DoubleDouble atanh = Multiply( s, sum);
+
+    // log2(m) = 2 atanh(s) / ln(2)
+    const DoubleDouble kTwoOverLn2 = { 0x1.71547652b82fep+1, 0x1.777d0ffda0d24p-55 };
+    return Add( (DoubleDouble){ (double) k, 0}, Multiply( atanh, kTwoOverLn2));
+}
+
+
+#pragma mark - Float references: logarithms
+
+// ln(2) and log10(2), and ln(2) cut in two ways for products that have to be exact
+static constexpr double kLn2Hi = 0x1.62e42fefa39efp-1,          kLn2Lo = 0x1.abc9e3b39803fp-56;
+static constexpr double kLog10Of2 = 0x1.34413509f79ffp-2;
+static constexpr double kLn2Hi27 = 0x1.62e42fcp-1,              kLn2Lo27 = 0x1.7d1cf79abc9e4p-28;       // 27 bits, and the rest
+static constexpr double kLn2Over64Hi = 0x1.62e42fefap-7,        kLn2Over64Lo = 0x1.cf79abc9e3b3ap-46;  // 36 bits, and the rest
+static constexpr double kSixtyFourOverLn2 = 0x1.71547652b82fep+6;
+
+/*  Log2D is within 0.51 ulps. Multiplying by a constant rounded to double adds a little over half an ulp more. */
+double ReferenceLog2( double x){ return Log2D(x); }
+double ReferenceLog( double x){ return Log2D(x) * kLn2Hi; }
+double ReferenceLog10( double x){ return Log2D(x) * kLog10Of2; }
+
+/*! @abstract ln(1 + x) - ln(hi), where hi = 1 + x rounded: lo / hi, with lo the rounding error of the sum
+ *  @discussion ln(hi + lo) = ln(hi) + lo/hi - (lo/hi)**2 / 2 + ..., and |lo/hi| <= 2**-53, so one term does. */
+static inline double Log1pCorrection( double x, double hi)
+{
+    if( ! (fabs(x) < INFINITY) )
+        return 0;
+    double lo = TwoSum( 1.0, x).lo;
+    return 0 == lo ? 0 : lo / hi;
+}
+
+double ReferenceLog1p( double x)
+{
+    double hi = 1.0 + x;
+    return Log2D(hi) * kLn2Hi + Log1pCorrection( x, hi);
+}
+
+void ReferenceLog2Array( const float * x, double * correct, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        correct[i] = x[i];
+    Log2Array( correct, correct, count);
+}
+
+void ReferenceLogArray( const float * x, double * correct, size_t count)
+{
+    ReferenceLog2Array( x, correct, count);
+    for( size_t i = 0; i < count; i++)
+        correct[i] *= kLn2Hi;
+}
+
+void ReferenceLog10Array( const float * x, double * correct, size_t count)
+{
+    ReferenceLog2Array( x, correct, count);
+    for( size_t i = 0; i < count; i++)
+        correct[i] *= kLog10Of2;
+}
+
+void ReferenceLog1pArray( const float * x, double * correct, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        correct[i] = 1.0 + (double) x[i];
+    Log2Array( correct, correct, count);
+    for( size_t i = 0; i < count; i++)
+        correct[i] = correct[i] * kLn2Hi + Log1pCorrection( x[i], 1.0 + (double) x[i]);
+}
+
+
+#pragma mark - Float references: exponentials
+
+/*! @abstract 2**(j/64) for j in [0, 64), in double-double, by the Taylor series of exp(j ln(2) / 64) at compile time */
+typedef struct Exp2Table{ ConstexprMath::Extended entries[64]; }Exp2Table;
+static constexpr Exp2Table kExp2Table = []()
+{
+    Exp2Table table = {};
+    for( int j = 0; j < 64; j++)
+    {
+        ConstexprMath::Extended y = ConstexprMath::Divide( ConstexprMath::Multiply( { kLn2Hi, kLn2Lo}, { double(j), 0}), 64.0);
+        ConstexprMath::Extended term = { 1.0, 0}, sum = { 1.0, 0};
+        for( int i = 1; i < 30; i++)
+        {
+            term = ConstexprMath::Divide( ConstexprMath::Multiply( term, y), double(i));
+            sum = ConstexprMath::Add( sum, term);
+        }
+        table.entries[j] = sum;
+    }
+    return table;
+}();
+
+/*! @abstract 1/2!, 1/3!, ... 1/11!, for expm1 near 0 */
+typedef struct Expm1Series{ double c[10]; }Expm1Series;
+static constexpr Expm1Series kExpm1Series = []()
+{
+    Expm1Series series = {};
+    double factorial = 1.0;
+    for( int i = 0; i < 10; i++)
+    {
+        factorial *= i + 2;
+        series.c[i] = 1.0 / factorial;
+    }
+    return series;
+}();
+
+/*! @abstract The integer nearest x, for |x| < 2**51, by adding and taking away 1.5 * 2**52
+ *  @discussion Faster than RintD. In another rounding mode the answer is an integer next to x rather than the nearest,
+ *              which the callers don't mind: their remainders are still exact, and only a little larger. */
+static inline double RoundToInteger( double x)
+{
+    return (x + 0x1.8p52) - 0x1.8p52;
+}
+
+/*! @abstract x 2**n, by writing the exponent of 2**n where that is a normal number */
+static inline double ScaleByPowerOfTwo( double x, int n)
+{
+    if( n < -1022 || n > 1023 )
+        return ldexp( x, n);
+    union{ uint64_t u; double d; }scale = { uint64_t(n + 1023) << 52 };
+    return x * scale.d;
+}
+
+/*! @abstract 2**(k/64) exp(yHi + yLo) = 2**n (hi + lo), for |yHi + yLo| <= ln(2)/128 or a hair over
+ *  @discussion exp(y) - 1 is y plus a short series, whose terms are only needed to 2**-53 of themselves.
+ *              The result is good to about 2**-60. No fma(): without FMA hardware it's a library call. */
+static inline DoubleDouble ExpUnscaled( int64_t k, double yHi, double yLo, int * n)
+{
+    *n = int(k >> 6);
+    const ConstexprMath::Extended & t = kExp2Table.entries[k & 63];
+    DoubleDouble y = TwoSum( yHi, yLo);
+
+    // exp(y) - 1 = y + y**2 (1/2 + y/6 + ... + y**4/720). y**7/7! is under 2**-65. y.hi y.lo is the y**2/2 that y.hi**2 misses.
+    double q = (y.hi * y.hi) * (0.5 + y.hi * (0x1.5555555555555p-3 + y.hi * (0x1.5555555555555p-5 + y.hi * (0x1.1111111111111p-7 + y.hi * 0x1.6c16c16c16c17p-10))));
+    double expm1y = y.hi + (y.lo + (q + y.hi * y.lo));
+    return DoubleDouble{ t.hi, t.lo + t.hi * expm1y };
+}
+
+double ReferenceExp2( double x)
+{
+    if( isnan(x) )
+        return x + x;
+    if( x >= 1024.0 )
+        return INFINITY;
+    if( x < -1100.0 )
+        return 0;
+
+    // x = k/64 + r, exactly. Then y = r ln(2) = yHi + yLo, where yHi is the top 26 bits of r times the top 27 of ln(2), exactly.
+    double kd = RoundToInteger( x * 64.0);
+    double r = x - kd * 0x1.0p-6;
+    union{ double d; uint64_t u; }rHi = {r};
+    rHi.u &= 0xfffffffff8000000ULL;
+    double yHi = rHi.d * kLn2Hi27;
+    double yLo = (r - rHi.d) * kLn2Hi27 + r * kLn2Lo27;
+
+    int n;
+    DoubleDouble e = ExpUnscaled( (int64_t) kd, yHi, yLo, &n);
+    return ScaleByPowerOfTwo( e.hi + e.lo, n);
+}
+
+double ReferenceExpm1( double x)
+{
+    if( isnan(x) )
+        return x + x;
+    if( x > 710.0 )
+        return INFINITY;
+    if( x < -40.0 )             // e**-40 is under half an ulp of 1
+        return -1.0;
+
+    // Near 0, where exp(x) - 1 would cancel, the Taylor series, to x**11/11! which is under 2**-60 of x
+    if( fabs(x) < 0x1.0p-4 )
+    {
+        const double * c = kExpm1Series.c;
+        double p = c[9];
+        for( int i = 8; i >= 0; i--)
+            p = p * x + c[i];
+        return x + (x * x) * p;
+    }
+
+    // x = k ln(2)/64 + y (Cody and Waite). |k| < 2**16, and the high part of ln(2)/64 has 36 bits, so yHi is exact.
+    double kd = RoundToInteger( x * kSixtyFourOverLn2);
+    double yHi = x - kd * kLn2Over64Hi;
+    double yLo = -(kd * kLn2Over64Lo);
+
+    // Elsewhere exp(x) >= 1.06 or <= 0.94, so subtracting 1 loses at most 5 bits of the 60
+    int n;
+    DoubleDouble e = ExpUnscaled( (int64_t) kd, yHi, yLo, &n);
+    if( n > 1000 )              // the 1 is lost anyway, and 2**n on its own may overflow where the answer doesn't
+        return ScaleByPowerOfTwo( e.hi + e.lo, n);
+    double hi = ScaleByPowerOfTwo( e.hi, n);
+    double lo = ScaleByPowerOfTwo( e.lo, n);
+    return (hi - 1.0) + lo;
+}
+
+void ReferenceExp2Array( const float * x, double * correct, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        correct[i] = ReferenceExp2( x[i]);
+}
+
+void ReferenceExpm1Array( const float * x, double * correct, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        correct[i] = ReferenceExpm1( x[i]);
+}
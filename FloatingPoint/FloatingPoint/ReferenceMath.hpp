@@ -0,0 +1,47 @@
+//
+//  ReferenceMath.hpp
+//  FloatingPoint
+//
+//  Reference answers for testing, more precise than the functions they test.
+//
+//  For the double functions: Log2Reference, in double-double (DoubleDouble.hpp), good to about 2**-100. Scoring
+//  a double function against libm or against itself proves nothing: the reference has to be much more precise
+//  than the answer. These are slow, a few hundred flops each, but they are only used to test, and to settle the
+//  rare float results that land too close to a rounding boundary to call.
+//
+//  For the float functions: Reference{Log2,Exp2,Log,Log10,Log1p,Expm1}, the exact answer to within about 2 ulps of
+//  double, which is 2**-28 ulps of float, far inside kReferenceError. libm's double functions would do as well, but
+//  they aren't the same from one libm to the next, and the sweeps spend as long in them as in the functions being
+//  tested. These are error-free transforms on top of a table: the logs are Log2D, which is checked against
+//  Log2Reference, times a constant, and the exponentials take the exact remainder after 2**(k/64) in double-double.
+//  The array forms do a block at a time, with Log2Array's vector kernels for the logs.
+//
+#ifndef REFERENCE_MATH_HPP
+#define REFERENCE_MATH_HPP  1
+
+#include "DoubleDouble.hpp"
+#include <stddef.h>
+
+/*! @abstract log2(x) = hi + lo, to about 2**-100 relative
+ *  @discussion Special cases are exact, in hi, with lo = 0: log2(+-0) = -inf, log2(1) = +0, log2(inf) = inf, and
+ *              NaN for negative numbers and NaNs. Powers of two are exact too. */
+DoubleDouble Log2Reference( double x);
+
+/*! @abstract References for the float functions, to about 2 ulps of double
+ *  @discussion Special cases are the ones libm gives. x may be any double, though only floats are ever passed. */
+double ReferenceLog2( double x);
+double ReferenceExp2( double x);
+double ReferenceLog( double x);
+double ReferenceLog10( double x);
+double ReferenceLog1p( double x);
+double ReferenceExpm1( double x);
+
+/*! @abstract correct[i] = ReferenceLog2( x[i]) etc. for i in [0, count), bit for bit the same as the scalar forms */
+void ReferenceLog2Array( const float * x, double * correct, size_t count);
+void ReferenceExp2Array( const float * x, double * correct, size_t count);
+void ReferenceLogArray( const float * x, double * correct, size_t count);
+void ReferenceLog10Array( const float * x, double * correct, size_t count);
+void ReferenceLog1pArray( const float * x, double * correct, size_t count);
+void ReferenceExpm1Array( const float * x, double * correct, size_t count);
+
+#endif /* REFERENCE_MATH_HPP */
@@ -0,0 +1,440 @@
+//
+//  ReferenceStore.cpp
+//  FloatingPoint
+//
+//  File layout:    ReferenceFileHeader
+//                  uint64_t offsets[ chunkCount + 1]      file offset of each chunk, and of the end of the last one
+//                  compressed chunks
+//
+//  A chunk is a stream of tokens, one R token and (double tables only) one residual token per input
+//  in order, except that a token for a run of zeros stands in for all the tokens of that run. The
+//  predictor starts over at 0 at the beginning of each chunk, so chunks can be decoded independently.
+//
+
+#include "ReferenceStore.hpp"
+#include "ThreadPool.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static constexpr char       kReferenceMagic[8] = { 'F', 'P', 'R', 'E', 'F', 'T', 'B', 'L' };
+static constexpr uint32_t   kReferenceVersion = 1;
+static constexpr int        kResidualBits = 19;         // residuals are in units of 2**-kResidualBits ulps
+
+// Worst case bytes per input: a 33 bit R token and a 21 bit residual token, 7 bits per byte
+static constexpr size_t     kMaxBytesPerInput = 5 + 3;
+
+typedef struct ReferenceFileHeader
+{
+    char        magic[8];
+    uint32_t    version;
+    uint32_t    kind;               // ReferenceKind
+    char        name[32];
+    uint64_t    chunkSize;          // kReferenceChunkSize
+    uint64_t    firstChunk;         // the table covers inputs [firstChunk, firstChunk + chunkCount) * chunkSize
+    uint64_t    chunkCount;
+}ReferenceFileHeader;
+
+struct ReferenceTable
+{
+    const uint8_t *     data;       // the whole file
+    size_t              size;
+    const uint64_t *    offsets;
+    ReferenceKind       kind;
+    uint64_t            firstChunk;
+    uint64_t            chunkCount;
+    char                name[32];
+};
+
+
+#pragma mark - Encoding
+
+static inline uint64_t ZigZag( int64_t v){ return (uint64_t(v) << 1) ^ uint64_t(v >> 63); }
+static inline int64_t UnZigZag( uint64_t z){ return int64_t(z >> 1) ^ -int64_t(z & 1); }
+
+static inline uint8_t * WriteVarint( uint8_t * p, uint64_t v)
+{
+    while( v >= 0x80 )
+    {
+        *p++ = uint8_t(v) | 0x80;
+        v >>= 7;
+    }
+    *p++ = uint8_t(v);
+    return p;
+}
+
+static inline bool ReadVarint( const uint8_t ** p, const uint8_t * end, uint64_t * result)
+{
+    uint64_t v = 0;
+    for( int shift = 0; shift < 64; shift += 7)
+    {
+        if( *p >= end )
+            return false;
+        uint8_t byte = *(*p)++;
+        v |= uint64_t(byte & 0x7f) << shift;
+        if( 0 == (byte & 0x80) )
+        {
+            *result = v;
+            return true;
+        }
+    }
+    return false;
+}
+
+/*! @abstract Write the token for values[i], or for the run of zeros starting there. Sets *run to the rest of that run. */
+static inline uint8_t * WriteToken( uint8_t * p, const int64_t * values, size_t i, size_t count, uint64_t * run)
+{
+    if( values[i] )
+        return WriteVarint( p, ZigZag(values[i]) << 1);
+
+    size_t n = 1;
+    while( i + n < count && 0 == values[i + n] )
+        n++;
+    *run = n - 1;
+    return WriteVarint( p, (uint64_t(n) << 1) | 1);
+}
+
+static inline bool ReadToken( const uint8_t ** p, const uint8_t * end, uint64_t * run, int64_t * result)
+{
+    if( *run )
+    {
+        --*run;
+        *result = 0;
+        return true;
+    }
+
+    uint64_t token;
+    if( ! ReadVarint( p, end, &token) )
+        return false;
+
+    if( token & 1 )
+    {
+        if( token < 2 )         // a run of no zeros
+            return false;
+        *run = (token >> 1) - 1;
+        *result = 0;
+    }
+    else
+        *result = UnZigZag( token >> 1);
+    return true;
+}
+
+static inline uint32_t FloatBits( float f){ union{ float f; uint32_t u; }u = {f}; return u.u; }
+static inline float BitsFloat( uint32_t u){ union{ uint32_t u; float f; }f = {u}; return f.f; }
+
+/*! @abstract 2**-kResidualBits float ulps of the float with bits r: the unit residuals are counted in */
+static inline double ResidualUnit( uint32_t r)
+{
+    uint64_t exponent = (r >> 23) & 0xff;
+    if( 0 == exponent )
+        exponent = 1;           // subnormals have the same ulp as FLT_MIN
+    union{ uint64_t u; double d; }unit = { (exponent - 127 - 23 - kResidualBits + 1023) << 52 };
+    return unit.d;
+}
+
+/*! @abstract Compress the answers for one chunk.
+ *  @return the end of the encoded data */
+static uint8_t * EncodeChunk( uint8_t * p, ReferenceKind kind, const double * answers, int64_t * deltas, int64_t * residuals)
+{
+    uint32_t previous[2] = { 0, 0 };
+    for( size_t i = 0; i < kReferenceChunkSize; i++)
+    {
+        float r = (float) answers[i];
+        uint32_t bits = FloatBits(r);
+        deltas[i] = int32_t( bits - (2 * previous[0] - previous[1]));
+        previous[1] = previous[0];
+        previous[0] = bits;
+
+        // answer - r is exact, because r is the nearest float to answer
+        residuals[i] = 0;
+        if( kReferenceDouble == kind && isfinite(r) && answers[i] != (double) r )
+        {
+            double q = (answers[i] - (double) r) / ResidualUnit(bits);
+            residuals[i] = (int64_t)( q > 0 ? ceil(q) : floor(q));
+        }
+    }
+
+    uint64_t deltaRun = 0, residualRun = 0;
+    for( size_t i = 0; i < kReferenceChunkSize; i++)
+    {
+        if( deltaRun )
+            deltaRun--;
+        else
+            p = WriteToken( p, deltas, i, kReferenceChunkSize, &deltaRun);
+
+        if( kReferenceDouble != kind )
+            continue;
+
+        if( residualRun )
+            residualRun--;
+        else
+            p = WriteToken( p, residuals, i, kReferenceChunkSize, &residualRun);
+    }
+
+    return p;
+}
+
+
+#pragma mark - Writing
+
+// Chunks are made in parallel batches, and written out in order between batches
+static constexpr size_t kBatchChunks = 64;
+
+template <typename Function>
+struct EncodeBatch
+{
+    Function        referenceF;
+    ReferenceKind   kind;
+    uint64_t        firstChunk;         // first chunk of this batch
+    uint8_t *       buffers[kBatchChunks];
+    size_t          sizes[kBatchChunks];
+
+    static void Work( void * context, size_t i)
+    {
+        EncodeBatch * batch = (EncodeBatch *) context;
+        double * answers = (double *) malloc( kReferenceChunkSize * sizeof(answers[0]));
+        int64_t * deltas = (int64_t *) malloc( kReferenceChunkSize * sizeof(deltas[0]));
+        int64_t * residuals = (int64_t *) malloc( kReferenceChunkSize * sizeof(residuals[0]));
+
+        uint64_t start = (batch->firstChunk + i) * kReferenceChunkSize;
+        for( uint64_t j = 0; j < kReferenceChunkSize; j++)
+            answers[j] = (double) batch->referenceF( BitsFloat( uint32_t(start + j)));
+
+        uint8_t * end = EncodeChunk( batch->buffers[i], batch->kind, answers, deltas, residuals);
+        batch->sizes[i] = size_t(end - batch->buffers[i]);
+
+        free(residuals);
+        free(deltas);
+        free(answers);
+    }
+};
+
+template <typename Function>
+static int WriteTable( const char * path, const char * name, ReferenceKind kind, Function referenceF, uint64_t start, uint64_t stop)
+{
+    uint64_t firstChunk = start / kReferenceChunkSize;
+    uint64_t endChunk = (stop + kReferenceChunkSize - 1) / kReferenceChunkSize;
+    if( stop > (1ULL << 32) || firstChunk >= endChunk || strlen(name) >= sizeof(ReferenceFileHeader::name) )
+    {
+        fprintf( stderr, "WriteReferenceTable: bad arguments for %s\n", path);
+        return -1;
+    }
+
+    char tempPath[1024];
+    snprintf( tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE * f = fopen( tempPath, "wb");
+    if( NULL == f )
+    {
+        perror( tempPath);
+        return -1;
+    }
+
+    ReferenceFileHeader header = {};
+    memcpy( header.magic, kReferenceMagic, sizeof(header.magic));
+    header.version = kReferenceVersion;
+    header.kind = kind;
+    strncpy( header.name, name, sizeof(header.name) - 1);
+    header.chunkSize = kReferenceChunkSize;
+    header.firstChunk = firstChunk;
+    header.chunkCount = endChunk - firstChunk;
+
+    // The index isn't known until the chunks are written. Leave room for it and fill it in at the end.
+    size_t indexSize = size_t(header.chunkCount + 1) * sizeof(uint64_t);
+    uint64_t * offsets = (uint64_t *) calloc( header.chunkCount + 1, sizeof(offsets[0]));
+    EncodeBatch<Function> * batch = (EncodeBatch<Function> *) calloc( 1, sizeof(*batch));
+    uint8_t * buffers = (uint8_t *) malloc( kBatchChunks * kReferenceChunkSize * kMaxBytesPerInput);
+    int result = -1;
+    if( offsets && batch && buffers && 1 == fwrite( &header, sizeof(header), 1, f) && 1 == fwrite( offsets, indexSize, 1, f) )
+    {
+        result = 0;
+        batch->referenceF = referenceF;
+        batch->kind = kind;
+        for( size_t i = 0; i < kBatchChunks; i++)
+            batch->buffers[i] = buffers + i * kReferenceChunkSize * kMaxBytesPerInput;
+    }
+
+    uint64_t offset = sizeof(header) + indexSize;
+    for( uint64_t chunk = 0; chunk < header.chunkCount && 0 == result; chunk += kBatchChunks)
+    {
+        size_t count = size_t( header.chunkCount - chunk < kBatchChunks ? header.chunkCount - chunk : kBatchChunks);
+        batch->firstChunk = firstChunk + chunk;
+        ParallelFor( 0, count, 1, [batch]( size_t i){ EncodeBatch<Function>::Work( batch, i); });
+
+        for( size_t i = 0; i < count && 0 == result; i++)
+        {
+            offsets[chunk + i] = offset;
+            offset += batch->sizes[i];
+            if( 1 != fwrite( batch->buffers[i], batch->sizes[i], 1, f) )
+                result = -1;
+        }
+    }
+
+    if( 0 == result )
+    {
+        offsets[header.chunkCount] = offset;
+        if( 0 != fseeko( f, sizeof(header), SEEK_SET) || 1 != fwrite( offsets, indexSize, 1, f) )
+            result = -1;
+    }
+
+    if( 0 != fclose(f) )
+        result = -1;
+    if( 0 == result && 0 != rename( tempPath, path) )
+        result = -1;
+    if( result )
+    {
+        perror( path);
+        unlink( tempPath);
+    }
+
+    free(buffers);
+    free(batch);
+    free(offsets);
+    return result;
+}
+
+int WriteReferenceTable( const char * path, const char * name, float (*referenceF)(float), uint64_t start, uint64_t stop)
+{
+    return WriteTable( path, name, kReferenceFloat, referenceF, start, stop);
+}
+
+int WriteReferenceTable( const char * path, const char * name, double (*referenceF)(double), uint64_t start, uint64_t stop)
+{
+    return WriteTable( path, name, kReferenceDouble, referenceF, start, stop);
+}
+
+
+#pragma mark - Reading
+
+ReferenceTable * OpenReferenceTable( const char * path)
+{
+    int fd = open( path, O_RDONLY);
+    if( fd < 0 )
+        return NULL;
+
+    struct stat info;
+    void * data = MAP_FAILED;
+    if( 0 == fstat( fd, &info) && (size_t) info.st_size >= sizeof(ReferenceFileHeader) )
+        data = mmap( NULL, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);          // the mapping keeps the file open
+    if( MAP_FAILED == data )
+        return NULL;
+
+    // Make sure this is a table, and that the index stays inside the file, so readers don't have to check
+    size_t size = (size_t) info.st_size;
+    const ReferenceFileHeader * header = (const ReferenceFileHeader *) data;
+    const uint64_t * offsets = (const uint64_t *)(header + 1);
+    bool valid = 0 == memcmp( header->magic, kReferenceMagic, sizeof(header->magic)) &&
+                 kReferenceVersion == header->version &&
+                 (kReferenceFloat == header->kind || kReferenceDouble == header->kind) &&
+                 kReferenceChunkSize == header->chunkSize &&
+                 header->chunkCount > 0 && header->chunkCount <= (1ULL << 32) / kReferenceChunkSize &&
+                 header->firstChunk + header->chunkCount <= (1ULL << 32) / kReferenceChunkSize &&
+                 sizeof(*header) + (header->chunkCount + 1) * sizeof(uint64_t) <= size;
+    for( uint64_t i = 0; valid && i <= header->chunkCount; i++)
+        valid = offsets[i] <= size && (0 == i ? offsets[i] >= sizeof(*header) + (header->chunkCount + 1) * sizeof(uint64_t)
+                                              : offsets[i] >= offsets[i-1]);
+
+    ReferenceTable * table = valid ? (ReferenceTable *) calloc( 1, sizeof(*table)) : NULL;
+    if( NULL == table )
+    {
+        munmap( data, size);
+        return NULL;
+    }
+
+    // Tests read the table from front to back
+    madvise( data, size, MADV_SEQUENTIAL);
+
+    table->data = (const uint8_t *) data;
+    table->size = size;
+    table->offsets = offsets;
+    table->kind = (ReferenceKind) header->kind;
+    table->firstChunk = header->firstChunk;
+    table->chunkCount = header->chunkCount;
+    memcpy( table->name, header->name, sizeof(table->name));
+    table->name[ sizeof(table->name) - 1] = '\0';
+    return table;
+}
+
+void CloseReferenceTable( ReferenceTable * table)
+{
+    if( NULL == table )
+        return;
+    munmap( (void *) table->data, table->size);
+    free(table);
+}
+
+const char * ReferenceTableName( const ReferenceTable * table){ return table->name; }
+ReferenceKind ReferenceTableKind( const ReferenceTable * table){ return table->kind; }
+
+bool ReferenceTableCovers( const ReferenceTable * table, uint64_t start, uint64_t stop)
+{
+    return start >= table->firstChunk * kReferenceChunkSize && stop <= (table->firstChunk + table->chunkCount) * kReferenceChunkSize;
+}
+
+/*! @abstract Point the cursor at the beginning of the chunk holding cursor->position */
+static void BeginChunk( ReferenceCursor * cursor)
+{
+    const ReferenceTable * table = cursor->table;
+    uint64_t chunk = cursor->position / kReferenceChunkSize - table->firstChunk;
+    cursor->next = table->data + table->offsets[chunk];
+    cursor->end = table->data + table->offsets[chunk + 1];
+    cursor->previous[0] = cursor->previous[1] = 0;
+    cursor->deltaRun = cursor->residualRun = 0;
+}
+
+static inline bool ReadOne( ReferenceCursor * cursor, double * result)
+{
+    if( 0 == cursor->position % kReferenceChunkSize )
+        BeginChunk(cursor);
+
+    int64_t delta, residual = 0;
+    if( ! ReadToken( &cursor->next, cursor->end, &cursor->deltaRun, &delta) )
+        return false;
+    if( kReferenceDouble == cursor->table->kind && ! ReadToken( &cursor->next, cursor->end, &cursor->residualRun, &residual) )
+        return false;
+
+    uint32_t bits = 2 * cursor->previous[0] - cursor->previous[1] + uint32_t(delta);
+    cursor->previous[1] = cursor->previous[0];
+    cursor->previous[0] = bits;
+    cursor->position++;
+
+    *result = (double) BitsFloat(bits);
+    if( residual )
+        *result += (double) residual * ResidualUnit(bits);
+    return true;
+}
+
+ReferenceCursor OpenReferenceCursor( const ReferenceTable * table, uint64_t start)
+{
+    ReferenceCursor cursor = {};
+    cursor.table = table;
+    cursor.position = start - start % kReferenceChunkSize;
+    cursor.end = cursor.next = table->data;
+    if( ! ReferenceTableCovers( table, start, start + 1) )
+    {
+        cursor.position = start;        // ReadReferences will fail
+        return cursor;
+    }
+
+    // Decode our way to start from the beginning of its chunk
+    double ignored;
+    while( cursor.position < start && ReadOne( &cursor, &ignored) )
+    {}
+    return cursor;
+}
+
+bool ReadReferences( ReferenceCursor * cursor, double * result, size_t count)
+{
+    if( ! ReferenceTableCovers( cursor->table, cursor->position, cursor->position + count) )
+        return false;
+
+    for( size_t i = 0; i < count; i++)
+        if( ! ReadOne( cursor, result + i) )
+            return false;
+    return true;
+}
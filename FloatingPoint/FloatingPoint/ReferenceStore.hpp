@@ -0,0 +1,84 @@
+//
+//  ReferenceStore.hpp
+//  FloatingPoint
+//
+//  Precomputed correct answers for the exhaustive tests, so a test run only has to evaluate the
+//  function being tested. A table is made once per reference function with WriteReferenceTable
+//  and memory mapped by OpenReferenceTable. Results are then streamed out in input order through
+//  a ReferenceCursor.
+//
+//  The inputs are cut into chunks of kReferenceChunkSize consecutive encodings. Each chunk is
+//  compressed on its own, and the file has an index of where each chunk starts, so you can begin
+//  reading at any input without decoding everything before it.
+//
+//  Compression works because neighboring encodings usually have neighboring answers:
+//      -   each answer is stored as its nearest float, R. We store the second difference of the
+//          bits of R, which is 0 whenever the answer bits follow a straight line: along a flat step
+//          of floor(), across a run of NaNs, or inside a binade of a smooth function like log2().
+//      -   for double precision references, the distance from R to the real answer is stored in
+//          units of 2**-19 float ulps. It is rounded away from zero, so it is 0 only when the answer
+//          is exactly a float. That is fine enough that an error is very rarely moved across a tolerance.
+//      -   both of those are zigzag encoded varints, with runs of zeros stored as a single count.
+//
+//  Answers beyond the float range are stored as their float rounding, i.e. +-infinity.
+//
+
+#ifndef REFERENCE_STORE_HPP
+#define REFERENCE_STORE_HPP     1
+
+#include <stddef.h>
+#include <stdint.h>
+
+static constexpr uint64_t kReferenceChunkSize = 1ULL << 16;
+
+/*! @abstract The precision of the reference function that made a table */
+typedef enum ReferenceKind
+{
+    kReferenceFloat = 1,            // float reference, e.g. floorf. Stored exactly.
+    kReferenceDouble = 2,           // double reference, e.g. log2. Stored to 2**-19 float ulps.
+}ReferenceKind;
+
+/*! @abstract A memory mapped reference table. Opaque. */
+typedef struct ReferenceTable ReferenceTable;
+
+/*! @abstract Sequential reader for a reference table. Each worker thread should have its own. */
+typedef struct ReferenceCursor
+{
+    const ReferenceTable *  table;
+    const uint8_t *         next;           // next byte of compressed data
+    const uint8_t *         end;            // end of the current chunk
+    uint64_t                position;       // the input encoding the next result is for
+    uint32_t                previous[2];    // bits of the last two R values, to predict the next
+    uint64_t                deltaRun;       // zero deltas left in the current run
+    uint64_t                residualRun;    // zero residuals left in the current run
+}ReferenceCursor;
+
+/*! @abstract Evaluate referenceF for the float encodings [start, stop) and save the answers at path.
+ *  @discussion start and stop are rounded out to multiples of kReferenceChunkSize. The work is spread across
+ *              all cores. The table is written to a temporary file first, and then renamed to path, so a
+ *              table at path is always complete.
+ *  @return 0 on success, -1 on error, with a message printed to stderr. */
+int WriteReferenceTable( const char * path, const char * name, float (*referenceF)(float), uint64_t start = 0, uint64_t stop = 1ULL << 32);
+int WriteReferenceTable( const char * path, const char * name, double (*referenceF)(double), uint64_t start = 0, uint64_t stop = 1ULL << 32);
+
+/*! @abstract Map a table made by WriteReferenceTable.
+ *  @return NULL if the file can't be opened or is not a valid table. */
+ReferenceTable * OpenReferenceTable( const char * path);
+void CloseReferenceTable( ReferenceTable * table);
+
+/*! @abstract The name the table was written with, e.g. "log2" */
+const char * ReferenceTableName( const ReferenceTable * table);
+ReferenceKind ReferenceTableKind( const ReferenceTable * table);
+
+/*! @abstract true if the table has answers for every input in [start, stop) */
+bool ReferenceTableCovers( const ReferenceTable * table, uint64_t start, uint64_t stop);
+
+/*! @abstract Get a cursor that reads answers starting at input encoding start. The table must cover start. */
+ReferenceCursor OpenReferenceCursor( const ReferenceTable * table, uint64_t start);
+
+/*! @abstract Read the answers for the next count inputs, advancing the cursor.
+ *  @discussion Float tables give back the exact float answer, converted to double.
+ *  @return false if the table ran out, or the data is corrupt. */
+bool ReadReferences( ReferenceCursor * cursor, double * result, size_t count);
+
+#endif /* REFERENCE_STORE_HPP */
@@ -0,0 +1,566 @@
+//
+//  Report.cpp
+//  FloatingPoint
+//
+//  Reports are written with fprintf, a field at a time, and read back with a small JSON parser into a tree
+//  of JsonValues. The parser takes any JSON, so a report that has been through another tool (jq, a pretty
+//  printer, a script that trims it) still reads, as long as the fields we need are there.
+//
+//  JSON has no infinity or NaN, so non-finite numbers are written as the strings "inf", "-inf" and "nan".
+//  The worst case inputs are also written as their bits, which is what is read back, so nothing is lost.
+//
+
+#include "Report.hpp"
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+static constexpr const char *   kReportFormat = "FloatingPoint report";
+static constexpr int            kReportVersion = 1;
+
+static inline uint32_t FloatBits( float f){ union{ float f; uint32_t u; }u = {f}; return u.u; }
+static inline float BitsFloat( uint32_t u){ union{ uint32_t u; float f; }f = {u}; return f.f; }
+
+/*! @abstract The unbiased exponent of a binade, with -127 for zeros and subnormals and 128 for infinities and NaNs */
+static inline int BinadeExponent( int binade){ return (binade & 0xff) - 127; }
+static inline bool BinadeIsNegative( int binade){ return binade >> 8; }
+
+static uint64_t CountResults( const UlpReport & report)
+{
+    uint64_t count = 0;
+    for( int i = 0; i < UlpReport::kHistogramBins; i++)
+        count += report.histogram[i];
+    return count;
+}
+
+#pragma mark - Writing
+
+/*! @abstract Write a double so it reads back exactly, or as a string if JSON can't hold it */
+static void WriteNumber( FILE * f, double x)
+{
+    if( isnan(x) )
+        fprintf( f, "\"nan\"");
+    else if( isinf(x) )
+        fprintf( f, x < 0 ? "\"-inf\"" : "\"inf\"");
+    else
+        fprintf( f, "%.17g", x);
+}
+
+/*! @abstract The fields UlpReport has, for the whole function or for one binade */
+static void WriteUlpReport( FILE * f, const UlpReport & report, const char * indent)
+{
+    uint64_t results = CountResults( report);
+    fprintf( f, "%s\"results\": %llu,\n", indent, (unsigned long long) results);
+    fprintf( f, "%s\"non_exact\": %llu,\n", indent, (unsigned long long)(results - report.histogram[0]));
+    fprintf( f, "%s\"failures\": %llu,\n", indent, (unsigned long long) report.failures);
+    fprintf( f, "%s\"worst_error\": ", indent);
+    WriteNumber( f, report.worstError);
+    fprintf( f, ",\n%s\"worst_case\": ", indent);
+    WriteNumber( f, report.worstCase);
+    fprintf( f, ",\n%s\"worst_case_bits\": \"0x%08x\",\n", indent, FloatBits( report.worstCase));
+    fprintf( f, "%s\"histogram\": { \"bins_per_ulp\": %d, \"counts\": [", indent, UlpReport::kBinsPerUlp);
+    for( int i = 0; i < UlpReport::kHistogramBins; i++)
+        fprintf( f, "%s%llu", i ? ", " : " ", (unsigned long long) report.histogram[i]);
+    fprintf( f, " ] }");
+}
+
+static void WriteBenchmark( FILE * f, const char * name, const Benchmark & benchmark)
+{
+    fprintf( f, "\"%s\": { \"mean\": ", name);
+    WriteNumber( f, benchmark.meanTime);
+    fprintf( f, ", \"std_error\": ");
+    WriteNumber( f, benchmark.stdErrorOfTheMean);
+    fprintf( f, ", \"samples\": %.0f }", benchmark.N);
+}
+
+int WriteReport( const char * path, const FunctionReport * reports, size_t count)
+{
+    char tempPath[1024];
+    snprintf( tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE * f = fopen( tempPath, "w");
+    if( NULL == f )
+    {
+        perror( tempPath);
+        return -1;
+    }
+
+    fprintf( f, "{\n  \"format\": \"%s\",\n  \"version\": %d,\n  \"clock_units\": \"%s\",\n  \"functions\": [",
+             kReportFormat, kReportVersion, CycleClock::kUnits);
+    for( size_t i = 0; i < count; i++)
+    {
+        const FunctionReport & report = reports[i];
+        fprintf( f, "%s\n    {\n", i ? "," : "");
+        fprintf( f, "      \"name\": \"%s\",\n", report.name);           // our own names: nothing to escape
+        fprintf( f, "      \"range_start\": %llu,\n", (unsigned long long) report.rangeStart);
+        fprintf( f, "      \"range_stop\": %llu,\n", (unsigned long long) report.rangeStop);
+        fprintf( f, "      \"tolerance\": ");
+        WriteNumber( f, report.tolerance);
+        fprintf( f, ",\n      \"exact\": %s,\n", report.exact ? "true" : "false");
+        WriteUlpReport( f, report.total, "      ");
+
+        fprintf( f, ",\n      \"binades\": [");
+        bool first = true;
+        for( int b = 0; b < kBinadeCount; b++)
+        {
+            if( 0 == CountResults( report.binades[b]) )
+                continue;
+            fprintf( f, "%s\n        {\n          \"sign\": \"%c\",\n          \"exponent\": %d,\n", first ? "" : ",",
+                     BinadeIsNegative(b) ? '-' : '+', BinadeExponent(b));
+            WriteUlpReport( f, report.binades[b], "          ");
+            fprintf( f, "\n        }");
+            first = false;
+        }
+        fprintf( f, "\n      ],\n      ");
+        WriteBenchmark( f, "latency", report.latency);
+        fprintf( f, ",\n      ");
+        WriteBenchmark( f, "throughput", report.throughput);
+        fprintf( f, "\n    }");
+    }
+    fprintf( f, "\n  ]\n}\n");
+
+    int result = 0;
+    if( ferror(f) )
+        result = -1;
+    if( 0 != fclose(f) )
+        result = -1;
+    if( 0 == result && 0 != rename( tempPath, path) )
+        result = -1;
+    if( result )
+    {
+        perror( path);
+        unlink( tempPath);
+    }
+    return result;
+}
+
+#pragma mark - Reading
+
+/*! @abstract A parsed JSON value. Objects keep their keys in order, in keys, with the values at the same index in elements. */
+typedef struct JsonValue
+{
+    enum Type{ kNull, kBool, kNumber, kString, kArray, kObject };
+
+    Type                        type = kNull;
+    double                      number = 0;         // also 0 or 1 for bools
+    std::string                 string;
+    std::vector<std::string>    keys;
+    std::vector<JsonValue>      elements;
+
+    /*! @abstract The member called key, or NULL if this isn't an object or it has no such member */
+    const JsonValue * Find( const char * key) const
+    {
+        if( kObject == type )
+            for( size_t i = 0; i < keys.size(); i++)
+                if( keys[i] == key )
+                    return &elements[i];
+        return NULL;
+    }
+}JsonValue;
+
+/*! @abstract Recursive descent over a NUL terminated buffer, https://www.json.org/ */
+typedef struct JsonParser
+{
+    static constexpr int kMaxDepth = 64;
+
+    const char *    p;
+
+    inline void SkipSpace(){ while( ' ' == *p || '\t' == *p || '\n' == *p || '\r' == *p ) p++; }
+    inline bool Literal( const char * word){ size_t n = strlen(word); if( strncmp( p, word, n) ) return false; p += n; return true; }
+
+    bool ParseString( std::string * s)
+    {
+        if( '"' != *p++ )
+            return false;
+        s->clear();
+        for(;;)
+        {
+            char c = *p++;
+            if( '"' == c )
+                return true;
+            if( '\0' == c || (unsigned char) c < 0x20 )
+                return false;
+            if( '\\' != c )
+            {
+                s->push_back(c);
+                continue;
+            }
+
+            switch( c = *p++ )
+            {
+                case '"': case '\\': case '/':  s->push_back(c);      break;
+                case 'b':                       s->push_back('\b');   break;
+                case 'f':                       s->push_back('\f');   break;
+                case 'n':                       s->push_back('\n');   break;
+                case 'r':                       s->push_back('\r');   break;
+                case 't':                       s->push_back('\t');   break;
+                case 'u':
+                {
+                    // Our reports are ASCII. Anything else only needs to survive as a placeholder.
+                    char digits[5] = {};
+                    for( int i = 0; i < 4; i++)
+                        if( ! isxdigit( (unsigned char)(digits[i] = *p++)) )
+                            return false;
+                    unsigned long code = strtoul( digits, NULL, 16);
+                    s->push_back( code < 0x80 ? (char) code : '?');
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+    }
+
+    bool ParseValue( JsonValue * value, int depth)
+    {
+        if( depth > kMaxDepth )
+            return false;
+
+        SkipSpace();
+        switch( *p )
+        {
+            case '{':
+            {
+                value->type = JsonValue::kObject;
+                p++;
+                SkipSpace();
+                if( '}' == *p )
+                {
+                    p++;
+                    return true;
+                }
+                for(;;)
+                {
+                    SkipSpace();
+                    value->keys.emplace_back();
+                    value->elements.emplace_back();
+                    if( ! ParseString( &value->keys.back()) )
+                        return false;
+                    SkipSpace();
+                    if( ':' != *p++ || ! ParseValue( &value->elements.back(), depth + 1) )
+                        return false;
+                    SkipSpace();
+                    char c = *p++;
+                    if( '}' == c )
+                        return true;
+                    if( ',' != c )
+                        return false;
+                }
+            }
+
+            case '[':
+            {
+                value->type = JsonValue::kArray;
+                p++;
+                SkipSpace();
+                if( ']' == *p )
+                {
+                    p++;
+                    return true;
+                }
+                for(;;)
+                {
+                    value->elements.emplace_back();
+                    if( ! ParseValue( &value->elements.back(), depth + 1) )
+                        return false;
+                    SkipSpace();
+                    char c = *p++;
+                    if( ']' == c )
+                        return true;
+                    if( ',' != c )
+                        return false;
+                }
+            }
+
+            case '"':
+                value->type = JsonValue::kString;
+                return ParseString( &value->string);
+
+            case 't':
+                value->type = JsonValue::kBool;
+                value->number = 1;
+                return Literal( "true");
+
+            case 'f':
+                value->type = JsonValue::kBool;
+                return Literal( "false");
+
+            case 'n':
+                return Literal( "null");
+
+            default:
+            {
+                // strtod takes more than JSON allows (hex, inf, leading +), which is harmless here
+                char * end;
+                value->type = JsonValue::kNumber;
+                value->number = strtod( p, &end);
+                if( end == p || ! ('-' == *p || isdigit( (unsigned char) *p)) )
+                    return false;
+                p = end;
+                return true;
+            }
+        }
+    }
+}JsonParser;
+
+/*! @abstract A number member, which may also be "inf", "-inf" or "nan" */
+static bool GetNumber( const JsonValue & object, const char * key, double * result)
+{
+    const JsonValue * v = object.Find( key);
+    if( NULL == v )
+        return false;
+    if( JsonValue::kNumber == v->type )
+        *result = v->number;
+    else if( JsonValue::kString == v->type && (v->string == "inf" || v->string == "-inf" || v->string == "nan") )
+        *result = v->string == "nan" ? NAN : v->string == "inf" ? INFINITY : -INFINITY;
+    else
+        return false;
+    return true;
+}
+
+static bool GetCount( const JsonValue & object, const char * key, uint64_t * result)
+{
+    double x;
+    if( ! GetNumber( object, key, &x) || ! (x >= 0 && x <= 0x1.0p64) )
+        return false;
+    *result = (uint64_t) x;
+    return true;
+}
+
+static bool GetBenchmark( const JsonValue & object, const char * key, Benchmark * result)
+{
+    const JsonValue * v = object.Find( key);
+    memset( result, 0, sizeof(*result));
+    return v && GetNumber( *v, "mean", &result->meanTime) && GetNumber( *v, "std_error", &result->stdErrorOfTheMean) &&
+           GetNumber( *v, "samples", &result->N);
+}
+
+static bool GetUlpReport( const JsonValue & object, UlpReport * report)
+{
+    memset( report, 0, sizeof(*report));
+    const JsonValue * bits = object.Find( "worst_case_bits");
+    const JsonValue * histogram = object.Find( "histogram");
+    const JsonValue * counts = histogram ? histogram->Find( "counts") : NULL;
+    double binsPerUlp;
+    if( NULL == bits || JsonValue::kString != bits->type || NULL == counts || JsonValue::kArray != counts->type ||
+        ! GetNumber( *histogram, "bins_per_ulp", &binsPerUlp) || UlpReport::kBinsPerUlp != binsPerUlp ||
+        (size_t) UlpReport::kHistogramBins != counts->elements.size() ||
+        ! GetCount( object, "failures", &report->failures) || ! GetNumber( object, "worst_error", &report->worstError) )
+        return false;
+
+    report->worstCase = BitsFloat( (uint32_t) strtoul( bits->string.c_str(), NULL, 16));
+    for( int i = 0; i < UlpReport::kHistogramBins; i++)
+    {
+        const JsonValue & count = counts->elements[i];
+        if( JsonValue::kNumber != count.type || count.number < 0 )
+            return false;
+        report->histogram[i] = (uint64_t) count.number;
+    }
+    return true;
+}
+
+static bool GetFunctionReport( const JsonValue & object, FunctionReport * report)
+{
+    memset( report, 0, sizeof(*report));
+    const JsonValue * name = object.Find( "name");
+    const JsonValue * exact = object.Find( "exact");
+    const JsonValue * binades = object.Find( "binades");
+    double tolerance;
+    if( NULL == name || JsonValue::kString != name->type || name->string.size() >= sizeof(report->name) ||
+        NULL == exact || JsonValue::kBool != exact->type || NULL == binades || JsonValue::kArray != binades->type ||
+        ! GetCount( object, "range_start", &report->rangeStart) || ! GetCount( object, "range_stop", &report->rangeStop) ||
+        ! GetNumber( object, "tolerance", &tolerance) || ! GetUlpReport( object, &report->total) ||
+        ! GetBenchmark( object, "latency", &report->latency) || ! GetBenchmark( object, "throughput", &report->throughput) )
+        return false;
+
+    strcpy( report->name, name->string.c_str());
+    report->tolerance = (float) tolerance;
+    report->exact = exact->number != 0;
+    for( int b = 0; b < kBinadeCount; b++)
+        report->binades[b].worstCase = NAN;
+
+    for( const JsonValue & binade : binades->elements )
+    {
+        const JsonValue * sign = binade.Find( "sign");
+        double exponent;
+        if( NULL == sign || JsonValue::kString != sign->type || (sign->string != "+" && sign->string != "-") ||
+            ! GetNumber( binade, "exponent", &exponent) || ! (exponent >= -127 && exponent <= 128) )
+            return false;
+
+        int b = (sign->string == "-") << 8 | (int(exponent) + 127);
+        if( ! GetUlpReport( binade, &report->binades[b]) )
+            return false;
+    }
+    return true;
+}
+
+int ReadReport( const char * path, FunctionReport ** reports, size_t * count)
+{
+    *reports = NULL;
+    *count = 0;
+
+    FILE * f = fopen( path, "r");
+    if( NULL == f )
+    {
+        perror( path);
+        return -1;
+    }
+
+    std::string text;
+    char buffer[4096];
+    size_t n;
+    while( (n = fread( buffer, 1, sizeof(buffer), f)) )
+        text.append( buffer, n);
+    fclose(f);
+
+    JsonValue root;
+    JsonParser parser = { text.c_str() };
+    bool ok = parser.ParseValue( &root, 0);
+    parser.SkipSpace();
+    if( ! ok || '\0' != *parser.p )
+    {
+        printf( "%s: not JSON, at byte %zu\n", path, size_t( parser.p - text.c_str()));
+        return -1;
+    }
+
+    const JsonValue * format = root.Find( "format");
+    const JsonValue * functions = root.Find( "functions");
+    double version;
+    if( NULL == format || format->string != kReportFormat || ! GetNumber( root, "version", &version) || kReportVersion != version ||
+        NULL == functions || JsonValue::kArray != functions->type )
+    {
+        printf( "%s: not a version %d report\n", path, kReportVersion);
+        return -1;
+    }
+
+    *reports = (FunctionReport *) calloc( functions->elements.size() + 1, sizeof(FunctionReport));
+    if( NULL == *reports )
+    {
+        printf( "Out of memory\n");
+        return -1;
+    }
+    for( const JsonValue & function : functions->elements )
+        if( ! GetFunctionReport( function, &(*reports)[(*count)++]) )
+        {
+            printf( "%s: function %zu is malformed\n", path, *count - 1);
+            free( *reports);
+            *reports = NULL;
+            *count = 0;
+            return -1;
+        }
+
+    return 0;
+}
+
+#pragma mark - Comparing
+
+/*! @abstract Print the ways current is less (or more) accurate than baseline. Returns the number that are worse. */
+static int CompareAccuracy( const char * label, const UlpReport & baseline, const UlpReport & current)
+{
+    int worse = 0;
+    double was = fabs( baseline.worstError), is = fabs( current.worstError);
+    if( is != was )
+    {
+        printf( "\t%s%s worst error %.6g -> %.6g ulps @ %a\n", is > was ? "" : "(better) ", label, was, is, current.worstCase);
+        worse += is > was;
+    }
+
+    if( current.failures != baseline.failures )
+    {
+        printf( "\t%s%s failures %llu -> %llu\n", current.failures > baseline.failures ? "" : "(better) ", label,
+                (unsigned long long) baseline.failures, (unsigned long long) current.failures);
+        worse += current.failures > baseline.failures;
+    }
+
+    // Only comparable when the same inputs were tested
+    uint64_t results = CountResults( current);
+    if( results == CountResults( baseline) && current.histogram[0] != baseline.histogram[0] )
+    {
+        uint64_t wasInexact = results - baseline.histogram[0], isInexact = results - current.histogram[0];
+        printf( "\t%s%s inexact results %llu -> %llu\n", isInexact > wasInexact ? "" : "(better) ", label,
+                (unsigned long long) wasInexact, (unsigned long long) isInexact);
+        worse += isInexact > wasInexact;
+    }
+    return worse;
+}
+
+/*! @abstract Print a significant change in speed. Returns 1 if current is slower. */
+static int CompareSpeed( const char * label, const Benchmark & baseline, const Benchmark & current)
+{
+    double difference = current.meanTime - baseline.meanTime;
+    double standardError = sqrt( baseline.stdErrorOfTheMean * baseline.stdErrorOfTheMean +
+                                 current.stdErrorOfTheMean * current.stdErrorOfTheMean);
+    if( ! (fabs(difference) > kSignificanceLevel * standardError && fabs(difference) > kSignificantSlowdown * baseline.meanTime) )
+        return 0;
+
+    printf( "\t%s%s %.3g -> %.3g %s per element (%+.1f%%, %.1f standard errors)\n", difference > 0 ? "" : "(better) ", label,
+            baseline.meanTime, current.meanTime, CycleClock::kUnits, 100.0 * difference / baseline.meanTime,
+            standardError > 0 ? fabs(difference) / standardError : INFINITY);
+    return difference > 0;
+}
+
+int CompareReports( const char * baselinePath, const char * currentPath)
+{
+    FunctionReport * baseline, * current;
+    size_t baselineCount, currentCount;
+    if( ReadReport( baselinePath, &baseline, &baselineCount) )
+        return -1;
+    if( ReadReport( currentPath, &current, &currentCount) )
+    {
+        free( baseline);
+        return -1;
+    }
+
+    printf( "Comparing %s to baseline %s:\n", currentPath, baselinePath);
+    int regressions = 0;
+    for( size_t i = 0; i < currentCount; i++)
+    {
+        const FunctionReport & is = current[i];
+        const FunctionReport * was = NULL;
+        for( size_t j = 0; j < baselineCount && NULL == was; j++)
+            if( 0 == strcmp( baseline[j].name, is.name) )
+                was = &baseline[j];
+
+        if( NULL == was )
+        {
+            printf( "%s: new, not in the baseline\n", is.name);
+            continue;
+        }
+
+        printf( "%s:\n", is.name);
+        int worse = CompareSpeed( "latency", was->latency, is.latency) + CompareSpeed( "throughput", was->throughput, is.throughput);
+        if( was->rangeStart != is.rangeStart || was->rangeStop != is.rangeStop )
+            printf( "\taccuracy not compared: the baseline tested [0x%llx, 0x%llx)\n",
+                    (unsigned long long) was->rangeStart, (unsigned long long) was->rangeStop);
+        else
+        {
+            worse += CompareAccuracy( "overall", was->total, is.total);
+            for( int b = 0; b < kBinadeCount; b++)
+            {
+                char label[32];
+                snprintf( label, sizeof(label), "binade %c2**%d", BinadeIsNegative(b) ? '-' : '+', BinadeExponent(b));
+                worse += CompareAccuracy( label, was->binades[b], is.binades[b]);
+            }
+        }
+
+        printf( "\t%s\n", worse ? "REGRESSED" : "no regressions");
+        regressions += worse;
+    }
+
+    for( size_t j = 0; j < baselineCount; j++)
+    {
+        bool found = false;
+        for( size_t i = 0; i < currentCount && ! found; i++)
+            found = 0 == strcmp( baseline[j].name, current[i].name);
+        if( ! found )
+            printf( "%s: in the baseline, but not tested this time\n", baseline[j].name);
+    }
+
+    free( baseline);
+    free( current);
+    return regressions ? 1 : 0;
+}
@@ -0,0 +1,93 @@
+//
+//  Report.hpp
+//  FloatingPoint
+//
+//  Machine readable results, so accuracy and speed can be tracked from one release to the next without
+//  scraping what the tests print. A report is a JSON file with an entry for each function tested:
+//
+//      {
+//        "format": "FloatingPoint report",
+//        "version": 1,
+//        "clock_units": "cycles",
+//        "functions": [
+//          {
+//            "name": "log2",
+//            "range_start": 0,
+//            "range_stop": 4294967296,
+//            "tolerance": 0.50001525878906250,
+//            "exact": false,                          only one right answer, as for floor
+//            "results": 4294967296,
+//            "non_exact": 2139095039,
+//            "failures": 0,
+//            "worst_error": -0.50000011920928955,     signed ulps. "inf" for a NaN where a number was expected
+//            "worst_case": 1.5,
+//            "worst_case_bits": "0x3fc00000",
+//            "histogram": { "bins_per_ulp": 8, "counts": [ ... ] },
+//            "binades": [ { "sign": "+", "exponent": -126, "results": ..., "non_exact": ..., "failures": ...,
+//                           "worst_error": ..., "worst_case": ..., "worst_case_bits": ... }, ... ],
+//            "latency": { "mean": 21.3, "std_error": 0.04, "samples": 94 },
+//            "throughput": { "mean": 4.1, "std_error": 0.01, "samples": 101 }
+//          }, ...
+//        ]
+//      }
+//
+//  The histogram is UlpReport's. Binades are taken by the sign and exponent field of the input: exponent is the
+//  unbiased exponent, with -127 standing for zeros and subnormals and 128 for infinities and NaNs. Only binades
+//  with results in them are written. Times are per element, in clock_units.
+//
+//  CompareReports reads two of these and reports what got worse. Accuracy is deterministic, so any growth in the
+//  worst error, the failures or the count of inexact results, overall or in any binade, is a drift. Speed is not:
+//  a time counts as a regression only if it is more than kSignificantSlowdown slower, and the difference is more
+//  than kSignificanceLevel standard errors, so noise between runs doesn't set it off.
+//
+//      https://www.json.org/
+//
+
+#ifndef REPORT_HPP
+#define REPORT_HPP      1
+
+#include "Benchmark.hpp"
+#include "Ulps.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/*! @abstract Binades by sign and exponent field, i.e. the top 9 bits of a float encoding */
+static constexpr int kBinadeCount = 512;
+
+/*! @abstract How many standard errors of the difference a slowdown must be to count */
+static constexpr double kSignificanceLevel = 3.0;
+
+/*! @abstract The smallest slowdown worth reporting, as a fraction of the baseline time */
+static constexpr double kSignificantSlowdown = 0.05;
+
+/*! @abstract Everything a report holds about one function */
+typedef struct FunctionReport
+{
+    char        name[32];
+    uint64_t    rangeStart;                 // the inputs tested were the encodings [rangeStart, rangeStop)
+    uint64_t    rangeStop;
+    float       tolerance;                  // ulps
+    bool        exact;                      // only one right answer: anything not bitwise identical to it fails
+    UlpReport   total;
+    UlpReport   binades[kBinadeCount];      // indexed by the top 9 bits of the input encoding
+    Benchmark   latency;                    // dependent calls, per element
+    Benchmark   throughput;                 // independent calls, per element
+}FunctionReport;
+
+/*! @abstract The binade of a float encoding: its sign and exponent field */
+static inline int BinadeOf( uint64_t encoding){ return int( (encoding >> 23) & (kBinadeCount - 1)); }
+
+/*! @abstract Write reports for count functions to path as JSON, replacing the file atomically.
+ *  @return 0 on success, -1 on error */
+int WriteReport( const char * path, const FunctionReport * reports, size_t count);
+
+/*! @abstract Read a report written by WriteReport. Free *reports when done.
+ *  @return 0 on success, -1 if the file is missing or malformed, with a message printed */
+int ReadReport( const char * path, FunctionReport ** reports, size_t * count);
+
+/*! @abstract Print what got slower or less accurate in current since baseline, and what got better.
+ *            Functions only in one of them are noted, not counted against it.
+ *  @return 0 if nothing regressed, 1 if something did, -1 if either file couldn't be read */
+int CompareReports( const char * baselinePath, const char * currentPath);
+
+#endif /* REPORT_HPP */
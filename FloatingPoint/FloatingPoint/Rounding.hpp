@@ -0,0 +1,109 @@
+//
+//  Rounding.hpp
+//  FloatingPoint
+//
+//  Rounding a float or a double to an integral value, done on the bits of the encoding. No libm, no floating-point
+//  arithmetic and no rounding mode, so it is constexpr, and small enough to inline wherever it is used.
+//  Floor, Round, Rint and Rint<RoundingMode> in Math.hpp are all this one function, and so are FloorD, RoundD and RintD.
+//
+//  Below 2**23 the fraction bits of a float are the low 23 - (unbiased exponent) bits of its encoding.
+//  Clear them to truncate toward zero, then add one unit in the last integral place if the direction says
+//  to round away from zero. A carry out of the mantissa bumps the exponent, which is just what we want:
+//  1.5 rounds up to 2.0 in the next binade. The sign bit is never touched, so -0.25 rounds to -0.
+//  Doubles are the same, with 52 fraction bits rather than 23.
+//
+//      https://en.wikipedia.org/wiki/Single-precision_floating-point_format
+//
+
+#ifndef ROUNDING_HPP
+#define ROUNDING_HPP    1
+
+#include <bit>
+#include <stdint.h>
+
+/*! @abstract The four IEEE-754 rounding directions */
+enum class RoundingMode
+{
+    NearestEven,        // the default: FE_TONEAREST
+    TowardZero,         // FE_TOWARDZERO
+    Up,                 // FE_UPWARD, toward +inf
+    Down                // FE_DOWNWARD, toward -inf
+};
+
+/*! @abstract Where the fields are in the encoding of a float or a double */
+template <typename T> struct EncodingFormat;
+template <> struct EncodingFormat<float>
+{
+    typedef uint32_t    Bits;
+    static constexpr int kMantissaBits = 23;
+    static constexpr int kBias = 127;
+};
+template <> struct EncodingFormat<double>
+{
+    typedef uint64_t    Bits;
+    static constexpr int kMantissaBits = 52;
+    static constexpr int kBias = 1023;
+};
+
+/*! @abstract Round x to an integral value in direction kMode. kTiesAwayFromZero turns NearestEven into round():
+ *            half-way cases go away from zero rather than to even. T is float or double.
+ *  @discussion Integers, +-0 and +-inf are returned unchanged. NaNs are quieted, as the hardware would. */
+template <RoundingMode kMode, bool kTiesAwayFromZero = false, typename T>
+constexpr T RoundToIntegral( T x)
+{
+    static_assert( ! kTiesAwayFromZero || RoundingMode::NearestEven == kMode, "ties only happen when rounding to nearest" );
+
+    typedef EncodingFormat<T> Format;
+    typedef typename Format::Bits Bits;
+    constexpr int kMantissaBits = Format::kMantissaBits;
+    constexpr int kBias = Format::kBias;
+    constexpr Bits kSignBit = Bits(1) << (sizeof(Bits) * 8 - 1);
+    constexpr Bits kMantissaMask = (Bits(1) << kMantissaBits) - 1U;
+    constexpr Bits kExponentMask = (kSignBit - 1U) >> kMantissaBits;
+    constexpr Bits kOne = Bits(kBias) << kMantissaBits;
+
+    Bits u = std::bit_cast<Bits>(x);
+    Bits exponent = (u >> kMantissaBits) & kExponentMask;
+    bool isNegative = u >> (sizeof(Bits) * 8 - 1);
+
+    // 2**23 (2**52 for double) and up are integers already, and so are inf and NaN. Quiet NaN without arithmetic,
+    // which isn't allowed to make a NaN in a constant expression.
+    if( exponent >= Bits(kBias + kMantissaBits) )
+        return kExponentMask == exponent && (u & kMantissaMask) ? std::bit_cast<T>( u | (Bits(1) << (kMantissaBits - 1))) : x;
+
+    // |x| < 1: the answer is zero or one, with the sign of x either way
+    if( exponent < Bits(kBias) )
+    {
+        if( 0 == Bits(u << 1) )
+            return x;
+
+        bool awayFromZero = false;
+        switch( kMode )
+        {
+            case RoundingMode::NearestEven: awayFromZero = Bits(kBias - 1) == exponent && (kTiesAwayFromZero || (u & kMantissaMask));  break;     // [0.5, 1) or (0.5, 1)
+            case RoundingMode::TowardZero:  awayFromZero = false;                                                                   break;
+            case RoundingMode::Up:          awayFromZero = ! isNegative;                                                            break;
+            case RoundingMode::Down:        awayFromZero = isNegative;                                                              break;
+        }
+        return std::bit_cast<T>( Bits( (u & kSignBit) | (awayFromZero ? kOne : 0)));
+    }
+
+    Bits one = Bits(1) << (Bits(kBias + kMantissaBits) - exponent);
+    Bits fraction = u & (one - 1U);
+    if( 0 == fraction )
+        return x;
+
+    Bits truncated = u - fraction;
+    bool awayFromZero = false;
+    switch( kMode )
+    {
+        case RoundingMode::NearestEven: awayFromZero = fraction > one / 2 ||
+                                                       (fraction == one / 2 && (kTiesAwayFromZero || (truncated & one)));  break;
+        case RoundingMode::TowardZero:  awayFromZero = false;                                                            break;
+        case RoundingMode::Up:          awayFromZero = ! isNegative;                                                     break;
+        case RoundingMode::Down:        awayFromZero = isNegative;                                                       break;
+    }
+    return std::bit_cast<T>( awayFromZero ? truncated + one : truncated);
+}
+
+#endif /* ROUNDING_HPP */
@@ -0,0 +1,316 @@
+//
+//  Shards.cpp
+//  FloatingPoint
+//
+//  A shard file looks like this:
+//
+//      function=log2
+//      range=0x3f800000:0x40000000
+//      shard=3/8
+//      start=0x3fd00000
+//      stop=0x3fe00000
+//      next=0x3fe00000
+//      tolerance=0x1.4p-1
+//      failures=0
+//      worst_error=-0x1.7fep-2
+//      worst_case=0x3fd0a2c4
+//      histogram=2 1000 1003 ...
+//
+//  Floating-point values are written as hex floats, and worst_case as the bits of the input, so nothing
+//  is lost on the way through the file.
+//
+
+#include "Shards.hpp"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void InitShard( ShardState * state, const char * function, uint64_t rangeStart, uint64_t rangeStop,
+                uint32_t shard, uint32_t shardCount, float tolerance)
+{
+    memset( state, 0, sizeof(*state));
+    strncpy( state->function, function, sizeof(state->function) - 1);
+    state->rangeStart = rangeStart;
+    state->rangeStop = rangeStop;
+    state->shard = shard;
+    state->shardCount = shardCount;
+
+    uint64_t length = rangeStop - rangeStart;
+    state->start = rangeStart + length * shard / shardCount;
+    state->stop = rangeStart + length * (shard + 1) / shardCount;
+    state->next = state->start;
+    state->tolerance = tolerance;
+    state->report.worstCase = NAN;
+}
+
+void ShardPath( char * path, size_t size, const char * directory, const ShardState * state)
+{
+    snprintf( path, size, "%s/%s.%08llx-%08llx.%uof%u.shard", directory, state->function,
+              (unsigned long long) state->rangeStart, (unsigned long long) state->rangeStop, state->shard, state->shardCount);
+}
+
+static inline uint32_t FloatBits( float f){ union{ float f; uint32_t u; }u = {f}; return u.u; }
+static inline float BitsFloat( uint32_t u){ union{ uint32_t u; float f; }f = {u}; return f.f; }
+
+int WriteShard( const char * path, const ShardState * state)
+{
+    char tempPath[1024];
+    snprintf( tempPath, sizeof(tempPath), "%s.tmp", path);
+    FILE * f = fopen( tempPath, "w");
+    if( NULL == f )
+    {
+        perror( tempPath);
+        return -1;
+    }
+
+    const UlpReport & report = state->report;
+    fprintf( f, "function=%s\n", state->function);
+    fprintf( f, "range=0x%llx:0x%llx\n", (unsigned long long) state->rangeStart, (unsigned long long) state->rangeStop);
+    fprintf( f, "shard=%u/%u\n", state->shard, state->shardCount);
+    fprintf( f, "start=0x%llx\n", (unsigned long long) state->start);
+    fprintf( f, "stop=0x%llx\n", (unsigned long long) state->stop);
+    fprintf( f, "next=0x%llx\n", (unsigned long long) state->next);
+    fprintf( f, "tolerance=%a\n", (double) state->tolerance);
+    fprintf( f, "failures=%llu\n", (unsigned long long) report.failures);
+    fprintf( f, "worst_error=%a\n", report.worstError);
+    fprintf( f, "worst_case=0x%08x\n", FloatBits(report.worstCase));
+    fprintf( f, "histogram=");
+    for( int i = 0; i < UlpReport::kHistogramBins; i++)
+        fprintf( f, "%s%llu", i ? " " : "", (unsigned long long) report.histogram[i]);
+    fprintf( f, "\n");
+
+    // Make sure the data is on disk before it replaces the last checkpoint
+    int result = 0;
+    if( 0 != fflush(f) || 0 != fsync( fileno(f)) )
+        result = -1;
+    if( 0 != fclose(f) )
+        result = -1;
+    if( 0 == result && 0 != rename( tempPath, path) )
+        result = -1;
+    if( result )
+    {
+        perror( path);
+        unlink( tempPath);
+    }
+    return result;
+}
+
+int ReadShard( const char * path, ShardState * state)
+{
+    FILE * f = fopen( path, "r");
+    if( NULL == f )
+        return -1;
+
+    memset( state, 0, sizeof(*state));
+    UlpReport & report = state->report;
+    unsigned long long a, b;
+    unsigned bits = 0;
+    int found = 0;          // one bit per key, so we can tell if any are missing
+    char line[1024];
+    while( fgets( line, sizeof(line), f) )
+    {
+        char * value = strchr( line, '=');
+        if( NULL == value )
+            continue;
+        *value++ = '\0';
+        value[ strcspn( value, "\n")] = '\0';
+
+        if( 0 == strcmp( line, "function") && strlen(value) < sizeof(state->function) )
+        {
+            strcpy( state->function, value);
+            found |= 1;
+        }
+        else if( 0 == strcmp( line, "range") && 2 == sscanf( value, "%llx:%llx", &a, &b) )
+        {
+            state->rangeStart = a;
+            state->rangeStop = b;
+            found |= 2;
+        }
+        else if( 0 == strcmp( line, "shard") && 2 == sscanf( value, "%u/%u", &state->shard, &state->shardCount) )
+            found |= 4;
+        else if( 0 == strcmp( line, "start") && 1 == sscanf( value, "%llx", &a) )
+        {
+            state->start = a;
+            found |= 8;
+        }
+        else if( 0 == strcmp( line, "stop") && 1 == sscanf( value, "%llx", &a) )
+        {
+            state->stop = a;
+            found |= 16;
+        }
+        else if( 0 == strcmp( line, "next") && 1 == sscanf( value, "%llx", &a) )
+        {
+            state->next = a;
+            found |= 32;
+        }
+        else if( 0 == strcmp( line, "tolerance") )
+        {
+            state->tolerance = strtof( value, NULL);
+            found |= 64;
+        }
+        else if( 0 == strcmp( line, "failures") && 1 == sscanf( value, "%llu", &a) )
+        {
+            report.failures = a;
+            found |= 128;
+        }
+        else if( 0 == strcmp( line, "worst_error") )
+        {
+            report.worstError = strtod( value, NULL);
+            found |= 256;
+        }
+        else if( 0 == strcmp( line, "worst_case") && 1 == sscanf( value, "%x", &bits) )
+        {
+            report.worstCase = BitsFloat(bits);
+            found |= 512;
+        }
+        else if( 0 == strcmp( line, "histogram") )
+        {
+            char * p = value;
+            int i = 0;
+            for( ; i < UlpReport::kHistogramBins; i++)
+            {
+                char * end;
+                report.histogram[i] = strtoull( p, &end, 10);
+                if( end == p )
+                    break;
+                p = end;
+            }
+            if( UlpReport::kHistogramBins == i )
+                found |= 1024;
+        }
+    }
+    fclose(f);
+
+    bool valid = 2047 == found && state->shardCount > 0 && state->shard < state->shardCount &&
+                 state->rangeStart <= state->start && state->start <= state->next && state->next <= state->stop &&
+                 state->stop <= state->rangeStop;
+    return valid ? 0 : -1;
+}
+
+
+#pragma mark - Merge
+
+/*! @abstract Order shards by sweep, and then by shard number */
+static int CompareShards( const void * a, const void * b)
+{
+    const ShardState * x = (const ShardState *) a;
+    const ShardState * y = (const ShardState *) b;
+    if( int order = strcmp( x->function, y->function) )
+        return order;
+    if( x->rangeStart != y->rangeStart )
+        return x->rangeStart < y->rangeStart ? -1 : 1;
+    if( x->rangeStop != y->rangeStop )
+        return x->rangeStop < y->rangeStop ? -1 : 1;
+    if( x->shardCount != y->shardCount )
+        return x->shardCount < y->shardCount ? -1 : 1;
+    return x->shard < y->shard ? -1 : x->shard > y->shard;
+}
+
+static inline bool SameSweep( const ShardState & a, const ShardState & b)
+{
+    return 0 == strcmp( a.function, b.function) && a.rangeStart == b.rangeStart && a.rangeStop == b.rangeStop &&
+           a.shardCount == b.shardCount;
+}
+
+int MergeShards( const char * directory)
+{
+    DIR * dir = opendir( directory);
+    if( NULL == dir )
+    {
+        perror( directory);
+        return -1;
+    }
+
+    // Load every shard file in the directory
+    size_t count = 0, capacity = 16;
+    ShardState * shards = (ShardState *) malloc( capacity * sizeof(shards[0]));
+    int result = shards ? 0 : -1;
+    while( struct dirent * entry = shards ? readdir(dir) : NULL )
+    {
+        size_t length = strlen( entry->d_name);
+        if( length < 6 || 0 != strcmp( entry->d_name + length - 6, ".shard") )
+            continue;
+
+        if( count == capacity )
+        {
+            ShardState * bigger = (ShardState *) realloc( shards, 2 * capacity * sizeof(shards[0]));
+            if( NULL == bigger )
+            {
+                result = -1;
+                break;
+            }
+            shards = bigger;
+            capacity *= 2;
+        }
+
+        char path[1024];
+        snprintf( path, sizeof(path), "%s/%s", directory, entry->d_name);
+        if( ReadShard( path, &shards[count]) )
+        {
+            printf( "Skipping %s: not a shard file\n", path);
+            result = -1;
+            continue;
+        }
+        count++;
+    }
+    closedir(dir);
+
+    if( 0 == count )
+        printf( "No shards found in %s\n", directory);
+
+    qsort( shards, count, sizeof(shards[0]), CompareShards);
+
+    // Merge each sweep
+    for( size_t first = 0; first < count; )
+    {
+        const ShardState & sweep = shards[first];
+        UlpReport total = {};
+        total.worstCase = NAN;
+        uint32_t expected = 0, running = 0, missing = 0;
+        uint64_t done = 0;
+
+        size_t i = first;
+        for( ; i < count && SameSweep( sweep, shards[i]); i++)
+        {
+            if( shards[i].shard != expected )          // a shard we have twice, or one before it is missing
+            {
+                if( shards[i].shard < expected )
+                    continue;
+                missing += shards[i].shard - expected;
+            }
+            expected = shards[i].shard + 1;
+
+            if( ! ShardIsComplete( &shards[i]) )
+                running++;
+            done += shards[i].next - shards[i].start;
+            total.Merge( shards[i].report);
+        }
+        missing += sweep.shardCount - expected;
+        first = i;
+
+        printf( "%s [0x%llx, 0x%llx) in %u shards: ", sweep.function, (unsigned long long) sweep.rangeStart,
+                (unsigned long long) sweep.rangeStop, sweep.shardCount);
+        if( missing || running )
+        {
+            printf( "INCOMPLETE (%u shards missing, %u unfinished, %llu of %llu inputs done)\n", missing, running,
+                    (unsigned long long) done, (unsigned long long)(sweep.rangeStop - sweep.rangeStart));
+            result = -1;
+        }
+        else if( total.failures )
+        {
+            printf( "FAILED  %llu results exceed %g ulps\n", (unsigned long long) total.failures, sweep.tolerance);
+            result = -1;
+        }
+        else
+            printf( "passed\n");
+
+        if( 0 != total.worstError )
+            printf( "\tWorst case: %10.14f ulps @ %a\n", total.worstError, total.worstCase);
+        total.Print();
+    }
+
+    free(shards);
+    return result;
+}
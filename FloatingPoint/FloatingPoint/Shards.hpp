@@ -0,0 +1,61 @@
+//
+//  Shards.hpp
+//  FloatingPoint
+//
+//  Bookkeeping for exhaustive tests that are split across processes or machines.
+//
+//  A sweep of one function over a range of float encodings is cut into shards of about the same
+//  size. Each shard keeps its progress in its own small text file of key=value lines, which is
+//  rewritten (to a temporary file, then renamed over the old one) every time another slice of the
+//  shard is done. If the process dies, the shard picks up from the last checkpoint when it is run
+//  again. Once every shard of a sweep is complete, MergeShards adds up the results.
+//
+//  Shard files are text so you can look at them, and so they can be copied between machines
+//  without caring about byte order.
+//
+
+#ifndef SHARDS_HPP
+#define SHARDS_HPP      1
+
+#include "Ulps.hpp"
+#include <stddef.h>
+#include <stdint.h>
+
+/*! @abstract Everything a shard file holds */
+typedef struct ShardState
+{
+    char        function[32];       // e.g. "log2"
+    uint64_t    rangeStart;         // the whole sweep covers encodings [rangeStart, rangeStop)
+    uint64_t    rangeStop;
+    uint32_t    shard;              // this is shard number shard of shardCount
+    uint32_t    shardCount;
+    uint64_t    start;              // this shard covers encodings [start, stop)
+    uint64_t    stop;
+    uint64_t    next;               // [start, next) is done
+    float       tolerance;          // ulps
+    UlpReport   report;             // results for [start, next)
+}ShardState;
+
+/*! @abstract Set up a new shard, with nothing done yet. Shards split the range as evenly as possible. */
+void InitShard( ShardState * state, const char * function, uint64_t rangeStart, uint64_t rangeStop,
+                uint32_t shard, uint32_t shardCount, float tolerance);
+
+/*! @abstract true if the shard has been run to the end */
+static inline bool ShardIsComplete( const ShardState * state){ return state->next >= state->stop; }
+
+/*! @abstract The file the shard lives in: directory/function.start-stop.KofN.shard, with start and stop in hex */
+void ShardPath( char * path, size_t size, const char * directory, const ShardState * state);
+
+/*! @abstract Save a checkpoint. The old file is replaced atomically, so a crash leaves either the old or the new one.
+ *  @return 0 on success, -1 on error */
+int WriteShard( const char * path, const ShardState * state);
+
+/*! @abstract Load a shard file.
+ *  @return 0 on success, -1 if the file is missing or malformed */
+int ReadShard( const char * path, ShardState * state);
+
+/*! @abstract Combine the shard files in directory into one pass/fail report per sweep, and print it.
+ *  @return 0 if every sweep is complete and passed, -1 if any failed, is missing shards or is still running. */
+int MergeShards( const char * directory);
+
+#endif /* SHARDS_HPP */
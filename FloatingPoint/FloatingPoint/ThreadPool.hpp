@@ -0,0 +1,332 @@
+//
+//  ThreadPool.hpp
+//  FloatingPoint
+//
+//  A small work-stealing thread pool for the test drivers, so they need neither libdispatch nor blocks.
+//  ParallelFor( begin, end, grain, fn) calls fn(i) once for each i in [begin, end), like dispatch_apply,
+//  but with an ordinary lambda, a worker count and core pinning we choose, and a grain we choose.
+//
+//  The range is cut into one contiguous slice per worker up front. Each worker eats its own slice from the
+//  front, grain indices at a time. A worker that runs out steals the back half of whatever another has left.
+//  The exhaustive sweeps need that: a chunk full of subnormals or NaNs can take many times longer than its
+//  neighbors, and with a fixed split the whole sweep waits on whichever core drew the slow chunks. Each slice
+//  is a [first, last) pair packed into one 64-bit atomic, so taking and stealing are each a single
+//  compare and swap, and nobody takes a lock except to start and finish a ParallelFor.
+//
+//  The shared pool is set up from the environment the first time it is used:
+//
+//      THREAD_POOL_WORKERS=<n>     how many threads work on a ParallelFor, counting the caller. Default: one per core.
+//      THREAD_POOL_PIN=1           pin worker k to the k-th core we are allowed to run on. Linux only. macOS has
+//                                  only affinity hints, which Apple silicon ignores.
+//
+//      https://en.wikipedia.org/wiki/Work_stealing
+//
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP     1
+
+#include <assert.h>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+#if __linux__
+#   include <pthread.h>
+#   include <sched.h>
+#endif
+
+class ThreadPool
+{
+public:
+    /*! @abstract Make a pool in which workerCount threads, counting the one that calls ParallelFor, share the work.
+     *  @discussion 0 means one per core we are allowed to run on. The caller is never pinned: it is your thread. */
+    explicit ThreadPool( unsigned workerCount = 0, bool pinThreads = false);
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool &) = delete;
+    ThreadPool & operator=( const ThreadPool &) = delete;
+
+    /*! @abstract The pool the test drivers use, configured by THREAD_POOL_WORKERS and THREAD_POOL_PIN */
+    static ThreadPool & Shared(void);
+
+    /*! @abstract How many threads work on a ParallelFor, including the caller */
+    inline unsigned WorkerCount() const { return workerCount; }
+
+    /*! @abstract Call fn(i) for every i in [begin, end), spread over the pool. Returns when they are all done.
+     *  @discussion Workers take grain indices at a time, so make grain large enough to amortize an atomic
+     *              compare and swap, and small enough to leave something to steal. The range may hold
+     *              fewer than 2**32 indices. A ParallelFor called from inside fn just runs serially on the calling thread. */
+    template <typename Function>
+    void ParallelFor( size_t begin, size_t end, size_t grain, const Function & fn);
+
+private:
+    typedef void (*RangeFunction)( const void * context, size_t begin, size_t end);
+
+    /*! @abstract One ParallelFor, with the type of its fn erased */
+    typedef struct Job
+    {
+        RangeFunction   work;
+        const void *    context;
+        size_t          begin;
+        uint32_t        grain;
+    }Job;
+
+    /*! @abstract What is left of one worker's share of the range, as (first << 32) | last, relative to Job::begin.
+     *            On a cache line of its own, so workers taking from their own slices don't slow one another. */
+    struct alignas(64) Slice
+    {
+        std::atomic<uint64_t>   range;
+    };
+
+    static inline uint64_t Pack( uint32_t first, uint32_t last){ return (uint64_t) first << 32 | last; }
+    static inline uint32_t First( uint64_t range){ return uint32_t(range >> 32); }
+    static inline uint32_t Last( uint64_t range){ return uint32_t(range); }
+
+    static unsigned AvailableCores(void);
+    static void PinCurrentThread( unsigned index);
+
+    void Dispatch( const Job & newJob, size_t count);
+    void WorkerLoop( unsigned self);
+    void Work( unsigned self);
+    bool Take( unsigned self, uint32_t * first, uint32_t * last);
+    bool Steal( unsigned self);
+
+    unsigned                    workerCount;
+    bool                        pinThreads;
+    std::unique_ptr<Slice[]>    slices;
+    std::vector<std::thread>    threads;
+
+    std::mutex                  callerLock;         // one ParallelFor at a time
+    std::mutex                  lock;               // guards the rest
+    std::condition_variable     wake;               // a new job, or time to quit
+    std::condition_variable     done;               // busy reached 0
+    Job                         job;
+    uint64_t                    generation = 0;     // incremented for each job
+    unsigned                    busy = 0;           // pool threads not yet finished with the current job
+    bool                        quit = false;
+
+    static inline thread_local bool tInsideJob = false;
+};
+
+template <typename Function>
+void ThreadPool::ParallelFor( size_t begin, size_t end, size_t grain, const Function & fn)
+{
+    if( begin >= end )
+        return;
+
+    size_t count = end - begin;
+    if( 0 == grain )
+        grain = 1;
+
+    // Nothing to share, or we are already one of the workers
+    if( 1 == workerCount || count <= grain || tInsideJob )
+    {
+        for( size_t i = begin; i < end; i++)
+            fn(i);
+        return;
+    }
+
+    assert( count < (1ULL << 32) );
+    Job newJob;
+    newJob.work = []( const void * context, size_t first, size_t last)
+    {
+        const Function & f = *(const Function *) context;
+        for( size_t i = first; i < last; i++)
+            f(i);
+    };
+    newJob.context = &fn;
+    newJob.begin = begin;
+    newJob.grain = uint32_t( grain < count ? grain : count);
+    Dispatch( newJob, count);
+}
+
+/*! @abstract ThreadPool::Shared().ParallelFor( begin, end, grain, fn) */
+template <typename Function>
+static inline void ParallelFor( size_t begin, size_t end, size_t grain, const Function & fn)
+{
+    ThreadPool::Shared().ParallelFor( begin, end, grain, fn);
+}
+
+#pragma mark - Implementation
+
+inline ThreadPool::ThreadPool( unsigned count, bool pin) : workerCount( count ? count : AvailableCores()), pinThreads(pin)
+{
+    slices.reset( new Slice[workerCount]);
+    for( unsigned i = 0; i < workerCount; i++)
+        slices[i].range.store( 0, std::memory_order_relaxed);
+
+    // The caller is worker 0
+    threads.reserve( workerCount - 1);
+    for( unsigned i = 1; i < workerCount; i++)
+        threads.emplace_back( [this, i]{ WorkerLoop(i); });
+}
+
+inline ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> guard( lock);
+        quit = true;
+    }
+    wake.notify_all();
+    for( std::thread & t : threads )
+        t.join();
+}
+
+inline ThreadPool & ThreadPool::Shared(void)
+{
+    static ThreadPool pool( [](){ const char * s = getenv( "THREAD_POOL_WORKERS"); return s ? (unsigned) strtoul( s, NULL, 0) : 0U; }(),
+                            [](){ const char * s = getenv( "THREAD_POOL_PIN"); return s && atoi(s); }());
+    return pool;
+}
+
+inline unsigned ThreadPool::AvailableCores(void)
+{
+#if __linux__
+    // hardware_concurrency counts the machine. A container or taskset may give us fewer.
+    cpu_set_t allowed;
+    if( 0 == sched_getaffinity( 0, sizeof(allowed), &allowed) && CPU_COUNT( &allowed) > 0 )
+        return (unsigned) CPU_COUNT( &allowed);
+#endif
+    unsigned count = std::thread::hardware_concurrency();
+    return count ? count : 1;
+}
+
+inline void ThreadPool::PinCurrentThread( unsigned index)
+{
+#if __linux__
+    cpu_set_t allowed;
+    if( 0 != sched_getaffinity( 0, sizeof(allowed), &allowed) || 0 == CPU_COUNT( &allowed) )
+        return;
+
+    // The index-th core in the set we were started with, wrapping around if there are more workers than cores
+    unsigned skip = index % (unsigned) CPU_COUNT( &allowed);
+    for( int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if( CPU_ISSET( cpu, &allowed) && 0 == skip-- )
+        {
+            cpu_set_t one;
+            CPU_ZERO( &one);
+            CPU_SET( cpu, &one);
+            pthread_setaffinity_np( pthread_self(), sizeof(one), &one);
+            return;
+        }
+#else
+    (void) index;
+#endif
+}
+
+inline void ThreadPool::Dispatch( const Job & newJob, size_t count)
+{
+    std::lock_guard<std::mutex> serialize( callerLock);
+
+    for( unsigned i = 0; i < workerCount; i++)
+        slices[i].range.store( Pack( uint32_t( count * i / workerCount), uint32_t( count * (i + 1) / workerCount)), std::memory_order_relaxed);
+
+    {
+        std::lock_guard<std::mutex> guard( lock);
+        job = newJob;
+        busy = workerCount - 1;
+        generation++;
+    }
+    wake.notify_all();
+
+    tInsideJob = true;
+    Work(0);
+    tInsideJob = false;
+
+    // The others may still be finishing what they took. Wait, so the job and fn stay alive until they are done.
+    std::unique_lock<std::mutex> guard( lock);
+    done.wait( guard, [this]{ return 0 == busy; });
+}
+
+inline void ThreadPool::WorkerLoop( unsigned self)
+{
+    tInsideJob = true;
+    if( pinThreads )
+        PinCurrentThread( self);
+
+    uint64_t seen = 0;
+    for(;;)
+    {
+        {
+            std::unique_lock<std::mutex> guard( lock);
+            wake.wait( guard, [&]{ return quit || generation != seen; });
+            if( quit )
+                return;
+            seen = generation;
+        }
+
+        Work( self);
+
+        std::lock_guard<std::mutex> guard( lock);
+        if( 0 == --busy )
+            done.notify_one();
+    }
+}
+
+/*! @abstract Run our own slice, then steal, until there is nothing left that nobody has taken */
+inline void ThreadPool::Work( unsigned self)
+{
+    do
+    {
+        uint32_t first, last;
+        while( Take( self, &first, &last) )
+            job.work( job.context, job.begin + first, job.begin + last);
+    }while( Steal( self));
+}
+
+/*! @abstract Take up to grain indices from the front of our own slice */
+inline bool ThreadPool::Take( unsigned self, uint32_t * first, uint32_t * last)
+{
+    std::atomic<uint64_t> & range = slices[self].range;
+    uint64_t r = range.load( std::memory_order_relaxed);
+    for(;;)
+    {
+        if( First(r) >= Last(r) )
+            return false;
+
+        uint32_t stop = Last(r) - First(r) > job.grain ? First(r) + job.grain : Last(r);
+        if( range.compare_exchange_weak( r, Pack( stop, Last(r)), std::memory_order_relaxed) )
+        {
+            *first = First(r);
+            *last = stop;
+            return true;
+        }
+    }
+}
+
+/*! @abstract Move the back half of another worker's slice into our own, which is empty. false if every slice is empty.
+ *  @discussion Slices only shrink, and a stolen range was taken out of one before it goes into another, so no slice
+ *              ever holds the same non-empty range twice, and a compare and swap can't be fooled by a stale value. */
+inline bool ThreadPool::Steal( unsigned self)
+{
+    bool sawWork;
+    do
+    {
+        sawWork = false;
+        for( unsigned i = 1; i < workerCount; i++)
+        {
+            std::atomic<uint64_t> & victim = slices[(self + i) % workerCount].range;
+            uint64_t r = victim.load( std::memory_order_relaxed);
+            if( First(r) >= Last(r) )
+                continue;
+
+            // They keep [first, middle). We take [middle, last), which is the last index when only one is left.
+            sawWork = true;
+            uint32_t middle = First(r) + (Last(r) - First(r)) / 2;
+            if( victim.compare_exchange_strong( r, Pack( First(r), middle), std::memory_order_relaxed) )
+            {
+                slices[self].range.store( Pack( middle, Last(r)), std::memory_order_relaxed);
+                return true;
+            }
+        }
+    }while( sawWork);
+
+    return false;
+}
+
+#endif /* THREAD_POOL_HPP */
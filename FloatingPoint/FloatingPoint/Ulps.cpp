@@ -0,0 +1,121 @@
+//
+//  Ulps.cpp
+//  FloatingPoint
+//
+//  Vector kernels for FloatUlpsArray. They do what FloatUlps does, but with the special cases
+//  handled by masks after the fact rather than branches up front.
+//
+
+#include "Ulps.hpp"
+#include "VectorISA.hpp"
+
+typedef void (*UlpsFunction)( const float * test, const double * correct, double * ulps, size_t count);
+
+static void FloatUlpsScalar( const float * test, const double * correct, double * ulps, size_t count)
+{
+    for( size_t i = 0; i < count; i++)
+        ulps[i] = FloatUlps( test[i], correct[i]);
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+// 2 * kDoubleExponentBias - ulpExponent  ==  kScaleExponent - max( exponent, kFloatMinExponentField)
+static constexpr int64_t kScaleExponent = 2 * kDoubleExponentBias + (FLT_MANT_DIG - 1);
+
+static AVX2_KERNEL void FloatUlpsAVX2( const float * test, const double * correct, double * ulps, size_t count)
+{
+    const __m256i exponentMask = _mm256_set1_epi64x( 0x7ff);
+    const __m256i mantissaMask = _mm256_set1_epi64x( (int64_t) kDoubleMantissaMask);
+    const __m256i minExponent = _mm256_set1_epi64x( kFloatMinExponentField);
+    const __m256i scaleExponent = _mm256_set1_epi64x( kScaleExponent);
+    const __m256d infinity = _mm256_set1_pd( INFINITY);
+    const __m256d overflow = _mm256_set1_pd( kFloatOverflow);
+    const __m256d negativeOverflow = _mm256_set1_pd( -kFloatOverflow);
+
+    size_t i = 0;
+    for( ; i + 4 <= count; i += 4)
+    {
+        // Clamp to +-2**128 for overflow, as FloatUlps does. NaNs pass through: max and min return their second operand for NaN.
+        __m256d t = _mm256_cvtps_pd( _mm_loadu_ps( test + i));
+        __m256d c = _mm256_loadu_pd( correct + i);
+        t = _mm256_min_pd( overflow, _mm256_max_pd( negativeOverflow, t));
+        c = _mm256_min_pd( overflow, _mm256_max_pd( negativeOverflow, c));
+        __m256i bits = _mm256_castpd_si256(c);
+
+        // The exponent fields are small and positive, so a 32-bit max works on the 64-bit lanes
+        __m256i exponent = _mm256_and_si256( _mm256_srli_epi64( bits, 52), exponentMask);
+        __m256i isPowerOfTwo = _mm256_and_si256( _mm256_cmpeq_epi64( _mm256_and_si256( bits, mantissaMask), _mm256_setzero_si256()),
+                                                 _mm256_cmpgt_epi64( exponent, minExponent));
+        __m256i e = _mm256_sub_epi64( scaleExponent, _mm256_max_epi32( exponent, minExponent));
+        e = _mm256_sub_epi64( e, isPowerOfTwo);         // -1 where true, so this is e + 1 for the modified Goldberg ulp
+        __m256d error = _mm256_mul_pd( _mm256_sub_pd( t, c), _mm256_castsi256_pd( _mm256_slli_epi64( e, 52)));
+
+        __m256d testIsNaN = _mm256_cmp_pd( t, t, _CMP_UNORD_Q);
+        __m256d correctIsNaN = _mm256_cmp_pd( c, c, _CMP_UNORD_Q);
+        __m256d same = _mm256_or_pd( _mm256_cmp_pd( t, c, _CMP_EQ_OQ), _mm256_and_pd( testIsNaN, correctIsNaN));
+        error = _mm256_blendv_pd( error, infinity, _mm256_xor_pd( testIsNaN, correctIsNaN));
+        _mm256_storeu_pd( ulps + i, _mm256_andnot_pd( same, error));
+    }
+
+    // The tail and the caller are SSE code. Clean upper state first, or every SSE instruction pays a transition penalty.
+    _mm256_zeroupper();
+    FloatUlpsScalar( test + i, correct + i, ulps + i, count - i);
+}
+
+static AVX512_KERNEL void FloatUlpsAVX512( const float * test, const double * correct, double * ulps, size_t count)
+{
+    const __m512i exponentMask = _mm512_set1_epi64( 0x7ff);
+    const __m512i mantissaMask = _mm512_set1_epi64( (int64_t) kDoubleMantissaMask);
+    const __m512i minExponent = _mm512_set1_epi64( kFloatMinExponentField);
+    const __m512i scaleExponent = _mm512_set1_epi64( kScaleExponent);
+    const __m512d infinity = _mm512_set1_pd( INFINITY);
+    const __m512d overflow = _mm512_set1_pd( kFloatOverflow);
+    const __m512d negativeOverflow = _mm512_set1_pd( -kFloatOverflow);
+
+    size_t i = 0;
+    for( ; i + 8 <= count; i += 8)
+    {
+        __m512d t = _mm512_cvtps_pd( _mm256_loadu_ps( test + i));
+        __m512d c = _mm512_loadu_pd( correct + i);
+        t = _mm512_min_pd( overflow, _mm512_max_pd( negativeOverflow, t));
+        c = _mm512_min_pd( overflow, _mm512_max_pd( negativeOverflow, c));
+        __m512i bits = _mm512_castpd_si512(c);
+
+        __m512i exponent = _mm512_and_si512( _mm512_srli_epi64( bits, 52), exponentMask);
+        __mmask8 isPowerOfTwo = _mm512_testn_epi64_mask( bits, mantissaMask) & _mm512_cmpgt_epi64_mask( exponent, minExponent);
+        __m512i e = _mm512_sub_epi64( scaleExponent, _mm512_max_epi64( exponent, minExponent));
+        e = _mm512_mask_add_epi64( e, isPowerOfTwo, e, _mm512_set1_epi64(1));
+        __m512d error = _mm512_mul_pd( _mm512_sub_pd( t, c), _mm512_castsi512_pd( _mm512_slli_epi64( e, 52)));
+
+        __mmask8 testIsNaN = _mm512_cmp_pd_mask( t, t, _CMP_UNORD_Q);
+        __mmask8 correctIsNaN = _mm512_cmp_pd_mask( c, c, _CMP_UNORD_Q);
+        __mmask8 same = _mm512_cmp_pd_mask( t, c, _CMP_EQ_OQ) | (testIsNaN & correctIsNaN);
+        error = _mm512_mask_mov_pd( error, testIsNaN ^ correctIsNaN, infinity);
+        _mm512_storeu_pd( ulps + i, _mm512_mask_mov_pd( error, same, _mm512_setzero_pd()));
+    }
+
+    // The tail and the caller are SSE code. Clean upper state first, or every SSE instruction pays a transition penalty.
+    _mm256_zeroupper();
+    FloatUlpsScalar( test + i, correct + i, ulps + i, count - i);
+}
+#endif
+
+static UlpsFunction SelectUlpsKernel(void)
+{
+    switch( GetVectorISA() )
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case kISAAVX2:      return FloatUlpsAVX2;
+        case kISAAVX512:
+        case kISAAVX512FP16: return FloatUlpsAVX512;
+#endif
+        default:            return FloatUlpsScalar;
+    }
+}
+
+void FloatUlpsArray( const float * test, const double * correct, double * ulps, size_t count)
+{
+    static const UlpsFunction kernel = SelectUlpsKernel();
+    kernel( test, correct, ulps, count);
+}
@@ -0,0 +1,213 @@
+//
+//  Ulps.hpp
+//  FloatingPoint
+//
+//  Measure the error in a float or double result in units of the last place (ulps) of the correct answer.
+//
+//  The ulp is taken from the exponent of the correct answer as a float would have it, read straight
+//  out of the bits of the double. There is no frexp / ldexp: the error is just (test - correct) times
+//  a power of two we make by writing its exponent field.
+//
+//      https://en.wikipedia.org/wiki/Unit_in_the_last_place
+//      https://inria.hal.science/inria-00070503v1/document      (modified Goldberg ulp)
+//
+
+#ifndef ULPS_HPP
+#define ULPS_HPP    1
+
+#include "Float16.hpp"
+#include "Rounding.hpp"
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Double precision encoding, and the double exponent field of FLT_MIN, below which float ulps stop shrinking
+static constexpr int        kDoubleExponentBias = 1023;
+static constexpr uint64_t   kDoubleMantissaMask = 0x000fffffffffffffULL;
+static constexpr int        kFloatMinExponentField = kDoubleExponentBias + FLT_MIN_EXP - 1;
+static constexpr double     kFloatOverflow = 0x1.0p128;         // FLT_MAX + 1 ulp
+
+/*! @abstract Return the signed error of test in float ulps of correct.
+ *  @discussion Exact answers, including matching infinities, and NaN for NaN are 0.
+ *              NaN where a number was expected, or a number where NaN was expected, is infinitely wrong.
+ *              When correct is a power of two, the error is measured in ulps of the binade below it (modified
+ *              Goldberg ulp), so that being a hair low on a power of two doesn't look twice as good as it is.
+ *              Below FLT_MIN the ulp is the subnormal spacing, 2**-149. */
+static inline double FloatUlps( float test, double correct )
+{
+    // Remove exact matches, including infinities, and NaN for NaN
+    bool testIsNaN = isnan(test);
+    bool correctIsNaN = isnan(correct);
+    if( (double) test == correct || (testIsNaN && correctIsNaN))
+        return 0;
+    if( testIsNaN || correctIsNaN )
+        return INFINITY;
+
+    // Overflow: score infinity as 2**128, the first value float can't hold, and anything past it as 2**128 too.
+    // Then infinity is exact where the answer is past 2**128, and FLT_MAX is 1 ulp off, not infinitely.
+    double t = test;
+    if( fabs(t) > kFloatOverflow )
+        t = copysign( kFloatOverflow, t);
+    if( fabs(correct) > kFloatOverflow )
+        correct = copysign( kFloatOverflow, correct);
+    if( t == correct )
+        return 0;
+
+    // The float ulp of correct, from its double exponent field
+    union{ double d; uint64_t u; }c = {correct};
+    int exponent = int(c.u >> 52) & 0x7ff;
+    int ulpExponent = (exponent > kFloatMinExponentField ? exponent : kFloatMinExponentField) - (FLT_MANT_DIG - 1);
+    if( 0 == (c.u & kDoubleMantissaMask) && exponent > kFloatMinExponentField )
+        ulpExponent--;          //Modified Goldberg Ulp
+
+    // Scale the error by 2**-ulp. This is exact, so the only rounding is in test - correct.
+    union{ uint64_t u; double d; }scale = { uint64_t(2 * kDoubleExponentBias - ulpExponent) << 52 };
+    return (t - correct) * scale.d;
+}
+
+/*! @abstract FloatUlps for the 16-bit formats: the signed error of test in ulps of correct, as a T would hold it
+ *  @discussion Special cases, overflow and the ulp at powers of two are scored the same way as FloatUlps. */
+template <typename T>
+static inline double Float16Ulps( T test, double correct )
+{
+    typedef Float16Format<T> Format;
+    double t = ToFloat(test);
+    bool testIsNaN = isnan(t);
+    bool correctIsNaN = isnan(correct);
+    if( t == correct || (testIsNaN && correctIsNaN))
+        return 0;
+    if( testIsNaN || correctIsNaN )
+        return INFINITY;
+
+    // Overflow, at 2**(kMaxExponent+1), made from its bits
+    union{ uint64_t u; double d; }overflow = { uint64_t(kDoubleExponentBias + Format::kMaxExponent + 1) << 52 };
+    if( fabs(t) > overflow.d )
+        t = copysign( overflow.d, t);
+    if( fabs(correct) > overflow.d )
+        correct = copysign( overflow.d, correct);
+    if( t == correct )
+        return 0;
+
+    constexpr int kMinExponentField = kDoubleExponentBias + Format::kMinExponent;
+    union{ double d; uint64_t u; }c = {correct};
+    int exponent = int(c.u >> 52) & 0x7ff;
+    int ulpExponent = (exponent > kMinExponentField ? exponent : kMinExponentField) - Format::kMantissaBits;
+    if( 0 == (c.u & kDoubleMantissaMask) && exponent > kMinExponentField )
+        ulpExponent--;          //Modified Goldberg Ulp
+
+    union{ uint64_t u; double d; }scale = { uint64_t(2 * kDoubleExponentBias - ulpExponent) << 52 };
+    return (t - correct) * scale.d;
+}
+
+/*! @abstract Batch form of FloatUlps: ulps[i] = FloatUlps( test[i], correct[i]) for i in [0, count)
+ *  @discussion Results are identical to FloatUlps. Scores 8 results per instruction with AVX-512, 4 with AVX2. */
+void FloatUlpsArray( const float * test, const double * correct, double * ulps, size_t count);
+
+/*! @abstract Return the signed error of test in double ulps of the double-double correctHi + correctLo.
+ *  @discussion DoubleUlps is FloatUlps one format up. The answer is carried to about 106 bits, so a result can be
+ *              scored as, say, 0.5002 ulps rather than rounded to 0 or 1 by the reference. Special cases and the
+ *              modified Goldberg ulp are as for FloatUlps; a power of two counts as one only if the low part
+ *              doesn't lift the answer above it. There is no overflow to score: the reference is a double too.
+ *              Below DBL_MIN the ulp is the subnormal spacing, 2**-1074. */
+static inline double DoubleUlps( double test, double correctHi, double correctLo = 0)
+{
+    bool testIsNaN = isnan(test);
+    bool correctIsNaN = isnan(correctHi);
+    if( (test == correctHi && 0 == correctLo) || (testIsNaN && correctIsNaN))
+        return 0;
+    if( testIsNaN || correctIsNaN )
+        return INFINITY;
+    if( isinf(test) || isinf(correctHi) )
+        return test == correctHi ? 0 : copysign( INFINITY, test - correctHi);
+
+    union{ double d; uint64_t u; }c = {correctHi};
+    int exponent = int(c.u >> 52) & 0x7ff;
+    int ulpExponent = (exponent > 1 ? exponent : 1) - kDoubleExponentBias - (DBL_MANT_DIG - 1);
+    bool lowPullsDown = 0 == correctLo || (correctLo < 0) == (correctHi > 0);
+    if( 0 == (c.u & kDoubleMantissaMask) && exponent > 1 && lowPullsDown )
+        ulpExponent--;          //Modified Goldberg Ulp
+
+    // 2**-ulpExponent runs up to 2**1075, past DBL_MAX, so scale in two steps. Each is exact. test - correctHi
+    // is exact too where it matters, within a few ulps, so the low part isn't lost.
+    int half = -ulpExponent / 2;
+    union{ uint64_t u; double d; }scale1 = { uint64_t(kDoubleExponentBias + half) << 52 };
+    union{ uint64_t u; double d; }scale2 = { uint64_t(kDoubleExponentBias - ulpExponent - half) << 52 };
+    return (((test - correctHi) - correctLo) * scale1.d) * scale2.d;
+}
+
+/*! @abstract Error statistics for a range of inputs, for results of type T (float or double).
+ *  @discussion Each worker fills in its own and they are merged once all the work is done, so there is no
+ *              need for any synchronization while testing. */
+template <typename T>
+struct UlpStatistics
+{
+    // histogram[0] counts exact results. histogram[i] counts errors in ((i-1)/8, i/8] ulps, and the
+    // last bin counts everything worse than that, including NaN where a number was expected.
+    static constexpr int kBinsPerUlp = 8;
+    static constexpr int kHistogramBins = 4 * kBinsPerUlp + 2;
+
+    double      worstError;             // signed ulps; NaN is reported as infinity
+    T           worstCase;              // input that produced worstError
+    uint64_t    histogram[kHistogramBins];
+    uint64_t    failures;               // number of results worse than the tolerance
+    bool        damaged;                // the reference table couldn't be read
+
+    inline void Add( T input, double error, double tolerance)
+    {
+        double magnitude = isnan(error) ? INFINITY : fabs(error);
+        if( isnan(error) )
+            error = INFINITY;
+
+        int bin = magnitude > double(kHistogramBins - 2) / kBinsPerUlp ? kHistogramBins - 1 : int( ceil( magnitude * kBinsPerUlp));
+        histogram[bin]++;
+
+        if( magnitude > tolerance )
+            failures++;
+
+        if( magnitude > fabs(worstError) )
+        {
+            worstError = error;
+            worstCase = input;
+        }
+    }
+
+    inline void Merge( const UlpStatistics & other)
+    {
+        for( int i = 0; i < kHistogramBins; i++)
+            histogram[i] += other.histogram[i];
+        failures += other.failures;
+        damaged |= other.damaged;
+
+        // Ties go to the input with the smaller encoding, so the answer doesn't depend on the order of merging
+        typedef typename EncodingFormat<T>::Bits Bits;
+        union{ T f; Bits u; }a = {worstCase}, b = {other.worstCase};
+        if( fabs(other.worstError) > fabs(worstError) || (fabs(other.worstError) == fabs(worstError) && b.u < a.u))
+        {
+            worstError = other.worstError;
+            worstCase = other.worstCase;
+        }
+    }
+
+    void Print() const
+    {
+        for( int i = 0; i < kHistogramBins; i++)
+        {
+            if( 0 == histogram[i] )
+                continue;
+
+            if( 0 == i )
+                printf( "\t       exact: %llu\n", (unsigned long long) histogram[i]);
+            else if( kHistogramBins - 1 == i )
+                printf( "\t   > %5.3f ulp: %llu\n", double(i - 1) / kBinsPerUlp, (unsigned long long) histogram[i]);
+            else
+                printf( "\t  <= %5.3f ulp: %llu\n", double(i) / kBinsPerUlp, (unsigned long long) histogram[i]);
+        }
+    }
+};
+
+typedef UlpStatistics<float>    UlpReport;
+typedef UlpStatistics<double>   DoubleUlpReport;
+
+#endif /* ULPS_HPP */
@@ -0,0 +1,126 @@
+//
+//  VectorISA.cpp
+//  FloatingPoint
+//
+
+#include "VectorISA.hpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__x86_64__) || defined(__i386__)
+#   include <cpuid.h>
+#elif __APPLE__
+#   include <sys/sysctl.h>
+#endif
+
+const char * VectorISAName( VectorISA isa)
+{
+    switch( isa )
+    {
+        case kISAScalar:    return "scalar";
+        case kISASSE41:     return "sse4.1";
+        case kISAAVX2:      return "avx2";
+        case kISAAVX512:    return "avx512";
+        case kISAAVX512FP16: return "avx512fp16";
+        case kISANEON:      return "neon";
+    }
+    return "unknown";
+}
+
+/*! @abstract Fill in what we can run, from worst to best, and return how many there are */
+static int GetSupportedVectorISAs( VectorISA supported[5])
+{
+    int count = 0;
+    supported[count++] = kISAScalar;
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if( __builtin_cpu_supports("sse4.1"))   supported[count++] = kISASSE41;
+    if( __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))   supported[count++] = kISAAVX2;     // every AVX2 part has FMA, but make sure
+    if( __builtin_cpu_supports("avx512f"))  supported[count++] = kISAAVX512;
+    if( __builtin_cpu_supports("avx512fp16") && __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))
+        supported[count++] = kISAAVX512FP16;
+#elif defined(__aarch64__)
+    supported[count++] = kISANEON;
+#endif
+    return count;
+}
+
+bool IsVectorISASupported( VectorISA isa)
+{
+    VectorISA supported[5];
+    int count = GetSupportedVectorISAs( supported);
+    for( int i = 0; i < count; i++)
+        if( isa == supported[i] )
+            return true;
+    return false;
+}
+
+static VectorISA SelectVectorISA(void)
+{
+    VectorISA supported[5];
+    int count = GetSupportedVectorISAs( supported);
+
+    const char * cap = getenv("FP_ARRAY_ISA");
+    if( cap )
+        for( int i = 0; i < count; i++)
+            if( 0 == strcmp( cap, VectorISAName(supported[i])))
+                return supported[i];
+
+    return supported[count-1];
+}
+
+VectorISA GetVectorISA(void)
+{
+    static const VectorISA isa = SelectVectorISA();       // thread safe one-time initialization
+    return isa;
+}
+
+/*! @abstract Read the name of the CPU from wherever this OS keeps it */
+static void ReadCPUModelName( char * name, size_t size)
+{
+    snprintf( name, size, "unknown");
+#if defined(__x86_64__) || defined(__i386__)
+    // The brand string is in leaves 0x80000002-4, 16 bytes each. Family, model and stepping tell apart
+    // parts that share a marketing name.
+    unsigned regs[12] = {}, eax, ebx, ecx, edx;
+    if( __get_cpuid_max( 0x80000000, NULL) >= 0x80000004 )
+        for( unsigned i = 0; i < 3; i++)
+            __get_cpuid( 0x80000002 + i, &regs[4*i], &regs[4*i+1], &regs[4*i+2], &regs[4*i+3]);
+    char brand[49] = {};
+    memcpy( brand, regs, 48);
+    const char * b = brand;
+    while( ' ' == *b )
+        b++;
+    if( __get_cpuid( 1, &eax, &ebx, &ecx, &edx) )
+    {
+        unsigned family = (eax >> 8) & 0xf, model = (eax >> 4) & 0xf;
+        if( 0xf == family )
+            family += (eax >> 20) & 0xff;
+        if( 0x6 == family || family >= 0xf )
+            model |= ((eax >> 16) & 0xf) << 4;
+        snprintf( name, size, "%s (family 0x%x, model 0x%x, stepping %u)", b, family, model, eax & 0xf);
+    }
+#elif __APPLE__
+    size_t length = size;
+    if( 0 != sysctlbyname( "machdep.cpu.brand_string", name, &length, NULL, 0) )
+        snprintf( name, size, "unknown");
+#elif __linux__ && defined(__aarch64__)
+    // Implementer, part number and revision, from the MIDR_EL1 register the kernel shows us
+    FILE * f = fopen( "/sys/devices/system/cpu/cpu0/regs/identification/midr_el1", "r");
+    if( f )
+    {
+        char midr[32];
+        if( fgets( midr, sizeof(midr), f) )
+            snprintf( name, size, "arm64 midr %.*s", (int) strcspn( midr, "\n"), midr);
+        fclose(f);
+    }
+#endif
+}
+
+const char * CPUModelName(void)
+{
+    static char name[128];
+    static bool once = (ReadCPUModelName( name, sizeof(name)), true);     // thread safe one-time initialization
+    (void) once;
+    return name;
+}
@@ -0,0 +1,47 @@
+//
+//  VectorISA.hpp
+//  FloatingPoint
+//
+//  Which vector instruction set the array kernels use. Each .cpp file that has vector kernels
+//  builds all of them with target attributes, and picks one at run time with GetVectorISA().
+//
+
+#ifndef VECTOR_ISA_HPP
+#define VECTOR_ISA_HPP  1
+
+/*! @abstract Vector instruction sets we have kernels for. Within an architecture, later is better. */
+typedef enum VectorISA
+{
+    kISAScalar = 0,
+    kISASSE41,
+    kISAAVX2,
+    kISAAVX512,
+    kISAAVX512FP16,     // AVX-512 with half precision arithmetic. Only the half kernels use the difference.
+    kISANEON,
+}VectorISA;
+
+#if defined(__x86_64__) || defined(__i386__)
+#   define SSE41_KERNEL    __attribute__((target("sse4.1")))
+#   define AVX2_KERNEL     __attribute__((target("avx2")))
+#   define AVX512_KERNEL   __attribute__((target("avx512f")))
+#   define AVX512DQ_KERNEL __attribute__((target("avx512f,avx512dq")))   // not part of kISAAVX512: check for DQ too
+#   define F16C_KERNEL     __attribute__((target("avx2,f16c")))          // every AVX2 machine has F16C
+#   define AVX2_FMA_KERNEL __attribute__((target("avx2,fma")))           // kISAAVX2 requires FMA too
+#   define AVX512FP16_KERNEL   __attribute__((target("avx512fp16,avx512bw,avx512vl")))
+#endif
+
+/*! @abstract The best instruction set this CPU can run, or the one named by FP_ARRAY_ISA if the CPU can run that.
+ *  @discussion Decided once, the first time it is called */
+VectorISA GetVectorISA(void);
+
+/*! @abstract The name of the instruction set, e.g. "avx2". These are also the values FP_ARRAY_ISA takes. */
+const char * VectorISAName( VectorISA isa);
+
+/*! @abstract true if this CPU can run kernels built for isa, whatever FP_ARRAY_ISA says */
+bool IsVectorISASupported( VectorISA isa);
+
+/*! @abstract Which CPU this is, as precisely as we can tell, e.g. "AMD EPYC 9654 96-Core Processor (family 0x19, model 0x11, stepping 1)".
+ *  @discussion For telling whether something measured on one machine still holds on another. "unknown" if we can't tell. */
+const char * CPUModelName(void);
+
+#endif /* VECTOR_ISA_HPP */
@@ -8,11 +8,24 @@
 #include <math.h>
 #include <float.h>
 #include "Math.hpp"
+#include "Log2Kernel.hpp"
+#include "Benchmark.hpp"
+#include "PerfCounters.hpp"
+#include "ReferenceMath.hpp"
+#include "Report.hpp"
+#include "Ulps.hpp"
+#include "ReferenceStore.hpp"
+#include "Shards.hpp"
+#include "ThreadPool.hpp"
+#include "VectorISA.hpp"
+#include <atomic>
+#include <fenv.h>
 #include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <dispatch/dispatch.h>
 
 //
 // Assignment 2:  See Math.hpp
@@ -26,6 +39,8 @@
 
 typedef float (*UnaryFunction)(float);
 typedef double (*ReferenceFunction)(double);
+typedef void (*ReferenceArrayFunction)(const float * x, double * correct, size_t count);
+typedef void (*ArrayFunction)(const float * src, float * dst, size_t count);
 
 /*! @abstract test for float equivalence. Suitable for functions for which one and only one result is allowed*/
 static inline bool IsFloatEqual( float test, float reference)
@@ -42,132 +57,459 @@ static inline bool IsFloatEqual( float test, float reference)
     return false;
 }
 
-int TestFunction( UnaryFunction testF, UnaryFunction referenceF)
+// Floor, Round and Rint are constexpr, so the compiler can check a few of the hard cases before the exhaustive tests run
+static_assert( Floor(-0.5f) == -1.0f && Floor(0x1.fffffep22f) == 0x1.fffffcp22f && Floor(-0x1.0p-149f) == -1.0f, "Floor" );
+static_assert( Round(0.5f) == 1.0f && Round(-2.5f) == -3.0f && Round(0x1.fffffep-2f) == 0.0f, "Round" );
+static_assert( Rint(0.5f) == 0.0f && Rint(2.5f) == 2.0f && Rint(3.5f) == 4.0f && Rint(0x1.000002p23f) == 0x1.000002p23f, "Rint" );
+static_assert( 0x80000000U == std::bit_cast<uint32_t>( Rint<RoundingMode::Up>(-0.75f)), "Rint keeps the sign of zero" );
+static_assert( Floor(0.5) == 0.0f && Round(2) == 2.0f && std::is_same_v<decltype(Floor(0.5)), float> &&
+               std::is_same_v<decltype(Log2(2.0)), float>, "double and int arguments still call the float functions, not the half ones" );
+
+/*! @abstract Time a unary function over a handful of typical inputs of type T. Times are per call.
+ *  @discussion Function may be a UnaryFunction or a ReferenceFunction, or for T = double, Log2D and the like. */
+template <typename T = float, typename Function>
+static Benchmark BenchmarkUnaryFunction( Function f)
+{
+    constexpr size_t kInputCount = 64;
+    struct Workload
+    {
+        Function    f;
+        T           input[kInputCount];
+        T           output[kInputCount];
+
+        inline void operator()(){ for( size_t i = 0; i < kInputCount; i++) output[i] = (T) f(input[i]); }
+    }workload;
+
+    workload.f = f;
+    for( size_t i = 0; i < kInputCount; i++)
+        workload.input[i] = T(1) + (T) i * T(0.37);
+
+    Benchmark result = BenchmarkFunctor( workload, 0.01);
+    result.meanTime /= kInputCount;
+    result.stdDeviation /= kInputCount;
+    result.stdErrorOfTheMean /= kInputCount;
+    result.minimumTime /= kInputCount;
+    return result;
+}
+
+/*! @abstract Print how long test and reference took, e.g. "(1.23 ± 0.01 ns vs. 2.34 ± 0.02 ns) " */
+static void PrintBenchmarks( const Benchmark & test, const Benchmark & reference)
+{
+    printf( "(%.3g ± %.2g %s vs. %.3g ± %.2g %s) ", test.meanTime, test.stdErrorOfTheMean, MonotonicClock::kUnits,
+                                                   reference.meanTime, reference.stdErrorOfTheMean, MonotonicClock::kUnits);
+}
+
+/*! @abstract The first failure reported by the workers of a ParallelFor
+ *  @discussion The error code and the failing input are kept together in one atomic, and only the first report sticks,
+ *              so two workers failing at once can't leave one's code with the other's input. Read it after the
+ *              ParallelFor returns. */
+class FirstFailure
+{
+private:
+    std::atomic<uint64_t>   failure;        // 0, or -code in the high 32 bits and the bits of the input in the low 32
+
+public:
+    FirstFailure() : failure(0){}
+
+    inline bool Failed() const { return 0 != failure.load( std::memory_order_relaxed); }
+
+    /*! @abstract Report a failure. code is negative: -1 for a wrong answer, -2 for a damaged reference table. */
+    inline void Fail( int code, float input)
+    {
+        union{ float f; uint32_t u; }u = {input};
+        uint64_t expected = 0;
+        failure.compare_exchange_strong( expected, (uint64_t(uint32_t(-code)) << 32) | u.u, std::memory_order_relaxed);
+    }
+
+    /*! @abstract 0 if nothing failed, else the code of the first failure */
+    inline int Code() const { return -int( failure.load( std::memory_order_relaxed) >> 32); }
+    inline float Input() const { union{ uint32_t u; float f; }u = { uint32_t( failure.load( std::memory_order_relaxed)) }; return u.f; }
+};
+
+/*! @abstract Test a function for which one and only one result is allowed, over all possible inputs.
+ *  @discussion If table is not NULL, the correct results are read from it rather than calling referenceF. */
+int TestFunction( UnaryFunction testF, UnaryFunction referenceF, const ReferenceTable * table = NULL)
 {
-    __block int result = 0;
-    __block volatile float failCase = NAN;
+    FirstFailure failure;
     
     // Iterate over all possible single precision floating-point numbers
     // The test is a bit slow so multithread in chunks of kIterationStride
     constexpr unsigned long kIterationStride = 1UL << 16;
-    dispatch_apply( (1ULL << 32) / kIterationStride,
-                   dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0),
-                   ^(size_t iteration)
+    ParallelFor( 0, (1ULL << 32) / kIterationStride, 1, [&]( size_t iteration)
     {
-        if( result )
+        if( failure.Failed() )
             return;
         
         // Find the beginning and ending values to test
         uint64_t start = iteration * kIterationStride;
         uint64_t stop = start + kIterationStride;
-        
-        for( uint64_t val = start; val < stop; val++)
+
+        constexpr size_t kBlockSize = 1024;
+        double reference[kBlockSize];
+        ReferenceCursor cursor;
+        if( table )
+            cursor = OpenReferenceCursor( table, start);
+
+        for( uint64_t block = start; block < stop; block += kBlockSize)
         {
-            // reinterpret the bits as float
-            union{ uint32_t u;  float f;}u = {uint32_t(val)};
-            
-            // Calculate our reference and test values
-            float test = testF(u.f);
-            float reference = referenceF(u.f);
-            
-            // Handle any errors
-            if( ! IsFloatEqual(test, reference))
+            if( table && ! ReadReferences( &cursor, reference, kBlockSize) )
             {
-                failCase = u.f;
-                result = -1;
+                failure.Fail( -2, NAN);
                 return;
             }
+
+            for( size_t i = 0; i < kBlockSize; i++)
+            {
+                // reinterpret the bits as float
+                union{ uint32_t u;  float f;}u = {uint32_t(block + i)};
+
+                // Calculate our reference and test values
+                float test = testF(u.f);
+                float correct = table ? (float) reference[i] : referenceF(u.f);
+
+                // Handle any errors
+                if( ! IsFloatEqual(test, correct))
+                {
+                    failure.Fail( -1, u.f);
+                    return;
+                }
+            }
         }
     });
     
-    if(result)
+    int result = failure.Code();
+    float failCase = failure.Input();
+    if( -2 == result )
+        printf( "Reference table %s is damaged\n", ReferenceTableName(table));
+    else if(result)
         printf( "Test(%a) failed: *%a vs %a\n", failCase, referenceF(failCase), testF(failCase));
+    else
+        PrintBenchmarks( BenchmarkUnaryFunction(testF), BenchmarkUnaryFunction(referenceF));
 
     return result;
 }
 
-
-static inline double FloatUlps( float test, double correct )
+/*! @abstract Test an array function against its scalar counterpart over all possible inputs. Results must be identical.
+ *  @discussion Each block is done in two calls, split at a varying offset, so that misaligned starts and partial
+ *              vectors at the end get tested along with the rest. */
+int TestArrayFunction( ArrayFunction testF, UnaryFunction referenceF)
 {
-    // Remove NaNs from consideration
-    if( isnan(correct) && isnan(test))
-        return 0;
-
-    // Infinities cause problems calculating delta next, so remove those, and any exact matches
-    if( (double) test == correct )
-        return 0;
-    
-    // Figure out the error
-    double delta = test - correct;
-    
-    // Scale the error against the correct float-point exponent
-    // Separate values into signed fraction and exponent parts
-    int referenceExp = 0;   double referenceFract = frexp(correct, &referenceExp);
-    int deltaExp = 0;       double fraction = frexp(delta, &deltaExp );
-    
-    // Calculate the correct exponent for the ulp
-    int ulpExp = FLT_MANT_DIG - (referenceExp - deltaExp);
-    //Modified Goldberg Ulp  https://inria.hal.science/inria-00070503v1/document
-    if(fabs(referenceFract) == 0.5)
-        fraction *= 2;
-    
-    // Adjust the error to the right exponent
-    return ldexp(fraction, ulpExp);
-}
+    FirstFailure failure;
 
-/*! @abstract This is for any function for which the results are allowed to be incorrectly rounded */
-int TestTranscendental( UnaryFunction testF, ReferenceFunction referenceF)
-{
-    constexpr float tolerance = 0.625f;
-    
-    __block int result = 0;
-    __block volatile float worstCase = NAN;
-    __block volatile double worstError = 0;
-    
-    // Multithread over chunks kIterationStride for improved performance
     constexpr unsigned long kIterationStride = 1UL << 16;
-    dispatch_apply( 100000000ULL / kIterationStride,
-                   dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0),
-                   ^(size_t iteration)
+    ParallelFor( 0, (1ULL << 32) / kIterationStride, 1, [&]( size_t iteration)
     {
-        // Calculate the range of values to examine
+        if( failure.Failed() )
+            return;
+
+        // Blocks are small enough to be comfortable on a worker thread stack
+        constexpr size_t kBlockSize = 1024;
+        float input[kBlockSize];
+        float test[kBlockSize];
+
         uint64_t start = iteration * kIterationStride;
         uint64_t stop = start + kIterationStride;
 
-        // Early exit if there is some serious error
-        if( result )
-            return;
-        
-        // Loop over test values
-        for( uint64_t val = start; val < stop; val++)
+        for( uint64_t block = start; block < stop; block += kBlockSize)
         {
-            // reinterpret integer bit pattern as a floating-point value
-            union{ uint32_t u;  float f;}u = {uint32_t(val)};
-            
-            // Calculate test and reference results
-            float test = testF(u.f);
-            double reference = referenceF(u.f);
-            
-            // Measure the error
-            double error = FloatUlps( test, reference );
-            if( fabs(error) > fabs(worstError))
-            { // Handle serious error cases
-                worstCase = u.f;
-                worstError = error;
-                
-                if( fabs(worstError) > tolerance )
+            for( size_t i = 0; i < kBlockSize; i++)
+            {
+                union{ uint32_t u;  float f;}u = {uint32_t(block + i)};
+                input[i] = u.f;
+            }
+
+            size_t split = (block / kBlockSize) % 37;
+            testF( input, test, split);
+            testF( input + split, test + split, kBlockSize - split);
+
+            for( size_t i = 0; i < kBlockSize; i++)
+                if( ! IsFloatEqual(test[i], referenceF(input[i])))
                 {
-                    result = -1;
+                    failure.Fail( -1, input[i]);
                     return;
                 }
+        }
+    });
+
+    int result = failure.Code();
+    if(result)
+    {
+        float x = failure.Input(), test = NAN;
+        testF( &x, &test, 1);
+        printf( "Test(%a) failed: *%a vs %a\n", x, referenceF(x), test);
+    }
+
+    return result;
+}
+
+
+/*! @abstract A function we know how to test, and what it is tested against */
+typedef struct TestedFunction
+{
+    const char *        name;
+    UnaryFunction       testF;
+    UnaryFunction       exactF;         // the one right answer, for functions like floor. NULL if some error is allowed.
+    ReferenceFunction   referenceF;     // a more precise answer, for functions allowed a little error
+    ReferenceArrayFunction referenceArrayF;     // the same a block at a time, if there is one. Faster.
+    float               tolerance;      // ulps allowed. 0 when there is only one right answer.
+    const char *        tableName;      // its reference table. Functions with the same reference share one.
+}TestedFunction;
+
+/*! @abstract Score function over every input in [start, stop), with no early exit, so the report covers the whole range.
+ *  @discussion If table is not NULL, the correct results are read from it rather than calling the reference function.
+ *              When there is only one right answer, any result that isn't bitwise identical to it fails, including
+ *              a zero of the wrong sign, which is reported as infinitely wrong.
+ *              If binades is not NULL, the results are also merged into binades[BinadeOf(input)], which must have
+ *              room for kBinadeCount reports, each initialized with a NaN worstCase. */
+static UlpReport MeasureErrors( const TestedFunction & function, uint64_t start, uint64_t stop, const ReferenceTable * table,
+                                UlpReport * binades = NULL)
+{
+    UlpReport total = {};
+    total.worstCase = NAN;
+
+    // One report per chunk, written only by the worker doing that chunk. Chunks are large enough that
+    // there aren't many reports to keep around and merge, and small enough to balance well across cores.
+    // They are aligned to a multiple of their size, so none straddles two binades.
+    constexpr uint64_t kIterationStride = 1ULL << 20;
+    static_assert( 0 == (1ULL << 23) % kIterationStride, "a chunk must fit in a binade" );
+    uint64_t alignedStart = start & ~(kIterationStride - 1);
+    size_t chunkCount = size_t((stop - alignedStart + kIterationStride - 1) / kIterationStride);
+    UlpReport * reports = (UlpReport *) calloc( chunkCount, sizeof(reports[0]));
+    if( NULL == reports )
+    {
+        total.damaged = true;
+        return total;
+    }
+
+    ParallelFor( 0, chunkCount, 1, [&]( size_t iteration)
+    {
+        // Calculate the range of values to examine
+        uint64_t chunkStart = alignedStart + iteration * kIterationStride;
+        uint64_t chunkStop = chunkStart + kIterationStride < stop ? chunkStart + kIterationStride : stop;
+        if( chunkStart < start )
+            chunkStart = start;
+
+        UlpReport report = {};
+        report.worstCase = NAN;
+
+        // Work in blocks, so the errors can be scored several at a time
+        constexpr size_t kBlockSize = 1024;
+        float input[kBlockSize];
+        float test[kBlockSize];
+        double reference[kBlockSize];
+        double error[kBlockSize];
+
+        ReferenceCursor cursor;
+        if( table )
+            cursor = OpenReferenceCursor( table, chunkStart);
+
+        for( uint64_t block = chunkStart; block < chunkStop; block += kBlockSize)
+        {
+            size_t count = size_t( chunkStop - block < kBlockSize ? chunkStop - block : kBlockSize);
+
+            if( table && ! ReadReferences( &cursor, reference, count) )
+            {
+                report.damaged = true;
+                break;
             }
+
+            // Calculate test and reference results
+            for( size_t i = 0; i < count; i++)
+            {
+                // reinterpret integer bit pattern as a floating-point value
+                union{ uint32_t u;  float f;}u = {uint32_t(block + i)};
+                input[i] = u.f;
+                test[i] = function.testF(u.f);
+            }
+            if( table )
+                ;
+            else if( function.exactF )
+                for( size_t i = 0; i < count; i++)
+                    reference[i] = function.exactF( input[i]);
+            else if( function.referenceArrayF )
+                function.referenceArrayF( input, reference, count);
+            else
+                for( size_t i = 0; i < count; i++)
+                    reference[i] = function.referenceF( input[i]);
+
+            // Measure the error
+            FloatUlpsArray( test, reference, error, count);
+            if( function.exactF )
+                for( size_t i = 0; i < count; i++)
+                    if( 0 == error[i] && ! IsFloatEqual( test[i], (float) reference[i]) )
+                        error[i] = INFINITY;
+            for( size_t i = 0; i < count; i++)
+                report.Add( input[i], error[i], function.tolerance);
         }
+
+        reports[iteration] = report;
     });
-    
-    printf( "(Worst case: %10.14f ulps @ %a: *%a vs %a) ", worstError, worstCase, referenceF(worstCase), testF(worstCase));
+
+    for( size_t i = 0; i < chunkCount; i++)
+    {
+        total.Merge( reports[i]);
+        if( binades )
+            binades[ BinadeOf( alignedStart + i * kIterationStride)].Merge( reports[i]);
+    }
+    free(reports);
+
+    return total;
+}
+
+/*! @abstract How far the reference results themselves may be off, in ulps of the float result: a few ulps of double
+ *            from the reference function, and the 2**-19 ulp rounding in the reference tables. Added to the tolerance
+ *            of tests that are held to 0.5 ulps or close to it, so they fail for real errors only. */
+static constexpr float kReferenceError = 0x1.0p-16f;
+
+/*! @abstract This is for any function for which the results are allowed to be incorrectly rounded
+ *  @discussion Tests every input in [start, stop) with no early exit, so the report covers the whole range.
+ *              Fails if any result is more than tolerance ulps off. The default range is all 2**32 float encodings.
+ *              referenceArrayF, if not NULL, is used for the sweep, and referenceF for single answers. Both should be
+ *              from ReferenceMath.hpp. If table is not NULL, the correct results are read from it instead. */
+int TestTranscendental( UnaryFunction testF, ReferenceFunction referenceF, ReferenceArrayFunction referenceArrayF, float tolerance,
+                        uint64_t start = 0, uint64_t stop = 1ULL << 32, const ReferenceTable * table = NULL)
+{
+    TestedFunction function = { "", testF, NULL, referenceF, referenceArrayF, tolerance, NULL };
+    UlpReport total = MeasureErrors( function, start, stop, table);
+
+    if( total.damaged )
+    {
+        if( table )
+            printf( "Reference table %s is damaged\n", ReferenceTableName(table));
+        else
+            printf( "Out of memory\n");
+        return -1;
+    }
+
+    int result = total.failures ? -1 : 0;
+    printf( "(Worst case: %10.14f ulps @ %a: *%a vs %a) ", total.worstError, total.worstCase, referenceF(total.worstCase), testF(total.worstCase));
+    if( 0 == result )
+        PrintBenchmarks( BenchmarkUnaryFunction(testF), BenchmarkUnaryFunction(referenceF));
+    else
+        printf( "%llu results exceed %g ulps ", (unsigned long long) total.failures, function.tolerance);
+    printf( "\n");
+    total.Print();
+
+    return result;
+}
+
+
+/*! @abstract Test a half or bfloat16 function and its array form over all 65536 encodings
+ *  @discussion The scalar function is scored against referenceF, in double, in ulps of the 16-bit result. With a
+ *              tolerance of 0 there is only one right answer, and anything not bitwise identical to it fails. The
+ *              array function has to match the scalar function bitwise. It is called in two pieces split at an odd
+ *              offset, so that misaligned starts and partial vectors get tested too. */
+template <typename T>
+static int Test16BitFunction( T (*testF)(T), void (*arrayF)(const T *, T *, size_t), ReferenceFunction referenceF, float tolerance)
+{
+    constexpr size_t kCount = 1 << 16;
+    T * input = (T *) malloc( kCount * sizeof(T));
+    T * test = (T *) malloc( kCount * sizeof(T));
+    if( NULL == input || NULL == test )
+    {
+        free(input);    free(test);
+        printf( "Out of memory\n");
+        return -1;
+    }
+
+    UlpReport report = {};
+    report.worstCase = NAN;
+    for( size_t i = 0; i < kCount; i++)
+    {
+        input[i] = Float16FromBits<T>( uint16_t(i));
+        float x = ToFloat( input[i]);
+        T result = testF( input[i]);
+        double correct = referenceF(x);
+        double error = Float16Ulps( result, correct);
+        if( 0 == tolerance && ! IsFloatEqual( ToFloat(result), ToFloat( FromFloat<T>( (float) correct))) )
+            error = INFINITY;
+        report.Add( x, error, tolerance);
+    }
+
+    int result = report.failures ? -1 : 0;
+    float worst = report.worstCase;
+    if( result )
+        printf( "(Worst case: %g ulps @ %a: *%a vs %a) %llu results exceed %g ulps\n", report.worstError, worst, referenceF(worst),
+                ToFloat( testF( FromFloat<T>(worst))), (unsigned long long) report.failures, tolerance);
+    else if( tolerance )
+        printf( "(Worst case: %8.6f ulps @ %a) ", report.worstError, worst);
+
+    constexpr size_t kSplit = 37;
+    arrayF( input, test, kSplit);
+    arrayF( input + kSplit, test + kSplit, kCount - kSplit);
+    for( size_t i = 0; i < kCount && 0 == result; i++)
+        if( Float16Bits( test[i]) != Float16Bits( testF( input[i])) )
+        {
+            printf( "Array(%a) failed: *%a vs %a\n", ToFloat( input[i]), ToFloat( testF( input[i])), ToFloat( test[i]));
+            result = -1;
+        }
+
+    free(input);
+    free(test);
+    return result;
+}
+
+/*! @abstract Test the 16-bit functions for one format */
+template <typename T>
+static int Test16BitFormat()
+{
+    typedef Float16Format<T> Format;
+    int error;
+
+    printf( "Testing %s floor...", Format::kName);
+    if( (error = Test16BitFunction<T>( Floor, FloorArray, floor, 0)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing %s round...", Format::kName);
+    if( (error = Test16BitFunction<T>( Round, RoundArray, round, 0)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing %s rint...", Format::kName);
+    if( (error = Test16BitFunction<T>( Rint, RintArray, rint, 0)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing %s log2...", Format::kName);
+    if( (error = Test16BitFunction<T>( Log2, Log2Array, ReferenceLog2, ErrorBound( Accuracy::Faithful))))
+        return error;
+    printf( "passed\n");
+
+    return 0;
+}
+
+/*! @abstract rintf in another rounding mode, the usual way: set the mode, round, and put the mode back. Rint<RoundingMode> is
+ *            tested against this. The rounding mode is per thread, so this works on the test's worker threads too. */
+template <int kFERound>
+static float RintfInMode( float x)
+{
+#pragma STDC FENV_ACCESS ON
+    // Without the pragma (GCC ignores it: use -frounding-math there) the compiler may inline rintf as x + 2**23 - 2**23,
+    // which is only right in the default rounding mode, or move it to the other side of fesetround.
+    int saved = fegetround();
+    fesetround( kFERound);
+    float result = rintf(x);
+    fesetround( saved);
     return result;
 }
 
+/*! @abstract A rounding direction we test Rint in, and the fesetround mode it should match */
+typedef struct RintInDirection
+{
+    const char *    name;
+    UnaryFunction   testF;
+    UnaryFunction   referenceF;
+    ArrayFunction   arrayF;
+}RintInDirection;
+
+static const RintInDirection kRintDirections[] =
+{
+    { "NearestEven",    Rint<RoundingMode::NearestEven>,    RintfInMode<FE_TONEAREST>,  RintArray<RoundingMode::NearestEven> },
+    { "TowardZero",     Rint<RoundingMode::TowardZero>,     RintfInMode<FE_TOWARDZERO>, RintArray<RoundingMode::TowardZero> },
+    { "Up",             Rint<RoundingMode::Up>,             RintfInMode<FE_UPWARD>,     RintArray<RoundingMode::Up> },
+    { "Down",           Rint<RoundingMode::Down>,           RintfInMode<FE_DOWNWARD>,   RintArray<RoundingMode::Down> },
+};
 
 static void DetectLeaks()
 {
@@ -184,30 +526,1321 @@ static void DetectLeaks()
 }
 
 
-int main(int argc, const char * argv[])
+/*! @abstract Print one line of the table size vs. polynomial degree comparison: accuracy over [0.5, 2), and speed. */
+template <unsigned kTableSize, unsigned kDegree>
+static void ReportLog2Variant()
 {
-    atexit( DetectLeaks );
-    int error;
-    
-    printf( "Testing floor...");
-    if( (error = TestFunction( Floor, floorf)))
-        return error;
-    printf( "passed\n");
+    typedef Log2Kernel<kTableSize, kDegree> Kernel;
+    TestedFunction function = { "log2", Kernel::Evaluate, NULL, ReferenceLog2, ReferenceLog2Array, 0.625f, "log2" };
+    UlpReport report = MeasureErrors( function, 0x3f000000, 0x40000000, NULL);
+    Benchmark time = BenchmarkUnaryFunction( Kernel::Evaluate);
 
-    printf( "Testing round...");
-    if( (error = TestFunction( Round, roundf)))
-        return error;
-    printf( "passed\n");
+    printf( "\t%4u x %2u  %6zu   2**%6.2f  %8.5f  %.3g ± %.2g %s%s\n", kTableSize, kDegree, Kernel::kTableBytes,
+            log2( Kernel::kPolynomialError), fabs(report.worstError), time.meanTime, time.stdErrorOfTheMean, MonotonicClock::kUnits,
+            report.failures ? "  fails" : "");
+}
 
-    printf( "Testing rint...");
-    if( (error = TestFunction( Rint, rintf)))
-        return error;
-    printf( "passed\n");
+/*! @abstract Compare Log2Kernel variants, to see how table size (cache footprint) trades against polynomial length */
+static void ReportLog2Variants()
+{
+    printf( "\tentries x degree  bytes  poly error  worst ulps  time\n");
+    ReportLog2Variant<16, 6>();
+    ReportLog2Variant<32, 5>();
+    ReportLog2Variant<64, 3>();
+    ReportLog2Variant<64, 4>();
+    ReportLog2Variant<128, 4>();
+    ReportLog2Variant<256, 3>();
+    ReportLog2Variant<1024, 3>();
+}
 
-    printf( "Testing log2...");
-    if( (error = TestTranscendental( Log2, log2)))
+
+#pragma mark - Reference tables
+
+// Precomputed reference results, from --references. NULL where we don't have a table and have to call the reference function.
+static ReferenceTable * gFloorReferences = NULL;
+static ReferenceTable * gRoundReferences = NULL;
+static ReferenceTable * gRintReferences = NULL;
+static ReferenceTable * gLog2References = NULL;
+static ReferenceTable * gExp2References = NULL;
+static ReferenceTable * gLogReferences = NULL;
+static ReferenceTable * gLog10References = NULL;
+static ReferenceTable * gLog1pReferences = NULL;
+static ReferenceTable * gExpm1References = NULL;
+
+static void CloseReferences()
+{
+    CloseReferenceTable( gFloorReferences);
+    CloseReferenceTable( gRoundReferences);
+    CloseReferenceTable( gRintReferences);
+    CloseReferenceTable( gLog2References);
+    CloseReferenceTable( gExp2References);
+    CloseReferenceTable( gLogReferences);
+    CloseReferenceTable( gLog10References);
+    CloseReferenceTable( gLog1pReferences);
+    CloseReferenceTable( gExpm1References);
+}
+
+/*! @abstract Open directory/name.ref if there is a complete table there. */
+static ReferenceTable * OpenReferences( const char * directory, const char * name)
+{
+    char path[1024];
+    snprintf( path, sizeof(path), "%s/%s.ref", directory, name);
+
+    ReferenceTable * table = OpenReferenceTable( path);
+    if( table && (0 != strcmp( ReferenceTableName(table), name) || ! ReferenceTableCovers( table, 0, 1ULL << 32)) )
+    {
+        CloseReferenceTable( table);
+        table = NULL;
+    }
+
+    if( NULL == table )
+        printf( "No usable reference table at %s. The %s test will compute its own.\n", path, name);
+    return table;
+}
+
+// Functions that can be tested one at a time with --function, and that have reference tables
+static const TestedFunction kTestedFunctions[] =
+{
+    { "floor",      Floor,                              floorf, NULL,           NULL,                   0.0f,   "floor" },
+    { "round",      Round,                              roundf, NULL,           NULL,                   0.0f,   "round" },
+    { "rint",       Rint,                               rintf,  NULL,           NULL,                   0.0f,   "rint" },
+    { "log2",       Log2,                               NULL,   ReferenceLog2,  ReferenceLog2Array,     ErrorBound( Accuracy::Faithful) + kReferenceError,          "log2" },
+    { "log2cr",     Log2<Accuracy::CorrectlyRounded>,   NULL,   ReferenceLog2,  ReferenceLog2Array,     ErrorBound( Accuracy::CorrectlyRounded) + kReferenceError,  "log2" },
+    { "log2fast",   Log2<Accuracy::Fast>,               NULL,   ReferenceLog2,  ReferenceLog2Array,     ErrorBound( Accuracy::Fast),                                "log2" },
+    { "exp2",       Exp2,                               NULL,   ReferenceExp2,  ReferenceExp2Array,     ErrorBound( Accuracy::Faithful) + kReferenceError,          "exp2" },
+    { "log",        Log,                                NULL,   ReferenceLog,   ReferenceLogArray,      ErrorBound( Accuracy::Faithful) + kReferenceError,          "log" },
+    { "log10",      Log10,                              NULL,   ReferenceLog10, ReferenceLog10Array,    ErrorBound( Accuracy::Faithful) + kReferenceError,          "log10" },
+    { "log1p",      Log1p,                              NULL,   ReferenceLog1p, ReferenceLog1pArray,    ErrorBound( Accuracy::Faithful) + kReferenceError,          "log1p" },
+    { "expm1",      Expm1,                              NULL,   ReferenceExpm1, ReferenceExpm1Array,    ErrorBound( Accuracy::Faithful) + kReferenceError,          "expm1" },
+};
+
+/*! @abstract The first function in kTestedFunctions that uses table name */
+static const TestedFunction * FindTableOwner( const char * name)
+{
+    for( const TestedFunction & function : kTestedFunctions )
+        if( 0 == strcmp( function.tableName, name) )
+            return &function;
+    return NULL;
+}
+
+/*! @abstract Write reference tables for all of the tests into directory. Slow, but only needs to be done once. */
+static int MakeReferences( const char * directory)
+{
+    char path[1024];
+    for( const TestedFunction & function : kTestedFunctions )
+    {
+        if( &function != FindTableOwner( function.tableName) )     // already written
+            continue;
+
+        printf( "Writing %s references...", function.tableName);  fflush(stdout);
+        snprintf( path, sizeof(path), "%s/%s.ref", directory, function.tableName);
+        if( function.exactF ? WriteReferenceTable( path, function.tableName, function.exactF)
+                            : WriteReferenceTable( path, function.tableName, function.referenceF) )
+            return -1;
+        printf( "done\n");
+    }
+
+    return 0;
+}
+
+
+#pragma mark - Sharded runs
+
+/*! @abstract Run shard number shard of shardCount of a sweep of function over [rangeStart, rangeStop).
+ *  @discussion Progress is saved to the shard file in directory every kCheckpointInterval inputs. If the file is
+ *              already there, we start from where it left off, so rerunning a finished shard does nothing.
+ *  @return 0 if the shard passed, -1 if it failed or couldn't be run */
+static int RunShard( const TestedFunction & function, uint64_t rangeStart, uint64_t rangeStop, uint32_t shard, uint32_t shardCount,
+                     const char * directory, const ReferenceTable * table)
+{
+    constexpr uint64_t kCheckpointInterval = 1ULL << 24;
+
+    ShardState state;
+    InitShard( &state, function.name, rangeStart, rangeStop, shard, shardCount, function.tolerance);
+
+    char path[1024];
+    ShardPath( path, sizeof(path), directory, &state);
+
+    ShardState saved;
+    if( 0 == ReadShard( path, &saved) )
+    {
+        if( saved.start != state.start || saved.stop != state.stop || saved.tolerance != state.tolerance )
+        {
+            printf( "%s doesn't match this shard. Delete it to start over.\n", path);
+            return -1;
+        }
+        state = saved;
+    }
+
+    printf( "%s shard %u of %u [0x%llx, 0x%llx)...", function.name, shard, shardCount,
+            (unsigned long long) state.start, (unsigned long long) state.stop);
+    if( state.next != state.start && ! ShardIsComplete( &state) )
+        printf( "resuming at 0x%llx...", (unsigned long long) state.next);
+    fflush(stdout);
+
+    // Write a checkpoint up front, so a merge can see the shard is underway
+    if( WriteShard( path, &state) )
+        return -1;
+
+    while( ! ShardIsComplete( &state) )
+    {
+        uint64_t stop = state.stop - state.next > kCheckpointInterval ? state.next + kCheckpointInterval : state.stop;
+        UlpReport slice = MeasureErrors( function, state.next, stop, table);
+        if( slice.damaged )
+        {
+            printf( "couldn't test [0x%llx, 0x%llx)\n", (unsigned long long) state.next, (unsigned long long) stop);
+            return -1;
+        }
+
+        state.report.Merge( slice);
+        state.next = stop;
+        if( WriteShard( path, &state) )
+            return -1;
+        printf( ".");  fflush(stdout);
+    }
+
+    printf( " %s (%llu failures)\n", state.report.failures ? "FAILED" : "passed", (unsigned long long) state.report.failures);
+    return state.report.failures ? -1 : 0;
+}
+
+/*! @abstract Parse "start:stop", with the numbers in any base strtoull understands, e.g. 0x3f800000:0x40000000 */
+static bool ParseRange( const char * range, uint64_t * start, uint64_t * stop)
+{
+    char * end;
+    *start = strtoull( range, &end, 0);
+    if( end == range || ':' != *end )
+        return false;
+
+    const char * second = end + 1;
+    *stop = strtoull( second, &end, 0);
+    return end != second && '\0' == *end && *start < *stop && *stop <= (1ULL << 32);
+}
+
+#pragma mark - Latency and throughput
+
+// A single time per call hides the difference between a chain of calls that each wait for the last (a recurrence, which
+// sees the latency of the function) and a stream of independent calls that overlap in the pipeline (a batch kernel, which
+// sees its throughput). These time both, in cycles per element, over a few classes of input that take different paths.
+
+static constexpr size_t kSuiteInputs = 64;
+
+/*! @abstract A set of inputs of one kind */
+typedef struct InputClass
+{
+    const char *    name;
+    float           input[kSuiteInputs];
+}InputClass;
+
+static inline float FloatFromBits( uint32_t bits){ union{ uint32_t u; float f; }u = {bits}; return u.f; }
+static inline uint32_t BitsFromFloat( float f){ union{ float f; uint32_t u; }u = {f}; return u.u; }
+
+static void MakeInputClasses( InputClass classes[4])
+{
+    classes[0].name = "normal";
+    classes[1].name = "subnormal";
+    classes[2].name = "huge integral";
+    classes[3].name = "nan / inf";
+    for( size_t i = 0; i < kSuiteInputs; i++)
+    {
+        classes[0].input[i] = 0.75f + (float) i * 0.37f;
+        classes[1].input[i] = FloatFromBits( uint32_t(i * 0x1ffff + 1) & 0x7fffffU);
+        classes[2].input[i] = ldexpf( 1.0f + (float) i / kSuiteInputs, 23 + int(i));
+        classes[3].input[i] = i & 1 ? (i & 2 ? -INFINITY : INFINITY) : (i & 2 ? -NAN : NAN);
+    }
+}
+
+/*! @abstract Independent calls: nothing stops the CPU starting the next before the last is done */
+typedef struct ThroughputWorkload
+{
+    UnaryFunction   f;
+    const float *   input;
+    float           output[kSuiteInputs];
+
+    inline void operator()(){ for( size_t i = 0; i < kSuiteInputs; i++) output[i] = f(input[i]); }
+}ThroughputWorkload;
+
+/*! @abstract Dependent calls: each input waits on the result before it
+ *  @discussion The result is folded into the next input with an AND with zero, which leaves the input unchanged, so
+ *              every class stays in its class. The compiler can't see that the mask is zero, so it can't break the
+ *              chain. The fold costs a cycle or two, which shows up in the empty function row too. */
+typedef struct LatencyWorkload
+{
+    UnaryFunction   f;
+    const float *   input;
+
+    inline float operator()()
+    {
+        uint32_t zero = 0;
+        asm volatile( "" : "+r"(zero));
+        float y = 0;
+        for( size_t i = 0; i < kSuiteInputs; i++)
+            y = f( FloatFromBits( BitsFromFloat( input[i]) | (BitsFromFloat(y) & zero)));
+        return y;
+    }
+}LatencyWorkload;
+
+/*! @abstract A benchmark of count calls (or elements), scaled to one */
+static Benchmark PerElement( Benchmark b, size_t count = kSuiteInputs)
+{
+    b.meanTime /= (double) count;
+    b.stdDeviation /= (double) count;
+    b.stdErrorOfTheMean /= (double) count;
+    b.minimumTime /= (double) count;
+    return b;
+}
+
+/*! @abstract Cycles per element, as latency and throughput, with the spread of each */
+static void BenchmarkCyclesPerElement( UnaryFunction f, const float * input, Benchmark * latency, Benchmark * throughput)
+{
+    LatencyWorkload chain = { f, input };
+    ThroughputWorkload stream = { f, input, {} };
+    *latency = PerElement( BenchmarkFunctor<LatencyWorkload, CycleClock>( chain, 0.01));
+    *throughput = PerElement( BenchmarkFunctor<ThroughputWorkload, CycleClock>( stream, 0.01));
+}
+
+/*! @abstract Cycles per element, as latency and throughput */
+static void MeasureCyclesPerElement( UnaryFunction f, const float * input, double * latency, double * throughput)
+{
+    Benchmark chain, stream;
+    BenchmarkCyclesPerElement( f, input, &chain, &stream);
+    *latency = chain.meanTime;
+    *throughput = stream.meanTime;
+}
+
+/*! @abstract A function to time, and the libm function to compare it with */
+typedef struct BenchmarkedFunction
+{
+    const char *    name;
+    UnaryFunction   testF;
+    UnaryFunction   libmF;
+}BenchmarkedFunction;
+
+static const BenchmarkedFunction kBenchmarkedFunctions[] =
+{
+    { "floor",                  Floor,                              floorf },
+    { "round",                  Round,                              roundf },
+    { "rint",                   Rint,                               rintf },
+    { "log2",                   Log2,                               log2f },
+    { "log2<CorrectlyRounded>", Log2<Accuracy::CorrectlyRounded>,   log2f },
+    { "log2<Fast>",             Log2<Accuracy::Fast>,               log2f },
+    { "exp2",                   Exp2,                               exp2f },
+    { "log",                    Log,                                logf },
+    { "log10",                  Log10,                              log10f },
+    { "log1p",                  Log1p,                              log1pf },
+    { "expm1",                  Expm1,                              expm1f },
+};
+
+static float EmptyFunction( float x){ return x; }
+
+/*! @abstract Print a latency and throughput table for each function, against libm
+ *  @discussion The functions are called through a pointer, as the array kernels' scalar paths call them, so the numbers
+ *              include the call. The empty function row at the top is that cost on its own. */
+static int RunBenchmarkSuite( const char * functionName)
+{
+    InputClass classes[4];
+    MakeInputClasses( classes);
+
+    printf( "Time per element in %s, as latency (dependent calls) and throughput (independent calls):\n\n", CycleClock::kUnits);
+    double latency, throughput;
+    MeasureCyclesPerElement( EmptyFunction, classes[0].input, &latency, &throughput);
+    printf( "empty function: %6.2f latency, %6.2f throughput\n\n", latency, throughput);
+
+    bool found = false;
+    for( const BenchmarkedFunction & function : kBenchmarkedFunctions )
+    {
+        if( functionName && strcmp( functionName, function.name) )
+            continue;
+        found = true;
+
+        printf( "%s\n", function.name);
+        printf( "                    latency            throughput\n");
+        printf( "                   ours     libm       ours     libm\n");
+        for( const InputClass & c : classes )
+        {
+            double testLatency, testThroughput, libmLatency, libmThroughput;
+            MeasureCyclesPerElement( function.testF, c.input, &testLatency, &testThroughput);
+            MeasureCyclesPerElement( function.libmF, c.input, &libmLatency, &libmThroughput);
+            printf( "  %-14s %8.2f %8.2f   %8.2f %8.2f\n", c.name, testLatency, libmLatency, testThroughput, libmThroughput);
+        }
+        printf( "\n");
+    }
+
+    return found ? 0 : -1;
+}
+
+/*! @abstract One row of the counter tables: cycles, IPC and misses, per element */
+static void PrintCounts( const char * label, const PerfCounts & counts, double elements)
+{
+    printf( "  %-22s %8.2f", label, counts.Cycles() / elements);
+    if( counts.valid[kPerfCycles] && counts.valid[kPerfInstructions] )
+        printf( " %6.2f", counts.count[kPerfInstructions] / counts.count[kPerfCycles]);
+    else
+        printf( " %6s", "n/a");
+    static const PerfEvent kMisses[] = { kPerfBranchMisses, kPerfL1DMisses, kPerfLLCMisses };
+    for( PerfEvent event : kMisses )
+        if( counts.valid[event] )
+            printf( " %12.4f", counts.count[event] / elements);
+        else
+            printf( " %12s", "n/a");
+    printf( "\n");
+}
+
+/*! @abstract Count cycles, instructions and misses for f over one input class, with independent calls */
+static void ReportCounts( const PerfCounters & counters, const char * label, UnaryFunction f, const float * input)
+{
+    ThroughputWorkload stream = { f, input, {} };
+    Benchmark time = BenchmarkFunctor<ThroughputWorkload, CycleClock>( stream, 0.01);
+    uint64_t iterationCount = time.iterationCount * 8;
+    PrintCounts( label, CountEvents( counters, stream, iterationCount), (double) iterationCount * kSuiteInputs);
+}
+
+template <unsigned kTableSize, unsigned kDegree>
+static void ReportLog2VariantCounts( const PerfCounters & counters, const float * input)
+{
+    char label[32];
+    snprintf( label, sizeof(label), "%u x %u", kTableSize, kDegree);
+    ReportCounts( counters, label, Log2Kernel<kTableSize, kDegree>::Evaluate, input);
+}
+
+/*! @abstract Hardware counters per element, for each function and input class, and for the Log2Kernel variants
+ *  @discussion Falls back to CycleClock for cycles, with the other columns n/a, where the counters can't be read. */
+static int RunCounterSuite( const char * functionName)
+{
+    InputClass classes[4];
+    MakeInputClasses( classes);
+
+    PerfCounters counters = OpenPerfCounters();
+    if( ! PerfCountersAvailable( counters) )
+        printf( "Hardware counters are not available here (no PMU, or perf_event_paranoid is too high).\n"
+                "Cycles are CycleClock %s instead.\n\n", CycleClock::kUnits);
+
+    const char * header = "                           cycles    IPC  branch miss     L1D miss     LLC miss   (per element)\n";
+    bool found = false;
+    for( const BenchmarkedFunction & function : kBenchmarkedFunctions )
+    {
+        if( functionName && strcmp( functionName, function.name) )
+            continue;
+        found = true;
+
+        printf( "%s\n%s", function.name, header);
+        for( const InputClass & c : classes )
+            ReportCounts( counters, c.name, function.testF, c.input);
+        printf( "  libm\n");
+        for( const InputClass & c : classes )
+            ReportCounts( counters, c.name, function.libmF, c.input);
+        printf( "\n");
+    }
+
+    if( NULL == functionName || 0 == strcmp( functionName, "log2") )
+    {
+        found = true;
+        printf( "log2 variants (entries x degree), normal inputs\n%s", header);
+        ReportLog2VariantCounts<16, 6>( counters, classes[0].input);
+        ReportLog2VariantCounts<32, 5>( counters, classes[0].input);
+        ReportLog2VariantCounts<64, 3>( counters, classes[0].input);
+        ReportLog2VariantCounts<64, 4>( counters, classes[0].input);
+        ReportLog2VariantCounts<128, 4>( counters, classes[0].input);
+        ReportLog2VariantCounts<256, 3>( counters, classes[0].input);
+        ReportLog2VariantCounts<1024, 3>( counters, classes[0].input);
+        printf( "\n");
+    }
+
+    ClosePerfCounters( &counters);
+    return found ? 0 : -1;
+}
+
+
+#pragma mark - Flush to zero
+
+/*! @abstract An FTZ array function, the plain one it is a version of, and how to test it */
+typedef struct FlushToZeroFunction
+{
+    const char *        name;
+    ArrayFunction       ftzF;
+    ArrayFunction       arrayF;
+    ReferenceFunction   referenceF;
+    float               tolerance;      // 0 when there is only one right answer
+}FlushToZeroFunction;
+
+static constexpr float kFaithfulTolerance = ErrorBound( Accuracy::Faithful) + kReferenceError;
+static const FlushToZeroFunction kFlushToZeroFunctions[] =
+{
+    { "floor",  FloorArrayFTZ,  FloorArray,     floor,          0 },
+    { "round",  RoundArrayFTZ,  RoundArray,     round,          0 },
+    { "rint",   RintArrayFTZ,   RintArray,      rint,           0 },
+    { "log2",   Log2ArrayFTZ,   Log2Array,      ReferenceLog2,  kFaithfulTolerance },
+    { "exp2",   Exp2ArrayFTZ,   Exp2Array,      ReferenceExp2,  kFaithfulTolerance },
+    { "log",    LogArrayFTZ,    LogArray,       ReferenceLog,   kFaithfulTolerance },
+    { "log10",  Log10ArrayFTZ,  Log10Array,     ReferenceLog10, kFaithfulTolerance },
+    { "log1p",  Log1pArrayFTZ,  Log1pArray,     ReferenceLog1p, kFaithfulTolerance },
+    { "expm1",  Expm1ArrayFTZ,  Expm1Array,     ReferenceExpm1, kFaithfulTolerance },
+};
+
+/*! @abstract What an FTZ function should return, given what the plain one should: a result that rounds to a subnormal float is a zero of the same sign */
+static inline double FlushReference( double correct)
+{
+    float f = (float) correct;
+    return 0 != f && fabsf(f) < FLT_MIN ? copysign( 0.0, correct) : correct;
+}
+
+/*! @abstract Test an FTZ array function over all possible inputs, against the reference with its input and result flushed
+ *  @discussion This is the harness's flush to zero mode: the only differences from the usual answers it expects are the
+ *              ones the FTZ functions promise, on subnormal inputs and results. */
+static int TestFlushToZero( const FlushToZeroFunction & function)
+{
+    constexpr uint64_t kIterationStride = 1ULL << 20;
+    constexpr size_t kChunkCount = size_t( (1ULL << 32) / kIterationStride);
+    UlpReport * reports = (UlpReport *) calloc( kChunkCount, sizeof(reports[0]));
+    if( NULL == reports )
+    {
+        printf( "Out of memory\n");
+        return -1;
+    }
+
+    ParallelFor( 0, kChunkCount, 1, [&]( size_t iteration)
+    {
+        UlpReport report = {};
+        report.worstCase = NAN;
+
+        constexpr size_t kBlockSize = 1024;
+        float input[kBlockSize];
+        float test[kBlockSize];
+        double reference[kBlockSize];
+        double error[kBlockSize];
+
+        uint64_t start = iteration * kIterationStride;
+        for( uint64_t block = start; block < start + kIterationStride; block += kBlockSize)
+        {
+            for( size_t i = 0; i < kBlockSize; i++)
+            {
+                union{ uint32_t u;  float f;}u = {uint32_t(block + i)};
+                input[i] = u.f;
+                reference[i] = FlushReference( function.referenceF( FlushSubnormal(u.f)));
+            }
+            function.ftzF( input, test, kBlockSize);
+
+            FloatUlpsArray( test, reference, error, kBlockSize);
+            for( size_t i = 0; i < kBlockSize; i++)
+            {
+                if( 0 == function.tolerance && 0 == error[i] && ! IsFloatEqual( test[i], (float) reference[i]) )
+                    error[i] = INFINITY;
+                report.Add( input[i], error[i], function.tolerance);
+            }
+        }
+
+        reports[iteration] = report;
+    });
+
+    UlpReport total = {};
+    total.worstCase = NAN;
+    for( size_t i = 0; i < kChunkCount; i++)
+        total.Merge( reports[i]);
+    free(reports);
+
+    float x = total.worstCase, test = NAN;
+    function.ftzF( &x, &test, 1);
+    if( function.tolerance || total.failures )
+        printf( "(Worst case: %10.14f ulps @ %a: *%a vs %a) ", total.worstError, x, FlushReference( function.referenceF( FlushSubnormal(x))), test);
+    if( total.failures )
+        printf( "%llu results exceed %g ulps\n", (unsigned long long) total.failures, function.tolerance);
+    return total.failures ? -1 : 0;
+}
+
+static int TestFlushToZeroFunctions(void)
+{
+    int error = 0;
+    printf( "Testing %s FTZ array kernels:\n", ArrayKernelISA());
+    for( const FlushToZeroFunction & function : kFlushToZeroFunctions )
+    {
+        printf( "\t%s...", function.name);
+        if( (error = TestFlushToZero( function)))
+            return error;
+        printf( "passed\n");
+    }
+    return error;
+}
+
+/*! @abstract dst = f(src) over a buffer, for timing the array functions */
+typedef struct ArrayWorkload
+{
+    ArrayFunction   f;
+    const float *   input;
+    float *         output;
+    size_t          count;
+
+    inline void operator()(){ f( input, output, count); }
+}ArrayWorkload;
+
+/*! @abstract How much slower each array function is on subnormal inputs than normal ones, with and without FTZ */
+static void ReportSubnormalCost(void)
+{
+    constexpr size_t kCount = 1024;
+    static float normals[kCount], subnormals[kCount], output[kCount];
+    for( size_t i = 0; i < kCount; i++)
+    {
+        normals[i] = 0.75f + (float)(i % 256) * 0.37f;
+        subnormals[i] = FloatFromBits( uint32_t(i * 0x1ffff + 1) & 0x7fffffU);
+    }
+
+    printf( "Time per element in %s, over %zu normal or subnormal inputs:\n\n", CycleClock::kUnits, kCount);
+    printf( "               plain                          FTZ\n");
+    printf( "         normal  subnormal  slowdown    normal  subnormal  slowdown\n");
+    for( const FlushToZeroFunction & function : kFlushToZeroFunctions )
+    {
+        double time[2][2];
+        ArrayFunction f[2] = { function.arrayF, function.ftzF };
+        const float * input[2] = { normals, subnormals };
+        for( int i = 0; i < 2; i++)
+            for( int j = 0; j < 2; j++)
+            {
+                ArrayWorkload work = { f[i], input[j], output, kCount };
+                time[i][j] = BenchmarkFunctor<ArrayWorkload, CycleClock>( work, 0.01).meanTime / kCount;
+            }
+
+        printf( "%-6s %8.2f %10.2f %8.1fx  %8.2f %10.2f %8.1fx\n", function.name, time[0][0], time[0][1], time[0][1] / time[0][0],
+                time[1][0], time[1][1], time[1][1] / time[1][0]);
+    }
+}
+
+
+#pragma mark - Conversion to integers
+
+static_assert( RintToInt32(2.5f) == 2 && RintToInt32(-3.5f) == -4 && FloorToInt32(-0x1.0p-149f) == -1 && RoundToInt32(-2.5f) == -3 &&
+               RintToInt32(0x1.0p31f) == INT32_MAX && FloorToInt32(-0x1.0p40f) == INT32_MIN && RoundToInt64(0x1.0p63f) == INT64_MAX &&
+               RintToInt32(NAN) == 0 && FloorToInt64(-INFINITY) == INT64_MIN, "float to integer conversions saturate" );
+
+static long long FloorfToLongLong( float x){ return (long long) floorf(x); }
+
+/*! @abstract libm's answer, saturated as ours are. lrintf and friends leave out of range and NaN results unspecified
+ *            (x86 gives the smallest long), so those we fill in ourselves. Every float out of Int's range is outside it
+ *            before rounding too, since floats that large are integers. */
+template <typename Int, long long (*F)(float)>
+static Int SaturatedLibm( float x)
+{
+    constexpr float kLimit = -(float) std::numeric_limits<Int>::min();
+    if( isnan(x) )
+        return 0;
+    if( x >= kLimit )
+        return std::numeric_limits<Int>::max();
+    if( x < -kLimit )
+        return std::numeric_limits<Int>::min();
+    return (Int) F(x);
+}
+
+/*! @abstract A float to integer conversion we test, and the libm function it should agree with */
+template <typename Int>
+struct IntConversion
+{
+    const char *    name;
+    Int             (*testF)(float);
+    void            (*arrayF)(const float * src, Int * dst, size_t count);
+    Int             (*referenceF)(float);
+};
+
+static const IntConversion<int32_t> kInt32Conversions[] =
+{
+    { "RintToInt32",    RintToInt32,    RintToInt32Array,   SaturatedLibm<int32_t, llrintf> },
+    { "FloorToInt32",   FloorToInt32,   FloorToInt32Array,  SaturatedLibm<int32_t, FloorfToLongLong> },
+    { "RoundToInt32",   RoundToInt32,   RoundToInt32Array,  SaturatedLibm<int32_t, llroundf> },
+};
+
+static const IntConversion<int64_t> kInt64Conversions[] =
+{
+    { "RintToInt64",    RintToInt64,    RintToInt64Array,   SaturatedLibm<int64_t, llrintf> },
+    { "FloorToInt64",   FloorToInt64,   FloorToInt64Array,  SaturatedLibm<int64_t, FloorfToLongLong> },
+    { "RoundToInt64",   RoundToInt64,   RoundToInt64Array,  SaturatedLibm<int64_t, llroundf> },
+};
+
+/*! @abstract dst = f(src) over a buffer, for timing a conversion */
+template <typename Int, typename Function>
+struct ConversionWorkload
+{
+    Function        f;
+    const float *   input;
+    Int *           output;
+    size_t          count;
+
+    inline void operator()(){ f( input, output, count); }
+};
+
+/*! @abstract Test a conversion and its array form against libm over every float. Both must give libm's answer exactly.
+ *  @discussion Blocks are split for the array function as in TestArrayFunction. Then the array form is timed against
+ *              what it replaces, rounding and converting an element at a time. */
+template <typename Int>
+static int TestIntConversion( const IntConversion<Int> & conversion)
+{
+    FirstFailure failure;
+
+    constexpr unsigned long kIterationStride = 1UL << 16;
+    ParallelFor( 0, (1ULL << 32) / kIterationStride, 1, [&]( size_t iteration)
+    {
+        if( failure.Failed() )
+            return;
+
+        constexpr size_t kBlockSize = 1024;
+        float input[kBlockSize];
+        Int test[kBlockSize];
+
+        uint64_t start = iteration * kIterationStride;
+        uint64_t stop = start + kIterationStride;
+
+        for( uint64_t block = start; block < stop; block += kBlockSize)
+        {
+            for( size_t i = 0; i < kBlockSize; i++)
+                input[i] = FloatFromBits( uint32_t(block + i));
+
+            size_t split = (block / kBlockSize) % 37;
+            conversion.arrayF( input, test, split);
+            conversion.arrayF( input + split, test + split, kBlockSize - split);
+
+            for( size_t i = 0; i < kBlockSize; i++)
+            {
+                Int correct = conversion.referenceF( input[i]);
+                if( test[i] != correct || conversion.testF( input[i]) != correct )
+                {
+                    failure.Fail( -1, input[i]);
+                    return;
+                }
+            }
+        }
+    });
+
+    int result = failure.Code();
+    if( result )
+    {
+        float x = failure.Input();
+        Int test = 0;
+        conversion.arrayF( &x, &test, 1);
+        printf( "Test(%a) failed: *%lld vs %lld (array %lld)\n", x, (long long) conversion.referenceF(x), (long long) conversion.testF(x),
+                (long long) test);
+        return result;
+    }
+
+    constexpr size_t kCount = 1024;
+    static float input[kCount];
+    static Int output[kCount];
+    for( size_t i = 0; i < kCount; i++)
+        input[i] = ldexpf( 0.75f + (float)(i % 256) * 0.37f, int(i % 23) - 4) * (i & 1 ? -1.0f : 1.0f);
+
+    auto elementwise = [referenceF = conversion.referenceF]( const float * src, Int * dst, size_t count)
+    {
+        for( size_t i = 0; i < count; i++)
+            dst[i] = referenceF( src[i]);
+    };
+    ConversionWorkload<Int, decltype(conversion.arrayF)> work = { conversion.arrayF, input, output, kCount };
+    ConversionWorkload<Int, decltype(elementwise)> referenceWork = { elementwise, input, output, kCount };
+    PrintBenchmarks( PerElement( BenchmarkFunctor( work, 0.01), kCount), PerElement( BenchmarkFunctor( referenceWork, 0.01), kCount));
+    return 0;
+}
+
+/*! @abstract Test every float to integer conversion, over every input */
+static int TestIntConversions(void)
+{
+    int error = 0;
+    printf( "Testing float to integer conversions against libm (array vs. an element at a time):\n");
+    for( const IntConversion<int32_t> & conversion : kInt32Conversions )
+    {
+        printf( "\t%s...", conversion.name);
+        if( (error = TestIntConversion( conversion)))
+            return error;
+        printf( "passed\n");
+    }
+    for( const IntConversion<int64_t> & conversion : kInt64Conversions )
+    {
+        printf( "\t%s...", conversion.name);
+        if( (error = TestIntConversion( conversion)))
+            return error;
+        printf( "passed\n");
+    }
+    return error;
+}
+
+
+#pragma mark - Double precision
+
+//  There are 2**64 doubles, far too many to try them all, so the double functions are tested two ways: on a corpus of
+//  hard cases, where bugs in this kind of code live, and on a long random sample. The corpus has the specials, the
+//  edges of every binade, half-way cases for the rounding functions, the top of the range where doubles stop having
+//  a fraction, and the neighborhood of 1, where log2 is small and loses the most to cancellation. It does not have
+//  the published worst cases for correctly rounded log2 (Lefèvre and Muller), which would be worth adding.
+//
+//  Log2D is scored against Log2Reference, which is good to about 2**-100, so an error can be measured as 0.5001 ulps
+//  rather than rounded to 0 or 1 by the reference. Every array function is held to its scalar function, bit for bit.
+
+/*! @abstract A double function, its array form, and how to score it */
+typedef struct DoubleFunction
+{
+    const char *    name;
+    double          (*testF)(double);
+    void            (*arrayF)(const double * src, double * dst, size_t count);
+    DoubleDouble    (*referenceF)(double);
+    double          tolerance;          // 0 when there is only one right answer
+}DoubleFunction;
+
+static DoubleDouble FloorReferenceD( double x){ return DoubleDouble{ floor(x), 0 }; }
+static DoubleDouble RoundReferenceD( double x){ return DoubleDouble{ round(x), 0 }; }
+static DoubleDouble RintReferenceD( double x){ return DoubleDouble{ rint(x), 0 }; }
+
+static const DoubleFunction kDoubleFunctions[] =
+{
+    { "floor",  FloorD, FloorArray, FloorReferenceD,    0 },
+    { "round",  RoundD, RoundArray, RoundReferenceD,    0 },
+    { "rint",   RintD,  RintArray,  RintReferenceD,     0 },
+    { "log2",   Log2D,  Log2Array,  Log2Reference,      0.51 },
+};
+
+static constexpr uint64_t kDefaultDoubleSamples = 10000000000ULL;
+
+static inline double DoubleFromBits( uint64_t bits){ union{ uint64_t u; double d; }u = {bits}; return u.d; }
+static inline uint64_t BitsFromDouble( double d){ union{ double d; uint64_t u; }u = {d}; return u.u; }
+
+/*! @abstract IsFloatEqual for doubles: the same bits, or both NaN */
+static inline bool IsDoubleEqual( double test, double reference)
+{
+    return BitsFromDouble(test) == BitsFromDouble(reference) || (isnan(test) && isnan(reference));
+}
+
+/*! @abstract The hard cases, each with its negative. Returns how many were written, at most capacity. */
+static size_t MakeDoubleHardCases( double * cases, size_t capacity)
+{
+    size_t n = 0;
+    auto add = [&]( uint64_t bits)
+    {
+        if( n + 2 <= capacity )
+        {
+            cases[n++] = DoubleFromBits( bits);
+            cases[n++] = DoubleFromBits( bits ^ 0x8000000000000000ULL);
+        }
+    };
+
+    // Zeros, the smallest and largest subnormals, DBL_MIN, DBL_MAX, infinities, quiet and signaling NaNs with payloads
+    const uint64_t specials[] = { 0, 1, 2, 0x000fffffffffffffULL, 0x0010000000000000ULL, 0x7fefffffffffffffULL, 0x7ff0000000000000ULL,
+                                  0x7ff8000000000000ULL, 0x7ff8000000000001ULL, 0x7ff0000000000001ULL, 0x7ff7ffffffffffffULL };
+    for( uint64_t bits : specials )
+        add( bits);
+
+    // Every binade: its first value and the one just below it, and the middle and last
+    for( uint64_t exponent = 1; exponent < 0x7ff; exponent++)
+    {
+        add( exponent << 52);
+        add( (exponent << 52) - 1);
+        add( (exponent << 52) + 1);
+        add( (exponent << 52) | 0x0008000000000000ULL);
+        add( (exponent << 52) | 0x000fffffffffffffULL);
+    }
+
+    // Half-way cases and their neighbors among the small integers, and at the top of the range where there are still fractions
+    for( int k = 0; k < 1024; k++)
+        for( int d = -1; d <= 1; d++)
+            add( BitsFromDouble( (double) k + 0.5) + uint64_t(d));
+    for( double x : { 0x1.0p50, 0x1.0p51, 0x1.0p52, 0x1.0p53 } )
+        for( int d = -16; d <= 16; d++)
+        {
+            add( BitsFromDouble(x) + uint64_t(d));
+            add( BitsFromDouble(x + 0.5) + uint64_t(d));
+        }
+
+    // Around 1, where log2 is tiny: 1 +- a few thousand ulps, and 1 +- 2**-e and its neighbors
+    for( int d = -4096; d <= 4096; d++)
+        add( BitsFromDouble(1.0) + uint64_t(d));
+    for( int e = 1; e <= 60; e++)
+        for( int d = -2; d <= 2; d++)
+        {
+            add( BitsFromDouble( 1.0 + ldexp( 1.0, -e)) + uint64_t(d));
+            add( BitsFromDouble( 1.0 - ldexp( 1.0, -e)) + uint64_t(d));
+        }
+
+    return n;
+}
+
+/*! @abstract Random sample i of the sweep: SplitMix64 of i, so any chunk can start anywhere and every run sees the same numbers
+ *  @discussion Half are raw encodings, to cover everything including NaNs and subnormals. The other half have exponents in
+ *              [-12, 60), where the rounding functions have work to do and log2 is most often used. */
+static inline double DoubleSample( uint64_t i)
+{
+    uint64_t z = (i + 1) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z ^= z >> 31;
+
+    if( z & 1 )
+        return DoubleFromBits(z);
+    uint64_t exponent = uint64_t(1023 - 12) + (z >> 1) % 72;
+    return DoubleFromBits( (z & 0x800fffffffffffffULL) | (exponent << 52));
+}
+
+/*! @abstract Score a block of inputs: the scalar function against the reference, and the array function against the scalar
+ *  @discussion The array function is called in two pieces, split at an odd place, so both the vector loop and the tail run.
+ *              An array result that isn't bitwise identical to the scalar one is infinitely wrong, as is a zero of the wrong
+ *              sign from a function with only one right answer. */
+static void ScoreDoubleBlock( const DoubleFunction & function, const double * input, size_t count, DoubleUlpReport * report)
+{
+    constexpr size_t kBlockSize = 1024;
+    double test[kBlockSize], array[kBlockSize];
+    size_t split = count < 37 ? count : 37;
+    function.arrayF( input, array, split);
+    function.arrayF( input + split, array + split, count - split);
+
+    for( size_t i = 0; i < count; i++)
+    {
+        test[i] = function.testF( input[i]);
+        DoubleDouble correct = function.referenceF( input[i]);
+        double error = DoubleUlps( test[i], correct.hi, correct.lo);
+        if( 0 == function.tolerance && 0 == error && ! IsDoubleEqual( test[i], correct.hi) )
+            error = INFINITY;
+        if( ! IsDoubleEqual( array[i], test[i]) )
+            error = INFINITY;
+        report->Add( input[i], error, function.tolerance);
+    }
+}
+
+/*! @abstract Test a double function on the hard cases, then on samples random inputs, with no early exit */
+static int TestDoubleFunction( const DoubleFunction & function, const double * hardCases, size_t hardCaseCount, uint64_t samples)
+{
+    constexpr size_t kBlockSize = 1024;
+    constexpr uint64_t kIterationStride = 1ULL << 20;
+    size_t chunkCount = size_t( (samples + kIterationStride - 1) / kIterationStride);
+    DoubleUlpReport * reports = (DoubleUlpReport *) calloc( chunkCount + 1, sizeof(reports[0]));
+    if( NULL == reports )
+    {
+        printf( "Out of memory\n");
+        return -1;
+    }
+
+    DoubleUlpReport & hard = reports[chunkCount];
+    hard.worstCase = NAN;
+    for( size_t i = 0; i < hardCaseCount; i += kBlockSize)
+        ScoreDoubleBlock( function, hardCases + i, hardCaseCount - i < kBlockSize ? hardCaseCount - i : kBlockSize, &hard);
+
+    ParallelFor( 0, chunkCount, 1, [&]( size_t iteration)
+    {
+        DoubleUlpReport report = {};
+        report.worstCase = NAN;
+
+        uint64_t chunkStart = iteration * kIterationStride;
+        uint64_t chunkStop = chunkStart + kIterationStride < samples ? chunkStart + kIterationStride : samples;
+        double input[kBlockSize];
+        for( uint64_t block = chunkStart; block < chunkStop; block += kBlockSize)
+        {
+            size_t count = size_t( chunkStop - block < kBlockSize ? chunkStop - block : kBlockSize);
+            for( size_t i = 0; i < count; i++)
+                input[i] = DoubleSample( block + i);
+            ScoreDoubleBlock( function, input, count, &report);
+        }
+
+        reports[iteration] = report;
+    });
+
+    DoubleUlpReport total = {};
+    total.worstCase = NAN;
+    for( size_t i = 0; i <= chunkCount; i++)
+        total.Merge( reports[i]);
+    free(reports);
+
+    double x = total.worstCase, array = NAN;
+    function.arrayF( &x, &array, 1);
+    DoubleDouble correct = function.referenceF(x);
+    if( function.tolerance || total.failures )
+        printf( "(Worst case: %10.14f ulps @ %a: *%a + %a vs %a, array %a) ", total.worstError, x, correct.hi, correct.lo, function.testF(x), array);
+    if( total.failures )
+    {
+        printf( "%llu results exceed %g ulps\n", (unsigned long long) total.failures, function.tolerance);
+        total.Print();
+    }
+    return total.failures ? -1 : 0;
+}
+
+/*! @abstract Test every double function on the hard cases and samples random inputs each, and time Log2D against log2 */
+static int TestDoubleFunctions( uint64_t samples)
+{
+    constexpr size_t kMaxHardCases = 65536;
+    double * hardCases = (double *) malloc( kMaxHardCases * sizeof(hardCases[0]));
+    if( NULL == hardCases )
+    {
+        printf( "Out of memory\n");
+        return -1;
+    }
+    size_t hardCaseCount = MakeDoubleHardCases( hardCases, kMaxHardCases);
+
+    int error = 0;
+    printf( "Testing double precision, %zu hard cases and %llu random inputs each, %s array kernels:\n", hardCaseCount,
+            (unsigned long long) samples, VectorISAName( GetVectorISA()));
+    for( const DoubleFunction & function : kDoubleFunctions )
+    {
+        printf( "\t%s...", function.name);
+        if( (error = TestDoubleFunction( function, hardCases, hardCaseCount, samples)))
+            break;
+        printf( "passed\n");
+    }
+    free( hardCases);
+    if( error )
+        return error;
+
+    printf( "\tLog2D vs. log2: ");
+    PrintBenchmarks( BenchmarkUnaryFunction<double>( Log2D), BenchmarkUnaryFunction<double>( (double (*)(double)) log2));
+    printf( "\n");
+    return 0;
+}
+
+
+#pragma mark - Reports
+
+/*! @abstract Measure the accuracy and speed of each function in kTestedFunctions (or just the one called functionName)
+ *            over [rangeStart, rangeStop), and save them as a JSON report at path. See Report.hpp.
+ *  @discussion The sweeps are the ones TestFunction and TestTranscendental do, without stopping at the first failure, so
+ *              the histograms cover every input. Speed is cycles per element on normal inputs, as in --benchmark.
+ *  @return 0 if every function passed and the report was written, -1 otherwise */
+static int WriteReports( const char * path, const char * functionName, uint64_t rangeStart, uint64_t rangeStop,
+                         const char * referenceDirectory)
+{
+    size_t count = 0;
+    FunctionReport * reports = (FunctionReport *) calloc( sizeof(kTestedFunctions) / sizeof(kTestedFunctions[0]), sizeof(reports[0]));
+    if( NULL == reports )
+    {
+        printf( "Out of memory\n");
+        return -1;
+    }
+
+    InputClass classes[4];
+    MakeInputClasses( classes);
+
+    int result = 0;
+    for( const TestedFunction & function : kTestedFunctions )
+    {
+        if( functionName && strcmp( functionName, function.name) )
+            continue;
+
+        printf( "Measuring %s...", function.name);     fflush(stdout);
+        FunctionReport & report = reports[count++];
+        strncpy( report.name, function.name, sizeof(report.name) - 1);
+        report.rangeStart = rangeStart;
+        report.rangeStop = rangeStop;
+        report.tolerance = function.tolerance;
+        report.exact = NULL != function.exactF;
+        for( UlpReport & binade : report.binades )
+            binade.worstCase = NAN;
+
+        ReferenceTable * table = referenceDirectory ? OpenReferences( referenceDirectory, function.tableName) : NULL;
+        report.total = MeasureErrors( function, rangeStart, rangeStop, table, report.binades);
+        CloseReferenceTable( table);
+        BenchmarkCyclesPerElement( function.testF, classes[0].input, &report.latency, &report.throughput);
+
+        if( report.total.damaged )
+        {
+            printf( "couldn't be tested\n");
+            result = -1;
+        }
+        else if( report.total.failures )
+        {
+            printf( "FAILED  %llu results exceed %g ulps\n", (unsigned long long) report.total.failures, function.tolerance);
+            result = -1;
+        }
+        else
+            printf( "passed (worst case %.6g ulps, %.2f %s per element)\n", report.total.worstError,
+                    report.throughput.meanTime, CycleClock::kUnits);
+    }
+
+    if( 0 == count )
+    {
+        printf( "No function called %s\n", functionName);
+        result = -1;
+    }
+    else if( WriteReport( path, reports, count) )
+        result = -1;
+    else
+        printf( "Wrote %s\n", path);
+
+    free(reports);
+    return result;
+}
+
+
+static void PrintUsage( const char * tool)
+{
+    printf( "Usage: %s [--make-references <directory>] [--references <directory>]\n", tool);
+    printf( "       %s --function <name> [--range <start>:<stop>] [--shards <N> [--shard <k>]] [--output <directory>] [--references <directory>]\n", tool);
+    printf( "       %s --merge <directory>\n", tool);
+    printf( "       %s --benchmark [<name>]\n", tool);
+    printf( "       %s --counters [<name>]\n", tool);
+    printf( "       %s --subnormal-cost\n", tool);
+    printf( "       %s --flush-to-zero\n", tool);
+    printf( "       %s --double [<samples>]\n", tool);
+    printf( "       %s --convert\n", tool);
+    printf( "       %s --report <file.json> [--function <name>] [--range <start>:<stop>] [--references <directory>]\n", tool);
+    printf( "       %s --compare <baseline.json> <current.json>\n", tool);
+    printf( "    --make-references   compute the reference results for every test and save them in <directory>, then quit\n");
+    printf( "    --references        read reference results from <directory> rather than computing them\n");
+    printf( "    --function          test just this function (floor, round, rint, log2, log2cr, log2fast,\n"
+            "                        exp2, log, log10, log1p or expm1) and report every error, then quit\n");
+    printf( "    --range             test the float encodings [start, stop). Default 0:0x100000000, i.e. all of them.\n");
+    printf( "    --shards            split the range into N shards, saving progress for each in its own file. Default 1.\n");
+    printf( "    --shard             only run shard k, 0 <= k < N. Default: run them all, one after another.\n");
+    printf( "    --output            where shard files go. Default: the current directory.\n");
+    printf( "    --merge             combine the shard files in <directory> into one report per sweep, then quit\n");
+    printf( "    --benchmark         time every function (or just <name>, e.g. log2<Fast>) against libm, in cycles per element,\n"
+            "                        for dependent and independent calls over normal, subnormal, huge and nan / inf inputs, then quit\n");
+    printf( "    --counters          like --benchmark, but report IPC and branch, L1D and LLC misses per element from the\n"
+            "                        hardware counters (Linux perf_event_open), with the Log2 variants too, then quit\n");
+    printf( "    --subnormal-cost    time the array functions and their FTZ forms on normal and on subnormal inputs, then quit\n");
+    printf( "    --flush-to-zero     test the FTZ array functions over every input, expecting subnormals to be flushed, then quit\n");
+    printf( "    --double            test FloorD, RoundD, RintD and Log2D and their array forms on the hard cases and <samples>\n"
+            "                        random inputs each (default 1e10), then quit. Also part of the full run.\n");
+    printf( "    --convert           test RintToInt32, FloorToInt64 and the other float to integer conversions and their array forms\n"
+            "                        against libm over every input, then quit. Also part of the full run.\n");
+    printf( "    --report            measure every function (or just --function) over the range, with no early exit, and write the\n"
+            "                        ulp histograms, worst cases per binade and cycles per element to <file.json>, then quit\n");
+    printf( "    --compare           print the significant slowdowns and accuracy changes from one report to another, then quit.\n"
+            "                        Exits with 1 if anything got worse.\n");
+    printf( "Environment:\n");
+    printf( "    THREAD_POOL_WORKERS how many threads the sweeps use. Default: one per core.\n");
+    printf( "    THREAD_POOL_PIN     set to 1 to pin each of them to its own core (Linux only)\n");
+}
+
+
+int main(int argc, const char * argv[])
+{
+    atexit( DetectLeaks );
+    atexit( CloseReferences );      // atexit runs these in reverse order, so tables are closed before looking for leaks
+    int error;
+
+    const char * referenceDirectory = NULL;
+    const char * functionName = NULL;
+    const char * reportPath = NULL;
+    const char * outputDirectory = ".";
+    uint64_t rangeStart = 0, rangeStop = 1ULL << 32;
+    unsigned long shardCount = 1;
+    long shard = -1;                // all of them
+    for( int i = 1; i < argc; i++)
+    {
+        bool hasValue = i + 1 < argc;
+        if( 0 == strcmp( argv[i], "--make-references") && hasValue )
+            return MakeReferences( argv[++i]);
+        else if( 0 == strcmp( argv[i], "--merge") && hasValue )
+            return MergeShards( argv[++i]);
+        else if( 0 == strcmp( argv[i], "--counters") )
+        {
+            if( 0 == (error = RunCounterSuite( hasValue ? argv[i+1] : NULL)) )
+                return 0;
+            PrintUsage( argv[0]);
+            return error;
+        }
+        else if( 0 == strcmp( argv[i], "--subnormal-cost") )
+        {
+            ReportSubnormalCost();
+            return 0;
+        }
+        else if( 0 == strcmp( argv[i], "--flush-to-zero") )
+            return TestFlushToZeroFunctions();
+        else if( 0 == strcmp( argv[i], "--convert") )
+            return TestIntConversions();
+        else if( 0 == strcmp( argv[i], "--double") )
+            return TestDoubleFunctions( hasValue ? (uint64_t) strtod( argv[i+1], NULL) : kDefaultDoubleSamples);
+        else if( 0 == strcmp( argv[i], "--compare") && i + 2 < argc )
+            return CompareReports( argv[i+1], argv[i+2]);
+        else if( 0 == strcmp( argv[i], "--report") && hasValue )
+            reportPath = argv[++i];
+        else if( 0 == strcmp( argv[i], "--benchmark") )
+        {
+            if( 0 == (error = RunBenchmarkSuite( hasValue ? argv[i+1] : NULL)) )
+                return 0;
+            PrintUsage( argv[0]);
+            return error;
+        }
+        else if( 0 == strcmp( argv[i], "--references") && hasValue )
+            referenceDirectory = argv[++i];
+        else if( 0 == strcmp( argv[i], "--function") && hasValue )
+            functionName = argv[++i];
+        else if( 0 == strcmp( argv[i], "--output") && hasValue )
+            outputDirectory = argv[++i];
+        else if( 0 == strcmp( argv[i], "--range") && hasValue && ParseRange( argv[i+1], &rangeStart, &rangeStop) )
+            i++;
+        else if( 0 == strcmp( argv[i], "--shards") && hasValue && (shardCount = strtoul( argv[i+1], NULL, 0)) >= 1 &&
+                 shardCount <= UINT32_MAX )
+            i++;
+        else if( 0 == strcmp( argv[i], "--shard") && hasValue && (shard = strtol( argv[i+1], NULL, 0)) >= 0 )
+            i++;
+        else
+        {
+            PrintUsage( argv[0]);
+            return -1;
+        }
+    }
+
+    if( reportPath )
+        return WriteReports( reportPath, functionName, rangeStart, rangeStop, referenceDirectory);
+
+    if( functionName )
+    {
+        const TestedFunction * function = NULL;
+        for( const TestedFunction & f : kTestedFunctions )
+            if( 0 == strcmp( f.name, functionName) )
+                function = &f;
+
+        if( NULL == function || shard >= (long) shardCount )
+        {
+            PrintUsage( argv[0]);
+            return -1;
+        }
+
+        ReferenceTable * table = referenceDirectory ? OpenReferences( referenceDirectory, function->tableName) : NULL;
+        error = 0;
+        for( uint32_t k = 0; k < shardCount; k++)
+            if( shard < 0 || k == (uint32_t) shard )
+                if( RunShard( *function, rangeStart, rangeStop, k, uint32_t(shardCount), outputDirectory, table) )
+                    error = -1;
+        CloseReferenceTable( table);
+        return error;
+    }
+
+    if( referenceDirectory )
+    {
+        gFloorReferences = OpenReferences( referenceDirectory, "floor");
+        gRoundReferences = OpenReferences( referenceDirectory, "round");
+        gRintReferences = OpenReferences( referenceDirectory, "rint");
+        gLog2References = OpenReferences( referenceDirectory, "log2");
+        gExp2References = OpenReferences( referenceDirectory, "exp2");
+        gLogReferences = OpenReferences( referenceDirectory, "log");
+        gLog10References = OpenReferences( referenceDirectory, "log10");
+        gLog1pReferences = OpenReferences( referenceDirectory, "log1p");
+        gExpm1References = OpenReferences( referenceDirectory, "expm1");
+    }
+    
+    printf( "Testing floor...");
+    if( (error = TestFunction( Floor, floorf, gFloorReferences)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing round...");
+    if( (error = TestFunction( Round, roundf, gRoundReferences)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing rint...");
+    if( (error = TestFunction( Rint, rintf, gRintReferences)))
+        return error;
+    printf( "passed\n");
+
+    for( const RintInDirection & direction : kRintDirections)
+    {
+        printf( "Testing rint<%s>...", direction.name);
+        if( (error = TestFunction( direction.testF, direction.referenceF)))
+            return error;
+        printf( "passed\n");
+    }
+
+    if( (error = TestIntConversions()))
+        return error;
+
+    printf( "Testing log2...");
+    if( (error = TestTranscendental( Log2, ReferenceLog2, ReferenceLog2Array, ErrorBound( Accuracy::Faithful) + kReferenceError, 0, 1ULL << 32, gLog2References)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing log2<CorrectlyRounded>...");
+    if( (error = TestTranscendental( Log2<Accuracy::CorrectlyRounded>, ReferenceLog2, ReferenceLog2Array,
+                                     ErrorBound( Accuracy::CorrectlyRounded) + kReferenceError, 0, 1ULL << 32, gLog2References)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing log2<Fast>...");
+    if( (error = TestTranscendental( Log2<Accuracy::Fast>, ReferenceLog2, ReferenceLog2Array, ErrorBound( Accuracy::Fast), 0, 1ULL << 32, gLog2References)))
+        return error;
+    printf( "passed\n\tvs. log2f: ");
+    PrintBenchmarks( BenchmarkUnaryFunction( Log2<Accuracy::Fast>), BenchmarkUnaryFunction( log2f));
+    printf( "\n");
+
+    constexpr float kFaithful = ErrorBound( Accuracy::Faithful) + kReferenceError;
+
+    printf( "Testing exp2...");
+    if( (error = TestTranscendental( Exp2, ReferenceExp2, ReferenceExp2Array, kFaithful, 0, 1ULL << 32, gExp2References)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing log...");
+    if( (error = TestTranscendental( Log, ReferenceLog, ReferenceLogArray, kFaithful, 0, 1ULL << 32, gLogReferences)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing log10...");
+    if( (error = TestTranscendental( Log10, ReferenceLog10, ReferenceLog10Array, kFaithful, 0, 1ULL << 32, gLog10References)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing log1p...");
+    if( (error = TestTranscendental( Log1p, ReferenceLog1p, ReferenceLog1pArray, kFaithful, 0, 1ULL << 32, gLog1pReferences)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Testing expm1...");
+    if( (error = TestTranscendental( Expm1, ReferenceExpm1, ReferenceExpm1Array, kFaithful, 0, 1ULL << 32, gExpm1References)))
+        return error;
+    printf( "passed\n");
+
+    printf( "Log2 variants, over [0.5, 2):\n");
+    ReportLog2Variants();
+
+    printf( "Testing %s array kernels:\n", ArrayKernelISA());
+    printf( "\tfloor...");
+    if( (error = TestArrayFunction( FloorArray, Floor)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\tround...");
+    if( (error = TestArrayFunction( RoundArray, Round)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\trint...");
+    if( (error = TestArrayFunction( RintArray, Rint)))
+        return error;
+    printf( "passed\n");
+
+    for( const RintInDirection & direction : kRintDirections)
+    {
+        printf( "\trint<%s>...", direction.name);
+        if( (error = TestArrayFunction( direction.arrayF, direction.testF)))
+            return error;
+        printf( "passed\n");
+    }
+
+    printf( "\tlog2...");
+    if( (error = TestArrayFunction( Log2Array, Log2)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\texp2...");
+    if( (error = TestArrayFunction( Exp2Array, Exp2)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\tlog...");
+    if( (error = TestArrayFunction( LogArray, Log)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\tlog10...");
+    if( (error = TestArrayFunction( Log10Array, Log10)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\tlog1p...");
+    if( (error = TestArrayFunction( Log1pArray, Log1p)))
+        return error;
+    printf( "passed\n");
+
+    printf( "\texpm1...");
+    if( (error = TestArrayFunction( Expm1Array, Expm1)))
+        return error;
+    printf( "passed\n");
+
+    if( (error = TestDoubleFunctions( kDefaultDoubleSamples)))
+        return error;
+
+    if( (error = Test16BitFormat<_Float16>()))
+        return error;
+    if( (error = Test16BitFormat<BFloat16>()))
         return error;
-    printf( "passed\n\n\n");
+    printf( "\n\n");
 
     return error;
 }
@@ -228,6 +1861,8 @@ int main(int argc, const char * argv[])
 //                   https://lemire.me/blog/2021/03/24/counting-cycles-and-instructions-on-the-apple-m1-processor/
 //                   Performance monitor counters usually include a cycle time. If you can figure how how to read
 //                   PMCs, then you will usually get the capability to read cycles.  https://gist.github.com/ibireme/173517c208c7dc333ba962c1f0d67d12
+//                   On Linux, PMCs are read through perf_event_open: https://man7.org/linux/man-pages/man2/perf_event_open.2.html
+//                   (see PerfCounters.hpp, and --counters)
 //
 //      2) Some understanding of preemptive multitasking.
 //
@@ -45,7 +45,7 @@ template <typename ClassType>
 LinkedListNode<ClassType>::LinkedListNode(const LinkedListNode & node) : LinkedListNode(){}
 
 template <typename ClassType>
-LinkedListNode<ClassType>::~LinkedListNode(){ delete next; next = NULL; }
+LinkedListNode<ClassType>::~LinkedListNode(){ HeapNodeAllocator<ClassType>::DestroyChain( SwapNext(NULL)); }
 
 template <typename ClassType>
 ClassType * ALWAYS_USE_RESULT __nullable LinkedListNode<ClassType>::GetNext() const{ return next;}
@@ -60,17 +60,17 @@ ClassType * ALWAYS_USE_RESULT __nullable LinkedListNode<ClassType>::SwapNext( Cl
 
 #pragma mark - LIFO
 
-template <typename ClassType>
-LIFOLinkedList<ClassType>::LIFOLinkedList() : list(NULL){}
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+LIFOLinkedList<ClassType, Allocator, Bookkeeping>::LIFOLinkedList() : list(NULL){}
 
-template <typename ClassType>
-LIFOLinkedList<ClassType>::LIFOLinkedList(ClassType * __nullable nodes) : list(nodes){}
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+LIFOLinkedList<ClassType, Allocator, Bookkeeping>::LIFOLinkedList(ClassType * __nullable nodes) : list(nodes){ bookkeeping.Recount(list); }
 
-template <typename ClassType>
-LIFOLinkedList<ClassType>::~LIFOLinkedList(){ delete list; list = NULL; }
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+LIFOLinkedList<ClassType, Allocator, Bookkeeping>::~LIFOLinkedList(){ Allocator::DestroyChain(list); list = NULL; }
 
-template <typename ClassType>
-inline bool LIFOLinkedList<ClassType>::Contains(ClassType * __nullable node) const
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline bool LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Contains(ClassType * __nullable node) const
 {
     for( const ClassType * n = list; n; n = n->GetNext())
         if( node == n)
@@ -78,42 +78,55 @@ inline bool LIFOLinkedList<ClassType>::Contains(ClassType * __nullable node) con
     return false;
 }
 
-template <typename ClassType>
-inline unsigned long LIFOLinkedList<ClassType>::GetCount() const
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline unsigned long LIFOLinkedList<ClassType, Allocator, Bookkeeping>::GetCount() const
 {
+    if constexpr( Bookkeeping::kIsKept )
+        return bookkeeping.GetCount();
+
     unsigned long count = 0;
     for( const ClassType * n = list; n; n = n->GetNext())
         count++;
     return count;
 }
 
-template <typename ClassType>
-inline const ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType>::GetHead() const { return list;}
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline const ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType, Allocator, Bookkeeping>::GetHead() const { return list;}
 
-template <typename ClassType>
-inline const ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType>::GetTail() const
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline const ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType, Allocator, Bookkeeping>::GetTail() const
 {
+    if constexpr( Bookkeeping::kIsKept )
+        return bookkeeping.GetTail();
+
     ClassType * __nullable result = NULL;
     for( ClassType * n = list; n; n = n->GetNext())
         result = n;
     return result;
 }
 
-template <typename ClassType>
-inline ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType>::Pop()
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Pop()
 {
     ClassType * result = list;
     if(result)
+    {
         list = result->SwapNext(NULL);
+        bookkeeping.Removed();
+    }
     return result;
 }
 
-template <typename ClassType>
-inline void LIFOLinkedList<ClassType>::Push(ClassType * __nullable newNodes )
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Push(ClassType * __nullable newNodes )
 {
     if(NULL == newNodes)
         return;
     
+    if( NULL == list )
+        bookkeeping.SetTail(newNodes);      // the first one in goes to the bottom
+
+    unsigned long count = 0;
     ClassType * temp = NULL;
     ClassType * head = list;
     ClassType * n = newNodes;
@@ -122,28 +135,85 @@ inline void LIFOLinkedList<ClassType>::Push(ClassType * __nullable newNodes )
         temp = n;
         n = n->SwapNext(head);
         head = temp;
+        count++;
     }
     list = head;
+    bookkeeping.Added(count);
 }
 
-template <typename ClassType>
-inline void LIFOLinkedList<ClassType>::Push(LIFOLinkedList<ClassType> & list2 )
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Push(LIFOLinkedList<ClassType, Allocator, Bookkeeping> & list2 )
 {
     ClassType * n = list2.StealList();
+    if( NULL == list && n )
+        bookkeeping.SetTail(n);
+
+    unsigned long count = 0;
     while(n)
     {
         ClassType * current = n;
         n = current->SwapNext(list);
         list = current;
+        count++;
     }
+    bookkeeping.Added(count);
+}
+
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Prepend(ClassType * __nonnull head, ClassType * __nonnull tail, unsigned long count)
+{
+    ClassType * nullPtr = tail->SwapNext(list);
+    assert(NULL == nullPtr);
+    if( NULL == list )
+        bookkeeping.SetTail(tail);
+    list = head;
+    bookkeeping.Added(count);
+}
+
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Splice(LIFOLinkedList<ClassType, Allocator, Bookkeeping> & list2 )
+{
+    if( &list2 == this || NULL == list2.list )
+        return;
+
+    unsigned long count = list2.bookkeeping.GetCount();
+    ClassType * tail2 = list2.bookkeeping.GetTail();
+    if constexpr( ! Bookkeeping::kIsKept )
+        for( ClassType * n = list2.list; n; n = n->GetNext())
+            tail2 = n;
+
+    ClassType * head2 = list2.StealList();
+    Prepend(head2, tail2, count);
+}
+
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Splice(ClassType * __nullable head, ClassType * __nullable tail, unsigned long count )
+{
+    if( NULL == head )
+        return;
+    assert( NULL != tail && NULL == tail->GetNext());
+
+    Prepend(head, tail, count);
+}
+
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Splice(ClassType * __nullable head, ClassType * __nullable tail )
+{
+    unsigned long count = 0;
+    if constexpr( Bookkeeping::kIsKept )
+        for( ClassType * n = head; n; n = n->GetNext())
+            count++;
+
+    Splice(head, tail, count);
 }
 
 /*! @abstract Reverse the order of the list */
-template <typename ClassType>
-inline void LIFOLinkedList<ClassType>::Reverse()
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Reverse()
 {
     ClassType * newList = NULL;
     ClassType * oldList = list;
+    bookkeeping.SetTail(list);
     while(oldList)
     {
         ClassType * node = oldList;
@@ -154,16 +224,17 @@ inline void LIFOLinkedList<ClassType>::Reverse()
 }
 
 /*! @abstract Steal the list nodes. List becomes empty and a naked linked list of the old nodes is returned out the left hand side */
-template <typename ClassType>
-inline ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType>::StealList()
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline ClassType * __nullable ALWAYS_USE_RESULT LIFOLinkedList<ClassType, Allocator, Bookkeeping>::StealList()
 {
     ClassType * result = list;
     list = NULL;
+    bookkeeping.Clear();
     return result;
 }
 
-template <typename ClassType>
-inline void LIFOLinkedList<ClassType>::Iterate( bool(^ __nonnull block)(const ClassType * __nonnull node)) const
+template <typename ClassType, typename Allocator, typename Bookkeeping>
+inline void LIFOLinkedList<ClassType, Allocator, Bookkeeping>::Iterate( bool(^ __nonnull block)(const ClassType * __nonnull node)) const
 {
     for(ClassType * n = list; n; n = n->GetNext() )
         if(block(n))
@@ -174,33 +245,36 @@ inline void LIFOLinkedList<ClassType>::Iterate( bool(^ __nonnull block)(const Cl
 #pragma mark - FIFO
 
 
-template <typename T>
-FIFOLinkedList<T>::FIFOLinkedList() : head(NULL), tail(NULL){}
+template <typename T, typename Allocator, typename Bookkeeping>
+FIFOLinkedList<T, Allocator, Bookkeeping>::FIFOLinkedList() : head(NULL), tail(NULL){}
 
-template <typename T>
-FIFOLinkedList<T>::FIFOLinkedList(T * __nullable nodes) : head(nodes), tail(NULL)
-{ for( T * p = head; p; p = p->GetNext()) tail = p; }
+template <typename T, typename Allocator, typename Bookkeeping>
+FIFOLinkedList<T, Allocator, Bookkeeping>::FIFOLinkedList(T * __nullable nodes) : head(nodes), tail(NULL)
+{ for( T * p = head; p; p = p->GetNext()) tail = p; bookkeeping.Recount(head); }
 
-template <typename T>
-FIFOLinkedList<T>::~FIFOLinkedList(){ delete head; head = tail = NULL;}
+template <typename T, typename Allocator, typename Bookkeeping>
+FIFOLinkedList<T, Allocator, Bookkeeping>::~FIFOLinkedList(){ Allocator::DestroyChain(head); head = tail = NULL;}
 
-template <typename T>
-unsigned long FIFOLinkedList<T>::GetCount() const
+template <typename T, typename Allocator, typename Bookkeeping>
+unsigned long FIFOLinkedList<T, Allocator, Bookkeeping>::GetCount() const
 {
+    if constexpr( Bookkeeping::kIsKept )
+        return bookkeeping.GetCount();
+
     unsigned long result = 0;
     for( T * p = head; p; p = p->GetNext())
         result++;
     return result;
 }
 
-template <typename T>
-inline const T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T>::GetHead() const { return head; }
+template <typename T, typename Allocator, typename Bookkeeping>
+inline const T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T, Allocator, Bookkeeping>::GetHead() const { return head; }
 
-template <typename T>
-inline const T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T>::GetTail() const { return tail; }
+template <typename T, typename Allocator, typename Bookkeeping>
+inline const T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T, Allocator, Bookkeeping>::GetTail() const { return tail; }
 
-template <typename T>
-inline T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T>::Dequeue()
+template <typename T, typename Allocator, typename Bookkeeping>
+inline T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T, Allocator, Bookkeeping>::Dequeue()
 {
     T * result = head;
     if( NULL == result)
@@ -209,47 +283,89 @@ inline T * __nullable ALWAYS_USE_RESULT FIFOLinkedList<T>::Dequeue()
     head = result->SwapNext(NULL);
     if(NULL == head )
         tail = NULL;
+    bookkeeping.Removed();
     return result;
 }
 
-template <typename T>
-inline void FIFOLinkedList<T>::Enqueue(T * __nullable newNodes )
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Append(T * __nonnull newHead, T * __nonnull newTail, unsigned long count)
 {
-    
-    T * newTail = NULL;
-    for( T * p = newNodes; p; p = p->GetNext())
-        newTail = p;
-    
-    if( NULL == newTail)
-        return;
+    bookkeeping.Added(count);
 
     T * nullPtr = NULL;
     if( NULL == tail)
     {
-        head = newNodes;
+        head = newHead;
         tail = newTail;
         return;
     }
 
-    nullPtr = tail->SwapNext(newNodes);
+    nullPtr = tail->SwapNext(newHead);
     assert(NULL == nullPtr);
     tail = newTail;
 }
 
-template <typename T>
-inline void FIFOLinkedList<T>::Enqueue(FIFOLinkedList<T> & list ){ return Enqueue(list.StealList()); }
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Enqueue(T * __nullable newNodes )
+{
+    
+    T * newTail = NULL;
+    unsigned long count = 0;
+    for( T * p = newNodes; p; p = p->GetNext())
+    {
+        newTail = p;
+        count++;
+    }
+    
+    if( NULL == newTail)
+        return;
+    Append(newNodes, newTail, count);
+}
+
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Enqueue(FIFOLinkedList<T, Allocator, Bookkeeping> & list )
+{
+    if( &list == this || NULL == list.head )      // a list enqueued on itself is already in place
+        return;
+
+    unsigned long count = list.bookkeeping.GetCount();
+    T * newTail = list.tail;
+    T * newHead = list.StealList();
+    Append(newHead, newTail, count);
+}
+
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Enqueue(T * __nullable newHead, T * __nullable newTail, unsigned long count )
+{
+    if( NULL == newHead )
+        return;
+    assert( NULL != newTail && NULL == newTail->GetNext());
+
+    Append(newHead, newTail, count);
+}
+
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Enqueue(T * __nullable newHead, T * __nullable newTail )
+{
+    unsigned long count = 0;
+    if constexpr( Bookkeeping::kIsKept )
+        for( T * p = newHead; p; p = p->GetNext())
+            count++;
+
+    Enqueue(newHead, newTail, count);
+}
  
 
-template <typename T>
-inline void FIFOLinkedList<T>::Iterate( bool(^ __nonnull block)(const T * __nonnull node)) const
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Iterate( bool(^ __nonnull block)(const T * __nonnull node)) const
 {
     for( const T * p = head; p; p = p->GetNext())
-        if( FIFOLinkedList<T>::kIterateStop == block(p) )
+        if( FIFOLinkedList<T, Allocator, Bookkeeping>::kIterateStop == block(p) )
             return;
 }
 
-template <typename T>
-inline void FIFOLinkedList<T>::Reverse()
+template <typename T, typename Allocator, typename Bookkeeping>
+inline void FIFOLinkedList<T, Allocator, Bookkeeping>::Reverse()
 {
     T * newHead = NULL;
     T * current = head;
@@ -265,11 +381,12 @@ inline void FIFOLinkedList<T>::Reverse()
     head = newHead;
 }
 
-template <typename T>
-inline T * __nullable FIFOLinkedList<T>::StealList()
+template <typename T, typename Allocator, typename Bookkeeping>
+inline T * __nullable FIFOLinkedList<T, Allocator, Bookkeeping>::StealList()
 {
     T * result = head;
     head = tail = NULL;
+    bookkeeping.Clear();
     return result;
 }
 
@@ -281,7 +398,7 @@ template <typename T>
 LinkedListNodeAtomic<T>::LinkedListNodeAtomic(const LinkedListNodeAtomic<T> & node){ atomic_store_explicit( &next, &node, std::memory_order_release); }
 
 template <typename T>
-LinkedListNodeAtomic<T>::~LinkedListNodeAtomic(){ delete SwapNext(NULL); }
+LinkedListNodeAtomic<T>::~LinkedListNodeAtomic(){ HeapNodeAllocator<T>::DestroyChain( SwapNext(NULL)); }
 
 /*! @abstract  Return the next item in the list */
 template <typename T>
@@ -297,7 +414,7 @@ template <typename T>
 LIFOLinkedListAtomic<T>::LIFOLinkedListAtomic(){ atomic_store_explicit( &list, NULL, std::memory_order_release); }
 
 template <typename T>
-LIFOLinkedListAtomic<T>::~LIFOLinkedListAtomic(){ delete StealList();}
+LIFOLinkedListAtomic<T>::~LIFOLinkedListAtomic(){ HeapNodeAllocator<T>::DestroyChain( StealList());}
 
 template <typename T>
 T * __nullable ALWAYS_USE_RESULT LIFOLinkedListAtomic<T>::ReverseList( T * __nullable nodes )
@@ -119,6 +119,9 @@
 #   define ALWAYS_USE_RESULT       __attribute__((warning("The result of this function is not used!")))
 #endif
 
+#include "NodeAllocator.hpp"
+#include "ListBookkeeping.hpp"
+
 /*! @abstract The base class for things that are in the linked lists */
 template <typename ClassType>
 class LinkedListNode
@@ -138,17 +141,25 @@ public:
     inline ClassType * ALWAYS_USE_RESULT __nullable SwapNext( ClassType * __nullable newValue);
 };
 
-/*! @abstract Singly linked list that operates in a Last-in, First-out order. The list nodes will be subclasses of LinkedListNode<SubClass> */
-template <typename ClassType>
+/*! @abstract Singly linked list that operates in a Last-in, First-out order. The list nodes will be subclasses of LinkedListNode<SubClass>
+ *  @discussion Allocator says how to get rid of the nodes still on the list when it is destroyed: HeapNodeAllocator for nodes
+ *              from new, ArenaNodeAllocator for nodes from a NodeArena. See NodeAllocator.hpp.
+ *              Bookkeeping says whether GetCount and GetTail walk the list (NoBookkeeping) or are kept up to date as
+ *              the list changes (CountedBookkeeping). See ListBookkeeping.hpp. */
+template <typename ClassType, typename Allocator = HeapNodeAllocator<ClassType>, typename Bookkeeping = NoBookkeeping<ClassType>>
 class LIFOLinkedList
 {
 private:
     /*! @abstract  TODO: What private data members are needed here? */
     ClassType * __nullable list;
+    [[no_unique_address]] Bookkeeping bookkeeping;
     
     LIFOLinkedList(const LIFOLinkedList & list ) = delete;              // Declared private so we don't accidentally called it. Do not implement.
     LIFOLinkedList & operator=(const LIFOLinkedList & list) = delete;   // Declared private so we don't accidentally called it. Do not implement.
     
+    /*! @abstract Link a chain of count nodes, head through tail, onto the front of the list as it is */
+    inline void Prepend(ClassType * __nonnull head, ClassType * __nonnull tail, unsigned long count);
+
 public:
     LIFOLinkedList();
     LIFOLinkedList(ClassType * __nullable nodes);
@@ -158,13 +169,13 @@ public:
     /*! @abstract Returns true of the node is in the list */
     inline bool Contains(ClassType * __nullable node) const;
 
-    /*! @abstract Returns the number of nodes in the list */
+    /*! @abstract Returns the number of nodes in the list. O(1) with CountedBookkeeping, otherwise it walks the list. */
     inline unsigned long GetCount() const;
 
     /*! @abstract Look at the first item on the list. Do not remove from the list */
     inline const ClassType * __nullable ALWAYS_USE_RESULT GetHead() const;
 
-    /*! @abstract Look at the last item on the list. Do not remove from the list */
+    /*! @abstract Look at the last item on the list. Do not remove from the list. O(1) with CountedBookkeeping, otherwise it walks the list. */
     inline const ClassType * __nullable ALWAYS_USE_RESULT GetTail() const;
 
     /*! @abstract Remove the most recently added node from the list */
@@ -172,7 +183,18 @@ public:
 
     /*! @abstract Add nodes to the list such that the last node in newNodes will be the first one off */
     inline void Push(ClassType * __nullable newNodes );
-    inline void Push(LIFOLinkedList<ClassType> & list); // empties list
+    inline void Push(LIFOLinkedList<ClassType, Allocator, Bookkeeping> & list); // empties list. Relinks one node at a time.
+
+    /*! @abstract Put all of list on the front of this one without changing its order, so its head is the first one off. Empties list.
+     *  @discussion O(1) with CountedBookkeeping. Otherwise list is walked to find its tail, but nothing is relinked but the tail. */
+    inline void Splice(LIFOLinkedList<ClassType, Allocator, Bookkeeping> & list);
+
+    /*! @abstract Put a chain of count nodes, whose last node is tail, on the front of the list without changing its order. O(1). */
+    inline void Splice(ClassType * __nullable head, ClassType * __nullable tail, unsigned long count);
+
+    /*! @abstract As above, for callers that don't know the count
+     *  @discussion O(1) without bookkeeping. With CountedBookkeeping the chain is walked once to count it. */
+    inline void Splice(ClassType * __nullable head, ClassType * __nullable tail);
 
     /*! @abstract Reverse the order of the list */
     inline void Reverse();
@@ -187,18 +209,22 @@ public:
     inline void Iterate( bool(^ __nonnull block)(const ClassType * __nonnull node))  const;
 };
 
-/*! @abstract Singly linked list that operates in a First-in, First-out order */
-template <typename ClassType>
+/*! @abstract Singly linked list that operates in a First-in, First-out order. Allocator and Bookkeeping are as for LIFOLinkedList. */
+template <typename ClassType, typename Allocator = HeapNodeAllocator<ClassType>, typename Bookkeeping = NoBookkeeping<ClassType>>
 class FIFOLinkedList
 {
 private:
     /*! @abstract  TODO: What private data members are needed here? */
     ClassType * __nullable head;
     ClassType * __nullable tail;
+    [[no_unique_address]] Bookkeeping bookkeeping;
 
     FIFOLinkedList(const FIFOLinkedList & list ) = delete;                // Declared private so we don't accidentally called it. Do not implement.
     FIFOLinkedList & operator=(const FIFOLinkedList & list)  = delete;    // Declared private so we don't accidentally called it. Do not implement.
 
+    /*! @abstract Link a chain of count nodes, head through tail, onto the end of the list */
+    inline void Append(ClassType * __nonnull head, ClassType * __nonnull tail, unsigned long count);
+
 public:
     FIFOLinkedList();
     FIFOLinkedList(ClassType * __nullable nodes);
@@ -207,7 +233,7 @@ public:
     /*! @abstract Returns true of the node is in the list */
     inline bool Contains(ClassType * __nullable node) const;
 
-    /*! @abstract Returns the number of nodes in the list */
+    /*! @abstract Returns the number of nodes in the list. O(1) with CountedBookkeeping, otherwise it walks the list. */
     inline unsigned long GetCount() const;
 
     /*! @abstract Look at the first item on the list. Do not remove from the list */
@@ -220,8 +246,15 @@ public:
     inline ClassType * __nullable ALWAYS_USE_RESULT Dequeue();
 
     /*! @abstract Add nodes to the end of the list  */
-    inline void Enqueue(ClassType * __nullable newNodes );
-    inline void Enqueue(FIFOLinkedList<ClassType> & list ); // empties list
+    inline void Enqueue(ClassType * __nullable newNodes );                          // walks newNodes to find its tail
+    inline void Enqueue(FIFOLinkedList<ClassType, Allocator, Bookkeeping> & list ); // empties list. O(1).
+
+    /*! @abstract Add a chain of count nodes, whose last node is newTail, to the end of the list. O(1), for callers that keep track of their tails. */
+    inline void Enqueue(ClassType * __nullable newHead, ClassType * __nullable newTail, unsigned long count );
+
+    /*! @abstract As above, for callers that don't know the count
+     *  @discussion O(1) without bookkeeping. With CountedBookkeeping the chain is walked once to count it. */
+    inline void Enqueue(ClassType * __nullable newHead, ClassType * __nullable newTail );
 
     /*! @abstract Reverse the order of the list */
     inline void Reverse();
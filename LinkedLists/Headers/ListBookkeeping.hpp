@@ -0,0 +1,74 @@
+//
+//  ListBookkeeping.hpp
+//  LinkedLists
+//
+//  What a list remembers about itself besides where it starts. The lists take a bookkeeping policy as their
+//  third template parameter. The default, NoBookkeeping, remembers nothing and costs nothing: GetCount, and
+//  LIFOLinkedList::GetTail, walk the whole list. CountedBookkeeping keeps the count and the tail up to date as
+//  nodes come and go, so those are a load instead, for code that asks often. It costs a couple of words per
+//  list, and a little work in Push, Pop, Enqueue, Dequeue and Reverse.
+//
+//  A list of nodes handed to a constructor is walked once to count it.
+//
+
+#ifndef LIST_BOOKKEEPING_HPP
+#define LIST_BOOKKEEPING_HPP    1
+
+#include <stddef.h>
+
+/*! @abstract Bookkeeping policy that keeps nothing. This is the default. */
+template <typename ClassType>
+class NoBookkeeping
+{
+public:
+    static constexpr bool kIsKept = false;
+
+    inline void Recount( ClassType * __nullable head){}
+    inline void Clear(){}
+    inline void Added( unsigned long count){}
+    inline void Removed(){}
+    inline void SetTail( ClassType * __nullable tail){}
+    inline unsigned long GetCount() const { return 0; }
+    inline ClassType * __nullable GetTail() const { return NULL; }
+};
+
+/*! @abstract Bookkeeping policy that keeps the number of nodes and the last one
+ *  @discussion FIFOLinkedList has its own tail pointer, so it uses only the count. */
+template <typename ClassType>
+class CountedBookkeeping
+{
+private:
+    unsigned long           count;
+    ClassType * __nullable  tail;
+
+public:
+    static constexpr bool kIsKept = true;
+
+    CountedBookkeeping() : count(0), tail(NULL){}
+
+    /*! @abstract Start over with the list at head, walking it once */
+    inline void Recount( ClassType * __nullable head)
+    {
+        Clear();
+        for( ClassType * n = head; n; n = n->GetNext())
+        {
+            count++;
+            tail = n;
+        }
+    }
+
+    /*! @abstract The list is now empty */
+    inline void Clear(){ count = 0; tail = NULL; }
+
+    /*! @abstract count nodes were added. If they went on the end, call SetTail too. */
+    inline void Added( unsigned long n){ count += n; }
+
+    /*! @abstract One node was taken off the front */
+    inline void Removed(){ if( 0 == --count ) tail = NULL; }
+
+    inline void SetTail( ClassType * __nullable newTail){ tail = newTail; }
+    inline unsigned long GetCount() const { return count; }
+    inline ClassType * __nullable GetTail() const { return tail; }
+};
+
+#endif  /* LIST_BOOKKEEPING_HPP */
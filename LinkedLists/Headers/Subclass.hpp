@@ -38,6 +38,13 @@ public:
 typedef LIFOLinkedList<SubClass>    SubClassLIFO;
 typedef FIFOLinkedList<SubClass>    SubClassFIFO;
 
+typedef NodeArena<SubClass>                                         SubClassArena;
+typedef LIFOLinkedList<SubClass, ArenaNodeAllocator<SubClass>>      SubClassArenaLIFO;
+typedef FIFOLinkedList<SubClass, ArenaNodeAllocator<SubClass>>      SubClassArenaFIFO;
+
+typedef LIFOLinkedList<SubClass, HeapNodeAllocator<SubClass>, CountedBookkeeping<SubClass>>     SubClassCountedLIFO;
+typedef FIFOLinkedList<SubClass, HeapNodeAllocator<SubClass>, CountedBookkeeping<SubClass>>     SubClassCountedFIFO;
+
 
 #endif  /* SUBCLASS_HPP */
 
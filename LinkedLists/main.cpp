@@ -8,9 +8,10 @@
 
 
 
+#include <chrono>
 #include <iostream>
-#include <dispatch/dispatch.h>
 #include <stdlib.h>
+#include "ThreadPool.hpp"
 #if DEBUG
 #else
 #   define NDEBUG 1
@@ -32,9 +33,15 @@
 #pragma mark -
 #define TEST( _test )       ({ __typeof__ (_test) _result = _test; if( (__typeof__ _result) 0 == _result){ __assert(#_test, __FILE__, __LINE__); return -1;} })
 
+// NoBookkeeping takes no room, so lists that don't count are still just their pointers
+static_assert( sizeof(SubClassLIFO) == sizeof(SubClass *), "NoBookkeeping should cost nothing");
+static_assert( sizeof(SubClassFIFO) == 2 * sizeof(SubClass *), "NoBookkeeping should cost nothing");
+
+/*! @abstract List is SubClassLIFO or SubClassCountedLIFO */
+template <typename List>
 int TestLIFO(const unsigned long listSize )
 {
-    SubClassLIFO list;          // Test default ctor
+    List list;          // Test default ctor
     
     // add listSize Nodes
     for( unsigned long i = 0; i < listSize; i++)
@@ -89,7 +96,7 @@ int TestLIFO(const unsigned long listSize )
     TEST( p == list.GetHead());
     
     // Test Push and pop
-    SubClassLIFO list2;
+    List list2;
     for( index = listSize; index;)
     {
         index--;
@@ -123,9 +130,13 @@ int TestLIFO(const unsigned long listSize )
         return LIFOLinkedList<SubClass>::kIterateContinue;
     });
     TEST(index == 0);
+    TEST( listSize == list2.GetCount());
+    if( listSize )
+        TEST( list2.GetTail()->GetValue() == 0);
     
     // Try constructor with an node list
-    SubClassLIFO list3(list2.StealList());
+    List list3(list2.StealList());
+    TEST( listSize == list3.GetCount());
 
     // Check to make sure the list is now in the reverse order
     index = listSize;
@@ -137,7 +148,7 @@ int TestLIFO(const unsigned long listSize )
     });
     TEST(index == 0);
     
-    SubClassLIFO list4;
+    List list4;
     list4.Push(list3.StealList());
     index = 0;
     list4.Iterate(^bool(const SubClass * _Nonnull node) {
@@ -146,6 +157,53 @@ int TestLIFO(const unsigned long listSize )
         index++;
         return LIFOLinkedList<SubClass>::kIterateContinue;
     });
+    TEST( listSize == list4.GetCount());
+    if( listSize )
+        TEST( list4.GetTail()->GetValue() == listSize-1);
+
+    // Splice keeps the order, and leaves the tail alone when the list wasn't empty
+    List list5;
+    SubClass * extra = new SubClass(listSize);
+    list5.Splice( extra, extra);
+    list5.Push( new SubClass(listSize+1));
+    list4.Splice(list5);
+    TEST( NULL == list5.GetHead());
+    TEST( 0 == list5.GetCount());
+    TEST( listSize + 2 == list4.GetCount());
+    TEST( list4.GetHead()->GetValue() == listSize+1);
+    TEST( list4.GetTail()->GetValue() == (listSize ? listSize-1 : listSize));
+    delete list4.Pop();
+    delete list4.Pop();
+
+    // Splice into an empty list, then back again as a chain with a known tail
+    list5.Splice(list4);
+    list5.Splice(list5);        // nothing to do
+    TEST( NULL == list4.GetHead());
+    TEST( listSize == list5.GetCount());
+    SubClass * tail5 = const_cast<SubClass *>(list5.GetTail());
+    unsigned long count5 = list5.GetCount();
+    list4.Splice(list5.StealList(), tail5, count5);
+    index = 0;
+    list4.Iterate(^bool(const SubClass * _Nonnull node) {
+        TEST(node->IsValid());
+        TEST(node->GetValue() == index);
+        index++;
+        return LIFOLinkedList<SubClass>::kIterateContinue;
+    });
+    TEST(index == listSize);
+    TEST( listSize == list4.GetCount());
+    TEST( tail5 == list4.GetTail());
+
+    // Pop everything but one, then the last one, and make sure the count and tail keep up
+    for( index = listSize; index > 1; index--)
+    {
+        delete list4.Pop();
+        TEST( index - 1 == list4.GetCount());
+        TEST( list4.GetTail()->GetValue() == listSize-1);
+    }
+    delete list4.Pop();
+    TEST( 0 == list4.GetCount());
+    TEST( NULL == list4.GetTail());
 
     // Check to make sure list2 is empty
     TEST(list2.GetHead() == NULL);
@@ -158,9 +216,11 @@ int TestLIFO(const unsigned long listSize )
     return 0;
 }
 
+/*! @abstract List is SubClassFIFO or SubClassCountedFIFO */
+template <typename List>
 int TestFIFO(const unsigned long listSize )
 {
-    SubClassFIFO list;          // Test default ctor
+    List list;          // Test default ctor
     
     // add listSize Nodes
     for( unsigned long i = 0; i < listSize; i++)
@@ -215,7 +275,7 @@ int TestFIFO(const unsigned long listSize )
     TEST( p == list.GetHead());
     
     // Test Enqueue and Dequeue
-    SubClassFIFO list2;
+    List list2;
     for( index = 0; index < listSize; index++)
     {
         SubClass * node = list.Dequeue();
@@ -251,7 +311,8 @@ int TestFIFO(const unsigned long listSize )
     TEST(index == 0);
     
     // Try constructor with an node list
-    SubClassFIFO list3(list2.StealList());
+    List list3(list2.StealList());
+    TEST( listSize == list3.GetCount());
 
     // Check to make sure the list is now in the reverse order
     index = listSize;
@@ -263,7 +324,7 @@ int TestFIFO(const unsigned long listSize )
     });
     TEST(index == 0);
 
-    SubClassFIFO list4;
+    List list4;
     list4.Enqueue(list3.StealList());
     index = listSize;
     list4.Iterate(^bool(const SubClass * _Nonnull node) {
@@ -274,7 +335,9 @@ int TestFIFO(const unsigned long listSize )
     });
     TEST(index == 0);
 
-    SubClassFIFO list5;
+    TEST( listSize == list4.GetCount());
+
+    List list5;
     list4.Enqueue(list4);
     index = listSize;
     list4.Iterate(^bool(const SubClass * _Nonnull node) {
@@ -284,6 +347,40 @@ int TestFIFO(const unsigned long listSize )
         return FIFOLinkedList<SubClass>::kIterateContinue;
     });
     TEST(index == 0);
+    TEST( listSize == list4.GetCount());
+
+    // Enqueue a chain with a known tail, then a whole list, onto a list that isn't empty
+    List list6;
+    SubClass * extra = new SubClass(listSize);
+    list6.Enqueue(extra, extra);
+    list6.Enqueue(list4);
+    TEST( NULL == list4.GetHead());
+    TEST( NULL == list4.GetTail());
+    TEST( 0 == list4.GetCount());
+    TEST( listSize + 1 == list6.GetCount());
+    TEST( list6.GetHead() == extra);
+    TEST( list6.GetTail()->GetValue() == (listSize ? 0 : listSize));
+    delete list6.Dequeue();
+    SubClass * tail6 = const_cast<SubClass *>(list6.GetTail());
+    unsigned long count6 = list6.GetCount();
+    list4.Enqueue(list6.StealList(), tail6, count6);
+    index = listSize;
+    list4.Iterate(^bool(const SubClass * _Nonnull node) {
+        --index;
+        TEST(node->IsValid());
+        TEST(node->GetValue() == index);
+        return FIFOLinkedList<SubClass>::kIterateContinue;
+    });
+    TEST(index == 0);
+    TEST( listSize == list4.GetCount());
+    TEST( tail6 == list4.GetTail());
+
+    // Dequeue them all, and make sure the count keeps up
+    for( index = listSize; index; index--)
+    {
+        delete list4.Dequeue();
+        TEST( index - 1 == list4.GetCount());
+    }
 
     // Check to make sure lists are empty
     TEST(list3.GetHead() == NULL);
@@ -299,17 +396,80 @@ int TestFIFO(const unsigned long listSize )
     return 0;
 }
 
+int TestArena(const unsigned long listSize )
+{
+    SubClassArena arena;            // declared first, so the lists are destroyed before it is
+    const SubClass * first = NULL;
+    {
+        SubClassArenaLIFO list;
+        for( unsigned long i = 0; i < listSize; i++)
+            list.Push( arena.New(i) );
+        TEST( listSize == list.GetCount());
+
+        // Nodes made one after another are next to each other in the slab
+        __block const SubClass * previous = NULL;
+        __block unsigned long index = listSize;
+        list.Iterate(^bool(const SubClass * _Nonnull node) {
+            TEST(node->IsValid());
+            TEST(node->GetValue() == --index);
+            TEST(NULL == previous || node + 1 == previous);
+            previous = node;
+            return LIFOLinkedList<SubClass>::kIterateContinue;
+        });
+        TEST(index == 0);
+        first = previous;
+
+        // Move them to a FIFO, and back out again
+        SubClassArenaFIFO list2;
+        for( SubClass * node = list.Pop(); node; node = list.Pop())
+            list2.Enqueue(node);
+        TEST( listSize == list2.GetCount());
+        TEST( NULL == list.GetHead());
+
+        // Give half of them back. The last one given back is the next one made.
+        SubClass * deleted = NULL;
+        for( unsigned long i = 0; i < listSize / 2; i++)
+        {
+            deleted = list2.Dequeue();
+            TEST(deleted->IsValid());
+            TEST(deleted->GetValue() == listSize - 1 - i);
+            arena.Delete(deleted);
+        }
+        TEST( listSize - listSize / 2 == list2.GetCount());
+        if( deleted )
+        {
+            SubClass * node = arena.New(listSize);
+            TEST( node == deleted);
+            TEST( node->IsValid() && node->GetValue() == listSize);
+            list2.Enqueue(node);
+            TEST( list2.GetTail() == node);
+        }
+
+        // Make enough to need more slabs, and leave them all for the list destructors
+        for( unsigned long i = 0; i < 3 * 4096; i++)
+            list.Push( arena.New(i) );
+        TEST( 3 * 4096 == list.GetCount());
+    }
+
+    // Take everything back at once. The first slab is used again from the start.
+    arena.Reset();
+    SubClass * node = arena.New(0UL);
+    TEST( NULL == first || node == first);
+    arena.Delete(node);
+
+    return 0;
+}
+
 int TestAtomic( int numThreads)
 {
     SubClassAtomicLIFO list;
     
     constexpr unsigned long runLength = 1024;
-    __block int result = 0;
-    SubClassAtomicLIFO * listP = &list;
-    dispatch_apply(numThreads, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t iteration) {
+    int result = 0;
+    ParallelFor(0, numThreads, 1, [&](size_t iteration) {
         printf( "[");   fflush(stdout);
         for( unsigned long i = 0; i < runLength; i++)
-            listP->Push( new SubClassAtomic(iteration * runLength + i) );       // using list directly would be const here
+            list.Push( new SubClassAtomic(iteration * runLength + i) );
         printf( "]");   fflush(stdout);
     });
     
@@ -326,10 +486,10 @@ int TestAtomic( int numThreads)
     TEST(NULL == contents || contents->GetNext() == NULL);      // contents should now be the last item on the list
     
     SubClassAtomic * * array = (SubClassAtomic**) calloc( count, sizeof(array[0]));
-    dispatch_apply(numThreads, dispatch_get_global_queue(QOS_CLASS_DEFAULT, 0), ^(size_t iteration) {
+    ParallelFor(0, numThreads, 1, [&](size_t iteration) {
         for( unsigned long i = 0; i < runLength; i++ )
         {
-            SubClassAtomic * item = listP->Pop();   // using list directly would be const here
+            SubClassAtomic * item = list.Pop();
             assert(item);                           // make sure we did not prematurely run out of items
             assert(NULL == item->GetNext());        // make sure we correctly set the next pointer to NULL in pop
             unsigned long value = item->GetValue();
@@ -357,6 +517,125 @@ int TestAtomic( int numThreads)
     return result;
 }
 
+#pragma mark - Teardown
+
+static double Milliseconds(){ return std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now().time_since_epoch()).count(); }
+
+static void PrintTeardown( const char * name, double milliseconds, unsigned long count)
+{
+    printf( "\t%-12s %8.1f ms  %6.2f ns / node\n", name, milliseconds, milliseconds * 1e6 / (double) count);
+}
+
+/*! @abstract Time how long lists of count nodes take to destroy themselves, with nodes from new and from an arena
+ *  @discussion Each list is built in a scope of its own, and the clock starts just before it closes, so only the
+ *              destructors are timed: the list's, and for the arena lists, the arena's too. */
+static void BenchmarkTeardown( unsigned long count)
+{
+    double start;
+    printf( "Teardown of %lu nodes:\n", count);
+
+    {
+        SubClassLIFO list;
+        for( unsigned long i = 0; i < count; i++)
+            list.Push( new SubClass(i) );
+        start = Milliseconds();
+    }
+    PrintTeardown( "LIFO", Milliseconds() - start, count);
+
+    {
+        SubClassFIFO list;
+        for( unsigned long i = 0; i < count; i++)
+            list.Enqueue( new SubClass(i) );
+        start = Milliseconds();
+    }
+    PrintTeardown( "FIFO", Milliseconds() - start, count);
+
+    {
+        SubClassArena arena;
+        SubClassArenaLIFO list;
+        for( unsigned long i = 0; i < count; i++)
+            list.Push( arena.New(i) );
+        start = Milliseconds();
+    }
+    PrintTeardown( "arena LIFO", Milliseconds() - start, count);
+
+    {
+        SubClassArena arena;
+        SubClassArenaFIFO list;
+        for( unsigned long i = 0; i < count; i++)
+            list.Enqueue( arena.New(i) );
+        start = Milliseconds();
+    }
+    PrintTeardown( "arena FIFO", Milliseconds() - start, count);
+}
+
+#pragma mark - GetCount
+
+/*! @abstract Time calls to GetCount on a list of count nodes, as a scheduler checking its queue every tick would */
+template <typename List>
+static void TimeGetCount( const char * name, unsigned long count, unsigned long calls)
+{
+    List list;
+    for( unsigned long i = 0; i < count; i++)
+        list.Push( new SubClass(i) );
+
+    volatile unsigned long sink = 0;
+    double start = Milliseconds();
+    for( unsigned long i = 0; i < calls; i++)
+        sink = sink + list.GetCount();
+    double milliseconds = Milliseconds() - start;
+    printf( "\t%-12s %12.1f ns / call\n", name, milliseconds * 1e6 / (double) calls);
+}
+
+/*! @abstract Compare GetCount with and without CountedBookkeeping. Without it, each call walks the list. */
+static void BenchmarkGetCount( unsigned long count)
+{
+    printf( "GetCount on %lu nodes:\n", count);
+    TimeGetCount<SubClassLIFO>( "LIFO", count, 100);
+    TimeGetCount<SubClassCountedLIFO>( "counted LIFO", count, 100000000);
+}
+
+#pragma mark - Merge
+
+/*! @abstract Time moving a list of count nodes from one list to another and back, rounds times, with merge(to, from) */
+template <typename List, typename Merge>
+static void TimeMerge( const char * name, unsigned long count, unsigned long rounds, Merge merge)
+{
+    SubClass * nodes = NULL;
+    for( unsigned long i = 0; i < count; i++)
+    {
+        SubClass * node = new SubClass(i);
+        SubClass * nullPtr = node->SwapNext(nodes);
+        assert( NULL == nullPtr);
+        nodes = node;
+    }
+    List a(nodes), b;
+
+    double start = Milliseconds();
+    for( unsigned long i = 0; i < rounds; i++)
+    {
+        // Hide the lists from the compiler, so it can't see that the round trip changes nothing, or that the
+        // list merged into is always empty
+        merge(b, a);
+        asm volatile( "" : : "r"(&a), "r"(&b) : "memory");
+        merge(a, b);
+        asm volatile( "" : : "r"(&a), "r"(&b) : "memory");
+    }
+    double milliseconds = Milliseconds() - start;
+    printf( "\t%-22s %12.1f ns / merge\n", name, milliseconds * 1e6 / (double) (2 * rounds));
+}
+
+/*! @abstract Compare merging whole lists node by node with splicing them */
+static void BenchmarkMerge( unsigned long count)
+{
+    printf( "Merging lists of %lu nodes:\n", count);
+    TimeMerge<SubClassLIFO>( "LIFO Push(list)", count, 100, [](SubClassLIFO & to, SubClassLIFO & from){ to.Push(from); });
+    TimeMerge<SubClassLIFO>( "LIFO Splice", count, 100, [](SubClassLIFO & to, SubClassLIFO & from){ to.Splice(from); });
+    TimeMerge<SubClassCountedLIFO>( "counted LIFO Splice", count, 1000000, [](SubClassCountedLIFO & to, SubClassCountedLIFO & from){ to.Splice(from); });
+    TimeMerge<SubClassFIFO>( "FIFO Enqueue(nodes)", count, 100, [](SubClassFIFO & to, SubClassFIFO & from){ to.Enqueue(from.StealList()); });
+    TimeMerge<SubClassFIFO>( "FIFO Enqueue(list)", count, 1000000, [](SubClassFIFO & to, SubClassFIFO & from){ to.Enqueue(from); });
+}
+
 #pragma mark -
 
 static void DetectLeaks()
@@ -375,16 +654,24 @@ int main(int argc, const char * argv[])
     
     int error = 0;
     for( int i = 0; i <= 100; i++)
-        if( (error = TestLIFO(i)) )
+        if( (error = TestLIFO<SubClassLIFO>(i)) || (error = TestLIFO<SubClassCountedLIFO>(i)) )
             return error;
     
     for( int i = 0; i <= 100; i++)
-        if( (error = TestFIFO(i)) )
+        if( (error = TestFIFO<SubClassFIFO>(i)) || (error = TestFIFO<SubClassCountedFIFO>(i)) )
+            return error;
+
+    for( int i = 0; i <= 100; i++)
+        if( (error = TestArena(i)) )
             return error;
 
     for( int i = 0; i <= 100; i++)
         if( (error = TestAtomic(i)) )
             return error;
 
+    BenchmarkTeardown( 10000000);
+    BenchmarkGetCount( 1000000);
+    BenchmarkMerge( 100000);
+
     return 0;
 }